@@ -0,0 +1,346 @@
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <thread>
+#include <iostream>
+#include <algorithm>
+
+#include <poll.h>
+#include <unistd.h>
+#include <sys/un.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+
+#include "AnalysisDaemon.h"
+#include "Checkpoint.h"
+#include "DescriptorMatch.h"
+#include "FileDescriptor.h"
+#include "ThreadPool.h"
+#include "TraceReader.h"
+#include "threadlog.h"
+
+static std::string
+errorResponse(const std::string & message) {
+    CheckpointWriter out;
+    out.putU8(1);
+    out.putU8(0);
+    out.putString(message);
+    return out.payload();
+}
+
+/******************* public function ********************************/
+AnalysisDaemon::AnalysisDaemon(
+    const std::string & socket,
+    unsigned            threads,
+    size_t              cacheBytes
+) : mSocket(socket)
+  , mThreadCnt(threads)
+  , mShared(false)
+  , mAutoscale(false)
+  , mListenFd(-1)
+  , mStop(false)
+  , mCacheBudget(cacheBytes)
+  , mCacheBytes(0)
+  , mCacheCharge(MemoryStats::getInstance()->account("AnalysisDaemon.cache")) {
+    mStats.budget  = cacheBytes;
+    mStats.threads = threads;
+}
+
+AnalysisDaemon::~AnalysisDaemon() {
+    if(mListenFd >= 0) {
+        ::close(mListenFd);
+        ::unlink(mSocket.c_str());
+    }
+}
+
+bool
+AnalysisDaemon::run() {
+    if(!bind()) {
+        return false;
+    }
+    ThreadPool * pool = ThreadPool::getInstance(mThreadCnt);
+    if(mAutoscale) {
+        pool->autoscale(mPolicy);
+    }
+    pool->adjust(mThreadCnt);
+    DEG_LOG("daemon listening on %s, %u threads", mSocket.c_str(), mThreadCnt);
+
+    while(!mStop) {
+        struct pollfd wait = {mListenFd, POLLIN, 0};
+        // wakes up now and then to notice stop()
+        if(::poll(&wait, 1, 200) <= 0) {
+            continue;
+        }
+        int client = ::accept4(mListenFd, nullptr, nullptr, SOCK_CLOEXEC);
+        if(client < 0) {
+            continue;
+        }
+        {
+            std::lock_guard<std::mutex> lock(mClientLock);
+            mClients.insert(client);
+        }
+        std::thread(&AnalysisDaemon::serve, this, client).detach();
+    }
+
+    // unblock idle connections; requests being answered run to the end
+    std::unique_lock<std::mutex> lock(mClientLock);
+    for(int client : mClients) {
+        ::shutdown(client, SHUT_RD);
+    }
+    mClientCond.wait(lock, [&](){return mClients.empty();});
+    DEG_LOG("daemon on %s stopped", mSocket.c_str());
+    return true;
+}
+
+/******************* private function ********************************/
+bool
+AnalysisDaemon::bind() {
+    sockaddr_un address;
+    std::memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if(mSocket.size() >= sizeof(address.sun_path)) {
+        std::cerr<<mSocket<<" is too long for a socket path"<<std::endl;
+        return false;
+    }
+    std::strcpy(address.sun_path, mSocket.c_str());
+
+    mListenFd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if(mListenFd < 0) {
+        std::cerr<<"socket: "<<std::strerror(errno)<<std::endl;
+        return false;
+    }
+    // a socket file nobody answers on is left over from a daemon that died
+    if(::connect(mListenFd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) == 0) {
+        std::cerr<<mSocket<<" is served by another daemon"<<std::endl;
+        ::close(mListenFd);
+        mListenFd = -1;
+        return false;
+    }
+    ::close(mListenFd);
+    ::unlink(mSocket.c_str());
+
+    mListenFd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    mode_t mask = ::umask(mShared ? 0117 : 0177);
+    bool bound = mListenFd >= 0
+                 && ::bind(mListenFd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) == 0
+                 && ::listen(mListenFd, 16) == 0;
+    ::umask(mask);
+    if(!bound) {
+        std::cerr<<mSocket<<" can not be bound: "<<std::strerror(errno)<<std::endl;
+        if(mListenFd >= 0) {
+            ::close(mListenFd);
+            mListenFd = -1;
+        }
+        return false;
+    }
+    return true;
+}
+
+void
+AnalysisDaemon::serve(
+    int     client
+) {
+    std::string request;
+    while(DaemonProtocol::recvFrame(client, request)) {
+        if(!DaemonProtocol::sendFrame(client, answer(request))) {
+            break;
+        }
+    }
+    ::close(client);
+
+    std::lock_guard<std::mutex> lock(mClientLock);
+    mClients.erase(client);
+    mClientCond.notify_all();
+}
+
+std::string
+AnalysisDaemon::answer(
+    const std::string & request
+) {
+    CheckpointReader in;
+    in.parse(request);
+    DAEMONOP    op   = static_cast<DAEMONOP>(in.getU8());
+    pid_t       pid  = static_cast<pid_t>(in.getI64());
+    std::string path = in.getString();
+    uint64_t    triage = in.getU64();
+    if(!in.ok()) {
+        return errorResponse("malformed request");
+    }
+
+    switch(op) {
+    case DAEMONOP::MATCH:
+    case DAEMONOP::BADFD: {
+        bool    cached  = false;
+        Outcome outcome = analyze(op, pid, path, op == DAEMONOP::BADFD ? triage : 0, cached);
+        if(!outcome.body) {
+            return errorResponse(outcome.error);
+        }
+        std::string response;
+        response.reserve(2 + outcome.body->size());
+        response.push_back(0);
+        response.push_back(cached ? 1 : 0);
+        response.append(*outcome.body);
+        return response;
+    }
+    case DAEMONOP::STATS: {
+        CheckpointWriter out;
+        out.putU8(0);
+        out.putU8(0);
+        std::lock_guard<std::mutex> lock(mCacheLock);
+        mStats.entries = mLru.size();
+        mStats.bytes   = mCacheBytes;
+        mStats.threads = ThreadPool::getInstance(mThreadCnt)->size();
+        mStats.memory  = MemoryStats::getInstance()->usage();
+        DaemonProtocol::putStats(out, mStats);
+        return out.payload();
+    }
+    case DAEMONOP::SHUTDOWN: {
+        stop();
+        CheckpointWriter out;
+        out.putU8(0);
+        out.putU8(0);
+        return out.payload();
+    }
+    }
+    return errorResponse("unknown request");
+}
+
+AnalysisDaemon::Outcome
+AnalysisDaemon::analyze(
+    DAEMONOP            op,
+    pid_t               pid,
+    const std::string & path,
+    uint64_t            triage,
+    bool &              cached
+) {
+    uint64_t    size  = 0;
+    long long   mtime = 0;
+    if(!traceIdentity(path, size, mtime)) {
+        Outcome outcome;
+        outcome.error = path + " does not exist!";
+        return outcome;
+    }
+    std::string key = std::to_string(static_cast<int>(op)) + ':' + std::to_string(pid) + ':'
+                      + std::to_string(size) + ':' + std::to_string(mtime) + ':' + std::to_string(triage)
+                      + ':' + path;
+
+    std::promise<Outcome>       promise;
+    std::shared_future<Outcome> running;
+    {
+        std::lock_guard<std::mutex> lock(mCacheLock);
+        ++mStats.requests;
+        auto hit = mCache.find(key);
+        if(hit != mCache.end()) {
+            ++mStats.hits;
+            mLru.splice(mLru.begin(), mLru, hit->second);
+            cached = true;
+            Outcome outcome;
+            outcome.body = hit->second->body;
+            return outcome;
+        }
+        auto same = mRunning.find(key);
+        if(same != mRunning.end()) {
+            ++mStats.shared;
+            running = same->second;
+        } else {
+            mRunning.emplace(key, promise.get_future().share());
+        }
+    }
+    if(running.valid()) {
+        cached = true;
+        return running.get();
+    }
+
+    auto begin = std::chrono::steady_clock::now();
+    Outcome outcome = compute(op, pid, path, triage);
+    DEG_LOG("daemon %s pid %d of %s in %.3fs", op == DAEMONOP::MATCH ? "match" : "ebadf", pid,
+            path.c_str(), std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count());
+    {
+        std::lock_guard<std::mutex> lock(mCacheLock);
+        if(outcome.body) {
+            remember(key, outcome.body);
+        }
+        mRunning.erase(key);
+    }
+    promise.set_value(outcome);
+    return outcome;
+}
+
+AnalysisDaemon::Outcome
+AnalysisDaemon::compute(
+    DAEMONOP            op,
+    pid_t               pid,
+    const std::string & path,
+    uint64_t            triage
+) {
+    Outcome outcome;
+    CheckpointWriter out;
+    if(op == DAEMONOP::MATCH) {
+        DescriptorMatch match;
+        match.initResources(pid, path, mThreadCnt);
+        match.process();
+        DaemonProtocol::putMatch(out, match.getResult());
+    } else {
+        std::lock_guard<std::mutex> lock(mEbadfLock);
+        FileDescriptor * instance = FileDescriptor::getInstance();
+        instance->initResources(pid, path, mThreadCnt);
+        instance->setTriage(triage);
+        instance->process();
+        DaemonProtocol::putStore(out, *instance->getResult());
+        instance->setTriage(0);
+    }
+    outcome.body = std::make_shared<const std::string>(out.payload());
+    return outcome;
+}
+
+void
+AnalysisDaemon::remember(
+    const std::string & key,
+    const Body &        body
+) {
+    if(body->size() > mCacheBudget) {
+        return ;
+    }
+    mLru.push_front(Entry{key, body});
+    mCache[key] = mLru.begin();
+    mCacheBytes += body->size();
+    while(mCacheBytes > mCacheBudget) {
+        const Entry & last = mLru.back();
+        mCacheBytes -= last.body->size();
+        mCache.erase(last.key);
+        mLru.pop_back();
+    }
+    mCacheCharge.set(mCacheBytes);
+}
+
+bool
+AnalysisDaemon::traceIdentity(
+    const std::string & path,
+    uint64_t &          size,
+    long long &         mtime
+) {
+    auto stamp = [](const struct stat & info) {
+        return static_cast<long long>(info.st_mtim.tv_sec) * 1000000000ll + info.st_mtim.tv_nsec;
+    };
+    struct stat info;
+    if(stat(path.c_str(), &info) == 0 && S_ISREG(info.st_mode)) {
+        size  = static_cast<uint64_t>(info.st_size);
+        mtime = stamp(info);
+        return true;
+    }
+    // strace -ff: a new or grown per-task file changes the sum or the newest mtime
+    auto sources = TraceMerger::discover(path);
+    if(sources.empty()) {
+        return false;
+    }
+    size  = 0;
+    mtime = 0;
+    for(const auto & source : sources) {
+        if(stat(source.path.c_str(), &info) != 0) {
+            return false;
+        }
+        size += static_cast<uint64_t>(info.st_size);
+        mtime = std::max(mtime, stamp(info));
+    }
+    return true;
+}
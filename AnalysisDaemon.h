@@ -0,0 +1,108 @@
+#ifndef _ANALYSISDAEMON_H_
+#define _ANALYSISDAEMON_H_
+
+#include <list>
+#include <mutex>
+#include <string>
+#include <memory>
+#include <atomic>
+#include <future>
+#include <unordered_map>
+#include <unordered_set>
+#include <condition_variable>
+
+#include <sys/types.h>
+
+#include "DaemonProtocol.h"
+#include "ThreadPool.h"
+
+// Long-running analysis server on a Unix stream socket (see DaemonProtocol).
+//
+// The ThreadPool stays warm between requests, and every answer is kept as
+// its encoded response in an LRU cache keyed by the trace identity (path,
+// size, mtime; summed over the files of strace -ff input), the engine and
+// the pid filter. Asking again about an unchanged trace is a cache lookup;
+// a request for a run already in progress waits for that run instead of
+// starting another one.
+//
+// Each connection gets a thread and may send any number of requests.
+// Match runs proceed concurrently on the shared pool, each with its own
+// DescriptorMatch; the EBADF engine is a singleton, so its runs take turns.
+class AnalysisDaemon {
+public:
+    AnalysisDaemon(const std::string & socket, unsigned threads, size_t cacheBytes = CACHEBYTES);
+    ~AnalysisDaemon();
+    AnalysisDaemon(const AnalysisDaemon &) = delete;
+    AnalysisDaemon& operator=(const AnalysisDaemon &) = delete;
+
+    // Lets the owner's group connect too (socket mode 0660 instead of 0600).
+    void    setShared(bool shared) {
+        mShared = shared;
+    }
+    // Lets the pool grow with the request backlog and shrink when idle,
+    // between `minThreads` and `maxThreads` (0: the CPU quota).
+    void    setAutoscale(unsigned minThreads, unsigned maxThreads) {
+        mAutoscale = true;
+        mPolicy.minThreads = minThreads;
+        mPolicy.maxThreads = maxThreads;
+    }
+
+    // Serves until a SHUTDOWN request or stop(). false when the socket can
+    // not be bound, or another daemon already listens on it.
+    bool    run();
+    // Callable from any thread or a signal handler.
+    void    stop() {
+        mStop = true;
+    }
+
+private:
+    using Body = std::shared_ptr<const std::string>;
+
+    struct Outcome {
+        Body        body;           // encoded result, nullptr on error
+        std::string error;
+    };
+
+    struct Entry {
+        std::string key;
+        Body        body;
+    };
+
+    bool    bind();
+    void    serve(int client);
+    std::string answer(const std::string & request);
+    Outcome analyze(DAEMONOP op, pid_t pid, const std::string & path, uint64_t triage, bool & cached);
+    Outcome compute(DAEMONOP op, pid_t pid, const std::string & path, uint64_t triage);
+    void    remember(const std::string & key, const Body & body);
+
+    static bool traceIdentity(const std::string & path, uint64_t & size, long long & mtime);
+
+private:
+    static constexpr size_t CACHEBYTES = 512u << 20;
+
+    std::string     mSocket;
+    unsigned int    mThreadCnt;
+    bool            mShared;
+    bool            mAutoscale;
+    ThreadPool::ScalePolicy     mPolicy;
+    int             mListenFd;
+    std::atomic<bool>   mStop;
+
+    // cache, runs in progress and counters, under mCacheLock
+    std::mutex      mCacheLock;
+    std::list<Entry>    mLru;           // most recent first
+    std::unordered_map<std::string, std::list<Entry>::iterator>     mCache;
+    std::unordered_map<std::string, std::shared_future<Outcome>>    mRunning;
+    size_t          mCacheBudget;
+    size_t          mCacheBytes;
+    MemoryCharge    mCacheCharge;       // mCacheBytes, AnalysisDaemon.cache
+    DaemonProtocol::Stats   mStats;
+
+    std::mutex      mEbadfLock;         // FileDescriptor is a singleton
+
+    std::mutex      mClientLock;
+    std::condition_variable     mClientCond;
+    std::unordered_set<int>     mClients;
+};
+
+#endif
@@ -0,0 +1,46 @@
+#ifndef _ANALYZER_H_
+#define _ANALYZER_H_
+
+#include <string>
+
+#include <sys/types.h>
+
+#include "CancelToken.h"
+
+class Exporter;
+
+// Common driving interface of the analysis engines, used by the GUI threads.
+class Analyzer {
+public:
+    virtual ~Analyzer() = default;
+
+    virtual void    initResources(pid_t, const std::string, unsigned) = 0;
+    virtual void    process() = 0;
+
+    // Share of the work done, 0 to 1, from bytes consumed over the trace
+    // size. Reads only atomics, cheap enough to poll from the UI.
+    virtual double  progress() = 0;
+
+    // Asks a running process() to stop; callable from any thread. process()
+    // then returns early with an empty result and its memory released.
+    virtual void    cancel() {
+        mCancel.cancel();
+    }
+    bool            cancelled() const {
+        return mCancel.cancelled();
+    }
+
+    // Streams results, and with `events` every fd event, to `exporter` while
+    // process() runs. The exporter must outlive the run; nullptr stops it.
+    void            setExporter(Exporter * exporter, bool events = false) {
+        mpExporter    = exporter;
+        mExportEvents = events;
+    }
+
+protected:
+    CancelToken     mCancel;
+    Exporter        *mpExporter = nullptr;
+    bool            mExportEvents = false;
+};
+
+#endif
@@ -0,0 +1,32 @@
+#ifndef _CANCELTOKEN_H_
+#define _CANCELTOKEN_H_
+
+#include <atomic>
+
+// Cooperative stop flag: set from any thread, polled by reader loops and
+// pool tasks. Relaxed ordering is enough, a late read only costs a line.
+class CancelToken {
+public:
+    CancelToken(): mCancelled(false) {}
+
+    void    cancel() {
+        mCancelled.store(true, std::memory_order_relaxed);
+    }
+
+    void    reset() {
+        mCancelled.store(false, std::memory_order_relaxed);
+    }
+
+    bool    cancelled() const {
+        return mCancelled.load(std::memory_order_relaxed);
+    }
+
+private:
+    CancelToken(const CancelToken &) = delete;
+    CancelToken& operator=(const CancelToken &) = delete;
+
+private:
+    std::atomic<bool>   mCancelled;
+};
+
+#endif
@@ -0,0 +1,151 @@
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "Checkpoint.h"
+#include "threadlog.h"
+
+static const char       MAGIC[8]    = {'F', 'D', 'C', 'K', 'P', 'T', 0, 0};
+static const uint32_t   VERSION     = 7;
+static const size_t     HEADERSIZE  = 32;
+
+static uint64_t
+fnv1a(const std::string & data) {
+    uint64_t hash = 1469598103934665603ull;
+    for(unsigned char ch : data) {
+        hash ^= ch;
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+static void
+appendLE(std::string & out, uint64_t value, size_t bytes) {
+    for(size_t indx = 0; indx < bytes; ++indx) {
+        out.push_back(static_cast<char>((value >> (8 * indx)) & 0xff));
+    }
+}
+
+static uint64_t
+readLE(const char * data, size_t bytes) {
+    uint64_t value = 0;
+    for(size_t indx = 0; indx < bytes; ++indx) {
+        value |= static_cast<uint64_t>(static_cast<unsigned char>(data[indx])) << (8 * indx);
+    }
+    return value;
+}
+
+/******************* CheckpointWriter ********************************/
+bool
+CheckpointWriter::commit(
+    const std::string & path
+) {
+    std::string header(MAGIC, sizeof(MAGIC));
+    appendLE(header, VERSION, 4);
+    appendLE(header, 0, 4);
+    appendLE(header, mPayload.size(), 8);
+    appendLE(header, fnv1a(mPayload), 8);
+
+    std::string temp = path + ".tmp";
+    int fd = ::open(temp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if(fd < 0) {
+        std::cerr<<temp<<" can not be created!"<<std::endl;
+        return false;
+    }
+    bool written = true;
+    for(const std::string * part : {&header, &mPayload}) {
+        size_t done = 0;
+        while(written && done < part->size()) {
+            ssize_t bytes = ::write(fd, part->data() + done, part->size() - done);
+            if(bytes < 0 && errno == EINTR) {
+                continue;
+            }
+            if(bytes <= 0) {
+                std::cerr<<"checkpoint write failed: "<<std::strerror(errno)<<std::endl;
+                written = false;
+                break;
+            }
+            done += static_cast<size_t>(bytes);
+        }
+    }
+    // data first, then the rename: a crash leaves the old or the new file
+    if(written && ::fsync(fd) != 0) {
+        written = false;
+    }
+    ::close(fd);
+    if(!written || ::rename(temp.c_str(), path.c_str()) != 0) {
+        ::unlink(temp.c_str());
+        return false;
+    }
+    return true;
+}
+
+void
+CheckpointWriter::putLE(
+    uint64_t    value,
+    size_t      bytes
+) {
+    appendLE(mPayload, value, bytes);
+}
+
+/******************* CheckpointReader ********************************/
+bool
+CheckpointReader::load(
+    const std::string & path
+) {
+    mPayload.clear();
+    mPos = 0;
+    mOk  = false;
+
+    std::ifstream in(path, std::ios::in | std::ios::binary);
+    if(!in.is_open()) {
+        return false;
+    }
+    char header[HEADERSIZE];
+    if(!in.read(header, sizeof(header)) || std::memcmp(header, MAGIC, sizeof(MAGIC)) != 0
+       || readLE(header + 8, 4) != VERSION) {
+        std::cerr<<path<<" is not a checkpoint of this version"<<std::endl;
+        return false;
+    }
+    uint64_t length   = readLE(header + 16, 8);
+    uint64_t checksum = readLE(header + 24, 8);
+    mPayload.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    if(mPayload.size() != length || fnv1a(mPayload) != checksum) {
+        std::cerr<<path<<" is damaged, ignored"<<std::endl;
+        mPayload.clear();
+        return false;
+    }
+    mOk = true;
+    DEG_LOG("checkpoint %s loaded, %zu bytes", path.c_str(), mPayload.size());
+    return true;
+}
+
+std::string
+CheckpointReader::getString() {
+    size_t length = getU32();
+    if(!mOk || mPayload.size() - mPos < length) {
+        mOk = false;
+        return std::string();
+    }
+    std::string text = mPayload.substr(mPos, length);
+    mPos += length;
+    return text;
+}
+
+uint64_t
+CheckpointReader::getLE(
+    size_t  bytes
+) {
+    if(!mOk || mPayload.size() - mPos < bytes) {
+        mOk = false;
+        return 0;
+    }
+    uint64_t value = readLE(mPayload.data() + mPos, bytes);
+    mPos += bytes;
+    return value;
+}
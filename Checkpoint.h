@@ -0,0 +1,82 @@
+#ifndef _CHECKPOINT_H_
+#define _CHECKPOINT_H_
+
+#include <string>
+#include <cstdint>
+
+// Engine state snapshot on disk; the payload coding also serves the
+// analysis daemon protocol.
+//
+//   0  "FDCKPT\0\0"     8  u32 version   12 u32 reserved
+//   16 u64 payload bytes                 24 u64 FNV-1a of the payload
+//   32 payload, little-endian fields in the order the engine put them
+//
+// commit() writes a temporary file, fsyncs it and renames it over the old
+// checkpoint, so the file on disk is always a whole, valid snapshot.
+class CheckpointWriter {
+public:
+    void    putU8(uint8_t value)        { putLE(value, 1); }
+    void    putU32(uint32_t value)      { putLE(value, 4); }
+    void    putU64(uint64_t value)      { putLE(value, 8); }
+    void    putI64(long long value)     { putLE(static_cast<uint64_t>(value), 8); }
+    void    putString(const std::string & text) {
+        putU32(static_cast<uint32_t>(text.size()));
+        mPayload.append(text);
+    }
+
+    size_t  size() const {
+        return mPayload.size();
+    }
+    // The bare payload, for callers that frame it themselves.
+    const std::string & payload() const {
+        return mPayload;
+    }
+
+    // Replaces `path` with the snapshot; false when it could not be written.
+    bool    commit(const std::string & path);
+
+private:
+    void    putLE(uint64_t value, size_t bytes);
+
+    std::string mPayload;
+};
+
+// Reads a snapshot back. Every get fails once the payload is exhausted, so
+// a caller can read a whole record and check ok() once at the end.
+class CheckpointReader {
+public:
+    // false when the file is missing, truncated or fails its checksum
+    bool    load(const std::string & path);
+    // Reads a bare payload from memory instead.
+    void    parse(std::string payload) {
+        mPayload = std::move(payload);
+        mPos = 0;
+        mOk  = true;
+    }
+
+    bool    ok() const {
+        return mOk;
+    }
+    bool    atEnd() const {
+        return mPos == mPayload.size();
+    }
+    // For values that decode but do not fit together.
+    void    fail() {
+        mOk = false;
+    }
+
+    uint8_t     getU8()     { return static_cast<uint8_t>(getLE(1)); }
+    uint32_t    getU32()    { return static_cast<uint32_t>(getLE(4)); }
+    uint64_t    getU64()    { return getLE(8); }
+    long long   getI64()    { return static_cast<long long>(getLE(8)); }
+    std::string getString();
+
+private:
+    uint64_t    getLE(size_t bytes);
+
+    std::string mPayload;
+    size_t      mPos = 0;
+    bool        mOk  = false;
+};
+
+#endif
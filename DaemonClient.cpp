@@ -0,0 +1,192 @@
+#include <cerrno>
+#include <cstring>
+#include <climits>
+
+#include <unistd.h>
+#include <sys/un.h>
+#include <sys/socket.h>
+
+#include "DaemonClient.h"
+#include "Checkpoint.h"
+
+static bool
+socketAddress(const std::string & socket, sockaddr_un & address) {
+    std::memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if(socket.size() >= sizeof(address.sun_path)) {
+        return false;
+    }
+    std::strcpy(address.sun_path, socket.c_str());
+    return true;
+}
+
+static std::string
+absolutePath(const std::string & path) {
+    if(path.empty() || path[0] == '/') {
+        return path;
+    }
+    char cwd[PATH_MAX];
+    if(!getcwd(cwd, sizeof(cwd))) {
+        return path;
+    }
+    return std::string(cwd) + "/" + path;
+}
+
+/******************* public function ********************************/
+DaemonClient::DaemonClient(
+    const std::string & socket
+) : mSocket(socket)
+  , mFd(-1)
+  , mCached(false) {
+}
+
+DaemonClient::~DaemonClient() {
+    if(mFd >= 0) {
+        ::close(mFd);
+    }
+}
+
+bool
+DaemonClient::available(
+    const std::string & socket
+) {
+    DaemonClient client(socket);
+    return client.connect();
+}
+
+bool
+DaemonClient::match(
+    const std::string &             path,
+    pid_t                           pid,
+    DescriptorMatch::MatchResult &  result
+) {
+    std::string response;
+    if(!request(DAEMONOP::MATCH, pid, absolutePath(path), response)) {
+        return false;
+    }
+    CheckpointReader in;
+    in.parse(std::move(response));
+    in.getU8();
+    in.getU8();
+    if(!DaemonProtocol::getMatch(in, result)) {
+        mError = "malformed match result";
+        return false;
+    }
+    return true;
+}
+
+bool
+DaemonClient::ebadf(
+    const std::string & path,
+    pid_t               pid,
+    ResultHandle &      result,
+    size_t              triage
+) {
+    std::string response;
+    if(!request(DAEMONOP::BADFD, pid, absolutePath(path), response, triage)) {
+        return false;
+    }
+    CheckpointReader in;
+    in.parse(std::move(response));
+    in.getU8();
+    in.getU8();
+    auto store = std::make_shared<ResultStore>();
+    if(!DaemonProtocol::getStore(in, *store)) {
+        mError = "malformed EBADF result";
+        return false;
+    }
+    result = store;
+    return true;
+}
+
+bool
+DaemonClient::stats(
+    DaemonProtocol::Stats & stats
+) {
+    std::string response;
+    if(!request(DAEMONOP::STATS, -1, std::string(), response)) {
+        return false;
+    }
+    CheckpointReader in;
+    in.parse(std::move(response));
+    in.getU8();
+    in.getU8();
+    return DaemonProtocol::getStats(in, stats);
+}
+
+bool
+DaemonClient::shutdown() {
+    std::string response;
+    return request(DAEMONOP::SHUTDOWN, -1, std::string(), response);
+}
+
+void
+DaemonClient::abort() {
+    int fd = mFd;
+    if(fd >= 0) {
+        ::shutdown(fd, SHUT_RDWR);
+    }
+}
+
+/******************* private function ********************************/
+bool
+DaemonClient::connect() {
+    if(mFd >= 0) {
+        return true;
+    }
+    sockaddr_un address;
+    if(!socketAddress(mSocket, address)) {
+        mError = mSocket + " is too long for a socket path";
+        return false;
+    }
+    mFd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if(mFd < 0 || ::connect(mFd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) != 0) {
+        mError = "no daemon on " + mSocket + ": " + std::strerror(errno);
+        if(mFd >= 0) {
+            ::close(mFd);
+            mFd = -1;
+        }
+        return false;
+    }
+    return true;
+}
+
+bool
+DaemonClient::request(
+    DAEMONOP            op,
+    pid_t               pid,
+    const std::string & path,
+    std::string &       response,
+    uint64_t            triage
+) {
+    mCached = false;
+    mError.clear();
+    if(!connect()) {
+        return false;
+    }
+    CheckpointWriter out;
+    out.putU8(static_cast<uint8_t>(op));
+    out.putI64(pid);
+    out.putString(path);
+    out.putU64(triage);
+    if(!DaemonProtocol::sendFrame(mFd, out.payload()) || !DaemonProtocol::recvFrame(mFd, response)) {
+        mError = "connection to " + mSocket + " lost";
+        ::close(mFd);
+        mFd = -1;
+        return false;
+    }
+    if(response.size() < 2) {
+        mError = "malformed response";
+        return false;
+    }
+    if(response[0] != 0) {
+        CheckpointReader in;
+        in.parse(response);
+        in.getU8();
+        in.getU8();
+        mError = in.getString();
+        return false;
+    }
+    mCached = response[1] != 0;
+    return true;
+}
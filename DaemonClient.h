@@ -0,0 +1,55 @@
+#ifndef _DAEMONCLIENT_H_
+#define _DAEMONCLIENT_H_
+
+#include <string>
+#include <atomic>
+
+#include <sys/types.h>
+
+#include "DaemonProtocol.h"
+
+// Connection to an AnalysisDaemon. Requests block until the daemon answers;
+// they fail (with error() set) when no daemon listens or the connection
+// drops. Relative trace paths are resolved against our working directory,
+// since the daemon has its own.
+class DaemonClient {
+public:
+    explicit DaemonClient(const std::string & socket = DaemonProtocol::defaultSocket());
+    ~DaemonClient();
+    DaemonClient(const DaemonClient &) = delete;
+    DaemonClient& operator=(const DaemonClient &) = delete;
+
+    // Whether a daemon listens on `socket`.
+    static bool available(const std::string & socket = DaemonProtocol::defaultSocket());
+
+    bool    match(const std::string & path, pid_t pid, DescriptorMatch::MatchResult & result);
+    // `triage` > 0 stops at that many incidents (FileDescriptor::setTriage).
+    bool    ebadf(const std::string & path, pid_t pid, ResultHandle & result, size_t triage = 0);
+    bool    stats(DaemonProtocol::Stats & stats);
+    bool    shutdown();
+
+    // Makes a request blocked in another thread fail at once; the daemon
+    // still finishes the run and caches it.
+    void    abort();
+
+    // whether the last answer came from the daemon's cache
+    bool    cached() const {
+        return mCached;
+    }
+    const std::string & error() const {
+        return mError;
+    }
+
+private:
+    bool    connect();
+    bool    request(DAEMONOP op, pid_t pid, const std::string & path, std::string & response,
+                    uint64_t triage = 0);
+
+private:
+    std::string     mSocket;
+    std::atomic<int>    mFd;            // closed by request(), shut down by abort()
+    bool            mCached;
+    std::string     mError;
+};
+
+#endif
@@ -0,0 +1,298 @@
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+
+#include <unistd.h>
+#include <sys/socket.h>
+
+#include "DaemonProtocol.h"
+#include "Checkpoint.h"
+
+static bool
+transfer(int fd, char * data, size_t total, bool sending) {
+    size_t done = 0;
+    while(done < total) {
+        ssize_t bytes = sending ? ::send(fd, data + done, total - done, MSG_NOSIGNAL)
+                                : ::recv(fd, data + done, total - done, 0);
+        if(bytes < 0 && errno == EINTR) {
+            continue;
+        }
+        if(bytes <= 0) {
+            return false;
+        }
+        done += static_cast<size_t>(bytes);
+    }
+    return true;
+}
+
+static void
+putDouble(CheckpointWriter & out, double value) {
+    uint64_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    out.putU64(bits);
+}
+
+static double
+getDouble(CheckpointReader & in) {
+    uint64_t bits = in.getU64();
+    double   value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+static void
+putLifetimes(CheckpointWriter & out, const std::vector<DescriptorMatch::Lifetime> & lifetimes) {
+    out.putU64(lifetimes.size());
+    for(const auto & lifetime : lifetimes) {
+        out.putI64(lifetime.pid);
+        out.putI64(lifetime.fd);
+        DescriptorMatch::putOpen(out, lifetime.open);
+        out.putI64(lifetime.closeUsec);
+        out.putU8(lifetime.leaked);
+    }
+}
+
+static void
+getLifetimes(CheckpointReader & in, std::vector<DescriptorMatch::Lifetime> & lifetimes) {
+    uint64_t count = in.getU64();
+    lifetimes.clear();
+    for(uint64_t indx = 0; indx < count && in.ok(); ++indx) {
+        DescriptorMatch::Lifetime lifetime;
+        lifetime.pid       = static_cast<pid_t>(in.getI64());
+        lifetime.fd        = static_cast<long>(in.getI64());
+        lifetime.open      = DescriptorMatch::getOpen(in);
+        lifetime.closeUsec = in.getI64();
+        lifetime.leaked    = in.getU8() != 0;
+        lifetimes.push_back(std::move(lifetime));
+    }
+}
+
+/******************* public function ********************************/
+std::string
+DaemonProtocol::defaultSocket() {
+    const char * path = std::getenv("FDTRACED_SOCKET");
+    if(path && *path) {
+        return path;
+    }
+    const char * runtime = std::getenv("XDG_RUNTIME_DIR");
+    if(runtime && *runtime) {
+        return std::string(runtime) + "/fdtraced.sock";
+    }
+    return "/tmp/fdtraced-" + std::to_string(getuid()) + ".sock";
+}
+
+bool
+DaemonProtocol::sendFrame(
+    int                 fd,
+    const std::string & payload
+) {
+    if(payload.size() > MAXFRAME) {
+        return false;
+    }
+    char header[4];
+    uint32_t length = static_cast<uint32_t>(payload.size());
+    for(int indx = 0; indx < 4; ++indx) {
+        header[indx] = static_cast<char>((length >> (8 * indx)) & 0xff);
+    }
+    return transfer(fd, header, sizeof(header), true)
+           && transfer(fd, const_cast<char *>(payload.data()), payload.size(), true);
+}
+
+bool
+DaemonProtocol::recvFrame(
+    int             fd,
+    std::string &   payload
+) {
+    unsigned char header[4];
+    if(!transfer(fd, reinterpret_cast<char *>(header), sizeof(header), false)) {
+        return false;
+    }
+    uint32_t length = header[0] | header[1] << 8 | header[2] << 16 | static_cast<uint32_t>(header[3]) << 24;
+    if(length > MAXFRAME) {
+        return false;
+    }
+    payload.resize(length);
+    return transfer(fd, &payload[0], length, false);
+}
+
+void
+DaemonProtocol::putMatch(
+    CheckpointWriter &                      out,
+    const DescriptorMatch::MatchResult &    result
+) {
+    putLifetimes(out, result.leaks);
+    out.putU64(result.timeline.size());
+    for(const auto & bucket : result.timeline) {
+        out.putI64(bucket.usec);
+        out.putU64(bucket.opened);
+        out.putU64(bucket.cumulative);
+    }
+    putLifetimes(out, result.longest);
+    out.putI64(result.firstUsec);
+    out.putI64(result.lastUsec);
+    out.putU64(result.opens);
+    out.putU64(result.closes);
+    out.putU64(result.unknownCloses);
+    out.putU64(result.badFds);
+    out.putU64(result.pending);
+
+    out.putU64(result.usage.size());
+    for(const auto & element : result.usage) {
+        out.putI64(element.first);
+        out.putU64(element.second.size());
+        for(const auto & point : element.second) {
+            out.putI64(point.usec);
+            out.putI64(point.openFds);
+            out.putI64(point.opens);
+            out.putI64(point.closes);
+            putDouble(out, point.openRate);
+            putDouble(out, point.closeRate);
+        }
+    }
+
+    out.putU64(result.races.size());
+    for(const auto & race : result.races) {
+        RaceDetector::putRace(out, race);
+    }
+    for(size_t count : result.raceCounts) {
+        out.putU64(count);
+    }
+    result.latency.put(out);
+    DescriptorMatch::putTallies(out, result);
+}
+
+bool
+DaemonProtocol::getMatch(
+    CheckpointReader &              in,
+    DescriptorMatch::MatchResult &  result
+) {
+    result = DescriptorMatch::MatchResult();
+    getLifetimes(in, result.leaks);
+    uint64_t buckets = in.getU64();
+    for(uint64_t indx = 0; indx < buckets && in.ok(); ++indx) {
+        DescriptorMatch::LeakBucket bucket;
+        bucket.usec       = in.getI64();
+        bucket.opened     = in.getU64();
+        bucket.cumulative = in.getU64();
+        result.timeline.push_back(bucket);
+    }
+    getLifetimes(in, result.longest);
+    result.firstUsec     = in.getI64();
+    result.lastUsec      = in.getI64();
+    result.opens         = in.getU64();
+    result.closes        = in.getU64();
+    result.unknownCloses = in.getU64();
+    result.badFds        = in.getU64();
+    result.pending       = in.getU64();
+
+    uint64_t pids = in.getU64();
+    for(uint64_t indx = 0; indx < pids && in.ok(); ++indx) {
+        FdTimeline::Series & series = result.usage[static_cast<pid_t>(in.getI64())];
+        uint64_t points = in.getU64();
+        for(uint64_t pos = 0; pos < points && in.ok(); ++pos) {
+            FdTimeline::Point point;
+            point.usec      = in.getI64();
+            point.openFds   = in.getI64();
+            point.opens     = in.getI64();
+            point.closes    = in.getI64();
+            point.openRate  = getDouble(in);
+            point.closeRate = getDouble(in);
+            series.push_back(point);
+        }
+    }
+
+    uint64_t races = in.getU64();
+    for(uint64_t indx = 0; indx < races && in.ok(); ++indx) {
+        result.races.push_back(RaceDetector::getRace(in));
+    }
+    for(size_t & count : result.raceCounts) {
+        count = in.getU64();
+    }
+    result.latency.get(in);
+    DescriptorMatch::getTallies(in, result);
+    return in.ok();
+}
+
+void
+DaemonProtocol::putStore(
+    CheckpointWriter &  out,
+    const ResultStore & store
+) {
+    out.putU64(store.badFds);
+    out.putU64(store.incidents);
+    out.putU8(store.partial ? 1 : 0);
+    out.putU64(store.rows.size());
+    for(const auto & row : store.rows) {
+        out.putI64(row.usec);
+        out.putI64(row.pid);
+        out.putI64(row.fd);
+        out.putU8(static_cast<uint8_t>(row.status));
+        out.putI64(row.incident);
+    }
+}
+
+bool
+DaemonProtocol::getStore(
+    CheckpointReader &  in,
+    ResultStore &       store
+) {
+    store.badFds    = in.getU64();
+    store.incidents = in.getU64();
+    store.partial   = in.getU8() != 0;
+    uint64_t rows = in.getU64();
+    store.rows.clear();
+    for(uint64_t indx = 0; indx < rows && in.ok(); ++indx) {
+        ResultRow row;
+        row.usec   = in.getI64();
+        row.pid    = static_cast<pid_t>(in.getI64());
+        row.fd     = static_cast<fd_t>(in.getI64());
+        row.status = static_cast<FDSTATUS>(in.getU8());
+        row.incident = in.getI64();
+        store.rows.push_back(row);
+    }
+    store.account();
+    return in.ok();
+}
+
+void
+DaemonProtocol::putStats(
+    CheckpointWriter &  out,
+    const Stats &       stats
+) {
+    out.putU64(stats.requests);
+    out.putU64(stats.hits);
+    out.putU64(stats.shared);
+    out.putU64(stats.entries);
+    out.putU64(stats.bytes);
+    out.putU64(stats.budget);
+    out.putU32(stats.threads);
+    out.putU64(stats.memory.size());
+    for(const auto & usage : stats.memory) {
+        out.putString(usage.name);
+        out.putU64(usage.current);
+        out.putU64(usage.peak);
+    }
+}
+
+bool
+DaemonProtocol::getStats(
+    CheckpointReader &  in,
+    Stats &             stats
+) {
+    stats.requests = in.getU64();
+    stats.hits     = in.getU64();
+    stats.shared   = in.getU64();
+    stats.entries  = in.getU64();
+    stats.bytes    = in.getU64();
+    stats.budget   = in.getU64();
+    stats.threads  = in.getU32();
+    stats.memory.clear();
+    for(uint64_t accounts = in.getU64(); in.ok() && accounts > 0; --accounts) {
+        MemoryStats::Usage usage;
+        usage.name    = in.getString();
+        usage.current = in.getU64();
+        usage.peak    = in.getU64();
+        stats.memory.push_back(usage);
+    }
+    return in.ok();
+}
@@ -0,0 +1,67 @@
+#ifndef _DAEMONPROTOCOL_H_
+#define _DAEMONPROTOCOL_H_
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+#include <sys/types.h>
+
+#include "DescriptorMatch.h"
+#include "ResultStore.h"
+#include "MemoryStats.h"
+
+class CheckpointWriter;
+class CheckpointReader;
+
+enum class DAEMONOP : uint8_t {
+    MATCH = 1,          // DescriptorMatch result
+    BADFD,              // FileDescriptor (EBADF pass) result
+    STATS,
+    SHUTDOWN,
+};
+
+// Wire format between AnalysisDaemon and DaemonClient over a Unix stream
+// socket. Every message is a frame: u32 payload bytes, then the payload in
+// CheckpointWriter coding.
+//
+//   request     u8 op, i64 pid, string trace path, u64 triage incidents
+//               (BADFD only, 0 for a full scan)
+//   response    u8 status (0 ok), u8 served from cache, then
+//               ok:    the MatchResult, ResultStore or Stats
+//               error: string message
+class DaemonProtocol {
+public:
+    struct Stats {
+        uint64_t    requests    = 0;
+        uint64_t    hits        = 0;    // answered from the result cache
+        uint64_t    shared      = 0;    // joined a run already in progress
+        uint64_t    entries     = 0;
+        uint64_t    bytes       = 0;    // encoded results held
+        uint64_t    budget      = 0;
+        uint32_t    threads     = 0;
+        std::vector<MemoryStats::Usage> memory; // the daemon's structures
+    };
+
+    static const uint32_t   MAXFRAME = 1u << 30;
+
+    // $FDTRACED_SOCKET, else $XDG_RUNTIME_DIR/fdtraced.sock, else
+    // /tmp/fdtraced-<uid>.sock
+    static std::string  defaultSocket();
+
+    // false on EOF, an I/O error or an oversized frame
+    static bool     sendFrame(int fd, const std::string & payload);
+    static bool     recvFrame(int fd, std::string & payload);
+
+    static void     putMatch(CheckpointWriter & out, const DescriptorMatch::MatchResult & result);
+    static bool     getMatch(CheckpointReader & in, DescriptorMatch::MatchResult & result);
+    static void     putStore(CheckpointWriter & out, const ResultStore & store);
+    static bool     getStore(CheckpointReader & in, ResultStore & store);
+    static void     putStats(CheckpointWriter & out, const Stats & stats);
+    static bool     getStats(CheckpointReader & in, Stats & stats);
+
+private:
+    DaemonProtocol() = delete;
+};
+
+#endif
@@ -0,0 +1,1037 @@
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <algorithm>
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "DescriptorMatch.h"
+#include "Checkpoint.h"
+#include "Exporter.h"
+#include "TraceIndex.h"
+
+static bool
+shorterLife(const DescriptorMatch::Lifetime & lhs, const DescriptorMatch::Lifetime & rhs) {
+    return lhs.duration() > rhs.duration();
+}
+
+/******************* public function ********************************/
+DescriptorMatch*
+DescriptorMatch::getInstance() {
+    static DescriptorMatch instance;
+    return &instance;
+}
+
+DescriptorMatch::DescriptorMatch(
+) : mProcessId(-1)
+  , mBucketUsec(0)
+  , mTimelineUsec(1000000)
+  , mTables(MemoryStats::getInstance()->account("DescriptorMatch.tables"))
+  , mDeferredCount(0)
+  , mDeferredCharge(MemoryStats::getInstance()->account("DescriptorMatch.deferred"))
+  , mLongest(shorterLife)
+  , mpIndex(nullptr)
+  , mReadLine(0)
+  , mAppliedLine(0)
+  , mAppliedBytes(0)
+  , mFileBytes(0)
+  , mCheckpointBytes(CHECKPOINTBYTES)
+  , mCheckpointAt(0)
+  , mResumedFrom(0)
+  , mInFlight(0)
+  , mMaxInFlight(4)
+  , mThreadCnt(1)
+  , mpThreadPool(nullptr) {
+}
+
+void
+DescriptorMatch::initResources(
+    pid_t               pid,
+    const std::string   file,
+    unsigned            threads
+) {
+    mProcessId = pid;
+    mFilePath  = file;
+    mThreadCnt = threads > std::thread::hardware_concurrency() ? std::thread::hardware_concurrency() : threads;
+    if(mThreadCnt == 0) {
+        mThreadCnt = 1;
+    }
+    // enough parsed chunks in flight to keep every worker busy, no more
+    mMaxInFlight = 2 * mThreadCnt + 2;
+
+    mCancel.reset();
+    mReadLine    = 0;
+    mAppliedLine = 0;
+    mAppliedBytes = 0;
+    mFileBytes   = 0;
+    mInFlight    = 0;
+    mCheckpointAt = 0;
+    mResumedFrom = 0;
+
+    mTables.clear();
+    mFamily.clear();
+    mDeferred.clear();
+    mDeferredCount = 0;
+    mDeferredCharge.set(0);
+    mBuilder.clear();
+    mRaces.clear();
+    mLatency.clear();
+    mLongest = LongestQueue(shorterLife);
+    mResult  = MatchResult();
+    mTimeline.reset(mTimelineUsec);
+    DEG_LOG("Descriptor Match init: pid %d, file %s, threads %d", mProcessId, mFilePath.c_str(), mThreadCnt);
+}
+
+void
+DescriptorMatch::setLeakBucket(
+    long long   usec
+) {
+    mBucketUsec = usec < 0 ? 0 : usec;
+}
+
+void
+DescriptorMatch::setTimelineBucket(
+    long long   usec
+) {
+    mTimelineUsec = usec > 0 ? usec : 1000000;
+}
+
+void
+DescriptorMatch::setCheckpoint(
+    const std::string & path,
+    uint64_t            everyBytes
+) {
+    mCheckpointPath  = path;
+    mCheckpointBytes = everyBytes > 0 ? everyBytes : CHECKPOINTBYTES;
+    DEG_LOG("checkpoint to %s every %llu bytes", mCheckpointPath.c_str(),
+            static_cast<unsigned long long>(mCheckpointBytes));
+}
+
+void
+DescriptorMatch::process() {
+    mpThreadPool = ThreadPool::getInstance(mThreadCnt);
+    mpThreadPool->adjust(mThreadCnt);
+
+    auto in = TraceReader::open(mFilePath, mpThreadPool);
+    if(!in) {
+        std::cerr<<mFilePath<<" does not exist!"<<std::endl;
+        return ;
+    }
+    mFileBytes = in->size();
+    if(mpIndex) {
+        mpIndex->reset(mFilePath);
+    }
+
+    uint64_t    size = 0;
+    long long   mtime = 0;
+    bool        checkpointing = !mCheckpointPath.empty() && traceIdentity(size, mtime);
+    uint64_t    offset = 0;
+    if(checkpointing && loadCheckpoint(offset)) {
+        if(in->seek(offset)) {
+            mResumedFrom  = offset;
+            mCheckpointAt = offset;
+            mAppliedBytes = offset;
+            std::cout<<"Resume "<<mFilePath<<" at byte "<<offset<<std::endl;
+        } else {
+            release();
+            offset = 0;
+            mReadLine = mAppliedLine = 0;
+        }
+    }
+
+    {
+        HandlerThread handler;
+        auto chunk = std::make_shared<Chunk>();
+        std::string_view line;
+        uint64_t    consumed = in->consumed();
+        bool        stable   = in->stable();
+        while(in->next(line)) {
+            if(cancelled()) {
+                break;
+            }
+            if(chunk->count == 0) {
+                chunk->offset = offset;
+            }
+            if(!stable) {
+                chunk->text.append(line.data(), line.size()).push_back('\n');
+            } else if(chunk->count == 0) {
+                chunk->lines = line;
+            } else {
+                chunk->lines = std::string_view(chunk->lines.data(), line.data() + line.size() - chunk->lines.data());
+            }
+            offset += line.size() + 1;
+            chunk->bytes += in->consumed() - consumed;
+            consumed = in->consumed();
+            ++chunk->count;
+            ++mReadLine;
+            if(chunk->count == CHUNKLINES) {
+                submit(chunk, *in, handler);
+                chunk = std::make_shared<Chunk>();
+                if(checkpointing && offset - mCheckpointAt >= mCheckpointBytes) {
+                    // the state is only whole at a chunk boundary with nothing in flight
+                    drain();
+                    if(!cancelled()) {
+                        saveCheckpoint(offset);
+                    }
+                }
+            }
+        }
+        if(chunk->count > 0 && !cancelled()) {
+            submit(chunk, *in, handler);
+        }
+        if(cancelled()) {
+            // only ours: another match may share the pool
+            mpThreadPool->purge(this);
+        }
+        // leaving the scope drains the handler: every chunk is applied
+    }
+
+    if(cancelled()) {
+        release();
+        DEG_LOG("Descriptor Match cancelled after %ld lines", mReadLine.load());
+        return ;
+    }
+    finish();
+    if(mpExporter) {
+        mpExporter->flush();
+    }
+    if(checkpointing) {
+        ::unlink(mCheckpointPath.c_str());
+    }
+    DEG_LOG("Descriptor Match end: %ld lines, %zu leaks", mAppliedLine.load(), mResult.leaks.size());
+}
+
+void
+DescriptorMatch::beginLive() {
+    DEG_LOG("Descriptor Match live begin: pid %d", mProcessId);
+}
+
+void
+DescriptorMatch::feedLive(
+    FdCall &&   call
+) {
+    if(cancelled()) {
+        return ;
+    }
+    mBuilder.feed(std::move(call), [this](const FdEvent & event){ apply(event); },
+                  [this](const FdCall & whole){ completed(whole); });
+    ++mAppliedLine;
+}
+
+void
+DescriptorMatch::endLive() {
+    if(cancelled()) {
+        release();
+        return ;
+    }
+    finish();
+    if(mpExporter) {
+        mpExporter->flush();
+    }
+    DEG_LOG("Descriptor Match live end: %ld calls, %zu leaks", mAppliedLine.load(), mResult.leaks.size());
+}
+
+void
+DescriptorMatch::cancel() {
+    Analyzer::cancel();
+    // wake a reader blocked on a full in-flight window
+    std::lock_guard<std::mutex> lock(mFlightLock);
+    mFlightCond.notify_all();
+}
+
+double
+DescriptorMatch::progress() {
+    if(mFileBytes == 0) {
+        return 0;
+    }
+    return std::min(1.0, 1.0 * mAppliedBytes / mFileBytes);
+}
+
+DescriptorMatch::MatchResult
+DescriptorMatch::getResult() {
+    return mResult;
+}
+
+/******************* private function ********************************/
+MemoryAccount &
+DescriptorMatch::callAccount() {
+    static MemoryAccount & account = MemoryStats::getInstance()->account("DescriptorMatch.calls");
+    return account;
+}
+
+std::vector<FdCall>
+DescriptorMatch::parseChunk(
+    std::shared_ptr<Chunk>  chunk,
+    const CancelToken *     cancel
+) {
+    std::vector<FdCall> calls;
+    if(cancel->cancelled()) {
+        return calls;
+    }
+    FdCall call;
+    std::string_view rest   = chunk->text.empty() ? chunk->lines : std::string_view(chunk->text);
+    uint64_t         offset = chunk->offset;
+    for(size_t indx = 0; indx < chunk->count; ++indx) {
+        std::string_view line = rest.substr(0, rest.find('\n'));
+        if(FdCall::fromLine(line, offset, call)) {
+            calls.push_back(std::move(call));
+        }
+        offset += line.size() + 1;
+        rest.remove_prefix(std::min(rest.size(), line.size() + 1));
+    }
+    // parsed calls wait for the apply thread, which gives them back
+    callAccount().add(calls.size() * sizeof(FdCall));
+    return calls;
+}
+
+void
+DescriptorMatch::submit(
+    std::shared_ptr<Chunk>  chunk,
+    TraceReader &           reader,
+    HandlerThread &         handler
+) {
+    {
+        std::unique_lock<std::mutex> lock(mFlightLock);
+        mFlightCond.wait(lock, [&](){return mInFlight < mMaxInFlight || cancelled();});
+        if(cancelled()) {
+            return ;
+        }
+        ++mInFlight;
+    }
+
+    long        lines = static_cast<long>(chunk->count);
+    uint64_t    bytes = chunk->bytes;
+    uint64_t    end   = chunk->offset + (chunk->text.empty() ? chunk->lines.size() + 1 : chunk->text.size());
+    chunk->memory.set(chunk->text.empty() ? 0 : chunk->text.capacity());
+    auto res = mpThreadPool->enqueueFor(this, parseChunk, chunk, &mCancel);
+    handler.enqueue([this, res, lines, bytes, end, &reader](){
+        // wait even when cancelled: a running parse still reads the chunk
+        std::vector<FdCall> calls;
+        try {
+            calls = res.get();
+        } catch(const std::future_error &) {
+            // purged by cancel()
+        }
+        if(!cancelled()) {
+            for(auto & call : calls) {
+                mBuilder.feed(std::move(call), [this](const FdEvent & event){ apply(event); },
+                              [this](const FdCall & whole){ completed(whole); });
+            }
+            mAppliedLine += lines;
+            mAppliedBytes += bytes;
+            // the parse is done with the lines in place in the mapping
+            reader.release(end);
+            mDeferredCharge.set(mDeferredCount * sizeof(FdEvent));
+        }
+        callAccount().sub(calls.size() * sizeof(FdCall));
+
+        std::lock_guard<std::mutex> lock(mFlightLock);
+        --mInFlight;
+        mFlightCond.notify_one();
+    });
+}
+
+bool
+DescriptorMatch::selected(
+    pid_t   pid
+) const {
+    return mProcessId < 0 || pid == mProcessId || mFamily.count(pid) > 0;
+}
+
+void
+DescriptorMatch::apply(
+    const FdEvent & event
+) {
+    if(event.usec >= 0) {
+        if(mResult.firstUsec < 0) {
+            mResult.firstUsec = event.usec;
+        }
+        mResult.lastUsec = std::max(mResult.lastUsec, event.usec);
+    }
+    if(mpIndex) {
+        mpIndex->add(event);
+    }
+
+    if(event.kind != FDEVENT::SPAWN && mBuilder.spawning() > 0
+       && mTables.find(event.pid) == LiveTables::NONE) {
+        if(mDeferredCount < DEFERLEN) {
+            mDeferred[event.pid].push_back(event);
+            ++mDeferredCount;
+            return ;
+        }
+        undefer();
+    }
+    update(event);
+    if(mDeferredCount > 0 && mBuilder.spawning() == 0) {
+        // no clone left that could claim them
+        undefer();
+    }
+}
+
+void
+DescriptorMatch::update(
+    const FdEvent & event
+) {
+    if(mExportEvents && mpExporter && selected(event.pid)) {
+        mpExporter->write(event);
+    }
+
+    if(event.kind == FDEVENT::EXIT) {
+        leave(event);
+        return ;
+    }
+    if(event.kind == FDEVENT::SPAWN) {
+        if(mProcessId >= 0 && selected(event.pid)) {
+            mFamily.insert(event.child);
+        }
+        LiveTables::Id old = mTables.find(event.child);
+        mTables.spawn(event.pid, event.child, event.shared);
+        if(old != LiveTables::NONE && mTables.users(old) == 0) {
+            mRaces.drop(old);
+        }
+        auto it = mDeferred.find(event.child);
+        if(it != mDeferred.end()) {
+            std::vector<FdEvent> events = std::move(it->second);
+            mDeferred.erase(it);
+            mDeferredCount -= events.size();
+            for(const auto & deferred : events) {
+                update(deferred);
+            }
+        }
+        return ;
+    }
+
+    LiveTables::Id table = mTables.of(event.pid);
+    pid_t owner  = mTables.owner(table);
+    bool  report = selected(event.pid);
+    switch(event.kind) {
+    case FDEVENT::OPEN: {
+        ++mResult.opens;
+        mTimeline.add(owner, event.usec, 1, 0);
+        if(event.fd >= LiveTables::MAXFD) {
+            break;
+        }
+
+        if(const LiveTables::Slot * live = mTables.get(table, event.fd)) {
+            // dup2/dup3 onto a live fd, or a close we never saw
+            countClose(owner, table, *live, event.usec);
+            retire(table, event.fd, *live, event.usec);
+            if(report) {
+                ++mResult.balance[event.fd].closes;
+            }
+        }
+        if(report) {
+            ++mResult.balance[event.fd].opens;
+        }
+        mRaces.open(table, event.fd, event);
+        LiveTables::Slot & slot = mTables.put(table, event.fd);
+        slot.origin       = mTables.serial(table);
+        slot.value.tid    = event.pid;
+        slot.value.call   = event.call;
+        slot.value.usec   = event.usec;
+        slot.value.offset = event.offset;
+        slot.value.detail = event.detail;
+        break;
+    }
+    case FDEVENT::CLOSE: {
+        mRaces.close(table, owner, event.fd, event, report);
+        const LiveTables::Slot * live = mTables.get(table, event.fd);
+        if(!live) {
+            ++mResult.unknownCloses;
+            mTimeline.add(owner, event.usec, 0, 1, 1);
+        } else {
+            ++mResult.closes;
+            countClose(owner, table, *live, event.usec);
+            if(report) {
+                ++mResult.balance[event.fd].closes;
+            }
+            retire(table, event.fd, *live, event.usec);
+            mTables.erase(table, event.fd);
+        }
+        break;
+    }
+    case FDEVENT::CLOSERANGE: {
+        std::vector<long> fds;
+        mTables.visit(table, event.fd, event.last, [&](long fd, const LiveTables::Slot & slot) {
+            ++mResult.closes;
+            if(report) {
+                ++mResult.balance[fd].closes;
+            }
+            countClose(owner, table, slot, event.usec);
+            retire(table, fd, slot, event.usec);
+            fds.push_back(fd);
+        });
+        for(long fd : fds) {
+            mRaces.close(table, owner, fd, event, report);
+            mTables.erase(table, fd);
+        }
+        break;
+    }
+    case FDEVENT::BADFD:
+        mRaces.badFd(table, owner, event, report);
+        if(report) {
+            ++mResult.badFds;
+            ++mResult.ebadf[BadFdKey(event.call, event.fd)];
+        }
+        break;
+    case FDEVENT::SPAWN:
+    case FDEVENT::EXIT:
+        break;
+    }
+}
+
+void
+DescriptorMatch::completed(
+    const FdCall &  call
+) {
+    if(!selected(call.pid)) {
+        return ;
+    }
+    ++mResult.calls[static_cast<size_t>(call.call)];
+    if(call.duration >= 0) {
+        mLatency.add(call);
+    }
+}
+
+void
+DescriptorMatch::undefer() {
+    // tasks that were not made by a clone of the trace: own tables
+    auto deferred = std::move(mDeferred);
+    mDeferred.clear();
+    mDeferredCount = 0;
+    for(const auto & task : deferred) {
+        for(const auto & event : task.second) {
+            update(event);
+        }
+    }
+}
+
+void
+DescriptorMatch::retire(
+    LiveTables::Id              table,
+    long                        fd,
+    const LiveTables::Slot &    slot,
+    long long                   usec
+) {
+    // an inherited copy: the lifetime belongs to the table it was opened in
+    pid_t pid = mTables.owner(table);
+    if(!mTables.openedIn(table, slot) || !selected(pid)) {
+        return ;
+    }
+    Lifetime life;
+    life.pid       = pid;
+    life.fd        = fd;
+    life.open      = slot.value;
+    life.closeUsec = usec;
+    if(mpExporter) {
+        mpExporter->write(life);
+    }
+
+    if(mLongest.size() < LONGESTLEN) {
+        mLongest.push(std::move(life));
+    } else if(life.duration() > mLongest.top().duration()) {
+        mLongest.pop();
+        mLongest.push(std::move(life));
+    }
+}
+
+void
+DescriptorMatch::leave(
+    const FdEvent & event
+) {
+    LiveTables::Id table = mTables.find(event.pid);
+    if(table == LiveTables::NONE) {
+        return ;
+    }
+    pid_t owner = mTables.owner(table);
+    bool  last  = mTables.users(table) == 1;
+    if(last) {
+        // the kernel closes what the last task of a table still holds
+        mTables.visit(table, 0, LiveTables::MAXFD, [&](long, const LiveTables::Slot & slot) {
+            countClose(owner, table, slot, event.usec);
+        });
+        leak(table, event.usec >= 0 ? event.usec : mResult.lastUsec);
+        mRaces.drop(table);
+    }
+    mTables.exit(event.pid);
+    // the kernel hands the tid out again, to a task that is not ours
+    if(event.pid != owner) {
+        mFamily.erase(event.pid);
+    }
+    if(last) {
+        mFamily.erase(owner);
+    }
+}
+
+void
+DescriptorMatch::countClose(
+    pid_t                       owner,
+    LiveTables::Id              table,
+    const LiveTables::Slot &    slot,
+    long long                   usec
+) {
+    // an inherited copy never counted as open for this owner
+    mTimeline.add(owner, usec, 0, 1, mTables.openedIn(table, slot) ? 0 : 1);
+}
+
+void
+DescriptorMatch::leak(
+    LiveTables::Id  table,
+    long long       usec
+) {
+    pid_t pid = mTables.owner(table);
+    if(!selected(pid)) {
+        return ;
+    }
+    mTables.visit(table, 0, LiveTables::MAXFD, [&](long fd, const LiveTables::Slot & slot) {
+        if(!mTables.openedIn(table, slot)) {
+            return ;
+        }
+        Lifetime life;
+        life.pid       = pid;
+        life.fd        = fd;
+        life.open      = slot.value;
+        life.closeUsec = usec;
+        life.leaked    = true;
+        if(mpExporter) {
+            mpExporter->write(life);
+        }
+        mResult.leaks.push_back(life);
+    });
+}
+
+void
+DescriptorMatch::release() {
+    mTables.clear();
+    mFamily.clear();
+    std::unordered_map<pid_t, std::vector<FdEvent>>().swap(mDeferred);
+    mDeferredCount = 0;
+    mDeferredCharge.set(0);
+    mBuilder.clear();
+    mRaces.clear();
+    mLatency.clear();
+    mLongest = LongestQueue(shorterLife);
+    mResult  = MatchResult();
+    mTimeline.reset(mTimelineUsec);
+}
+
+void
+DescriptorMatch::finish() {
+    undefer();
+    mResult.pending = mBuilder.pending();
+    mResult.usage   = mTimeline.series();
+
+    for(LiveTables::Id table = 0; table < mTables.count(); ++table) {
+        if(mTables.users(table) > 0) {
+            leak(table, mResult.lastUsec);
+        }
+    }
+    std::sort(mResult.leaks.begin(), mResult.leaks.end(),
+              [](const Lifetime & lhs, const Lifetime & rhs){ return lhs.open.usec < rhs.open.usec; });
+
+    // longest lived: closed fds kept during the pass plus every leak
+    std::vector<Lifetime> longest;
+    while(!mLongest.empty()) {
+        longest.push_back(mLongest.top());
+        mLongest.pop();
+    }
+    longest.insert(longest.end(), mResult.leaks.begin(), mResult.leaks.end());
+    std::sort(longest.begin(), longest.end(),
+              [](const Lifetime & lhs, const Lifetime & rhs){ return lhs.duration() > rhs.duration(); });
+    if(longest.size() > LONGESTLEN) {
+        longest.resize(LONGESTLEN);
+    }
+    mResult.longest = std::move(longest);
+
+    // leak counts over time, by the time the leaked fd was opened
+    if(mResult.firstUsec >= 0 && !mResult.leaks.empty()) {
+        long long span   = mResult.lastUsec - mResult.firstUsec + 1;
+        long long bucket = mBucketUsec > 0 ? mBucketUsec
+                         : std::max<long long>(1, (span + LEAKBUCKETS - 1) / LEAKBUCKETS);
+        size_t    count  = static_cast<size_t>((span + bucket - 1) / bucket);
+        mResult.timeline.resize(count);
+        for(size_t indx = 0; indx < count; ++indx) {
+            mResult.timeline[indx].usec = mResult.firstUsec + static_cast<long long>(indx) * bucket;
+        }
+        for(const auto & leak : mResult.leaks) {
+            if(leak.open.usec < 0) {
+                continue;
+            }
+            size_t indx = static_cast<size_t>((leak.open.usec - mResult.firstUsec) / bucket);
+            ++mResult.timeline[std::min(indx, count - 1)].opened;
+        }
+        size_t cumulative = 0;
+        for(auto & element : mResult.timeline) {
+            cumulative += element.opened;
+            element.cumulative = cumulative;
+        }
+    }
+
+    mResult.races      = mRaces.races();
+    mResult.raceCounts = mRaces.counts();
+    mResult.latency    = std::move(mLatency);
+    mLatency.clear();
+
+    DEG_LOG("fd tables: %zu ids for %zu live tasks", mTables.count(), mTables.tasks().size());
+    mTables.clear();
+}
+
+void
+DescriptorMatch::drain() {
+    std::unique_lock<std::mutex> lock(mFlightLock);
+    mFlightCond.wait(lock, [&](){return mInFlight == 0 || cancelled();});
+}
+
+bool
+DescriptorMatch::traceIdentity(
+    uint64_t &  size,
+    long long & mtime
+) const {
+    struct stat info;
+    if(stat(mFilePath.c_str(), &info) != 0 || !S_ISREG(info.st_mode)) {
+        return false;
+    }
+    size  = static_cast<uint64_t>(info.st_size);
+    mtime = static_cast<long long>(info.st_mtim.tv_sec) * 1000000000ll + info.st_mtim.tv_nsec;
+    return true;
+}
+
+bool
+DescriptorMatch::saveCheckpoint(
+    uint64_t    offset
+) {
+    // called by the reader after drain(): the apply thread is idle
+    auto begin = std::chrono::steady_clock::now();
+    uint64_t    size = 0;
+    long long   mtime = 0;
+    if(!traceIdentity(size, mtime)) {
+        return false;
+    }
+
+    CheckpointWriter out;
+    out.putString(mFilePath);
+    out.putU64(size);
+    out.putI64(mtime);
+    out.putI64(mProcessId);
+    out.putI64(mTimeline.bucket());
+
+    out.putU64(offset);
+    out.putU64(static_cast<uint64_t>(mAppliedLine.load()));
+    out.putI64(mResult.firstUsec);
+    out.putI64(mResult.lastUsec);
+    out.putU64(mResult.opens);
+    out.putU64(mResult.closes);
+    out.putU64(mResult.unknownCloses);
+    out.putU64(mResult.badFds);
+
+    // tables are written out whole: pages shared by copies are not shared
+    // any more after a resume
+    out.putU64(mTables.count());
+    for(LiveTables::Id table = 0; table < mTables.count(); ++table) {
+        out.putI64(mTables.owner(table));
+        out.putU64(mTables.serial(table));
+        out.putU64(mTables.size(table));
+        mTables.visit(table, 0, LiveTables::MAXFD, [&](long fd, const LiveTables::Slot & slot) {
+            out.putI64(fd);
+            out.putU64(slot.origin);
+            putOpen(out, slot.value);
+        });
+    }
+    out.putU64(mTables.tasks().size());
+    for(const auto & task : mTables.tasks()) {
+        out.putI64(task.first);
+        out.putU64(task.second);
+    }
+    out.putU64(mFamily.size());
+    for(pid_t pid : mFamily) {
+        out.putI64(pid);
+    }
+    out.putU64(mDeferredCount);
+    for(const auto & task : mDeferred) {
+        for(const auto & event : task.second) {
+            out.putI64(event.pid);
+            out.putI64(event.usec);
+            out.putU8(static_cast<uint8_t>(event.call));
+            out.putU8(static_cast<uint8_t>(event.kind));
+            out.putI64(event.fd);
+            out.putI64(event.last);
+            out.putU64(event.offset);
+            out.putU8(event.joined);
+            out.putString(event.detail);
+        }
+    }
+
+    const auto & pending = mBuilder.pendingCalls();
+    out.putU64(pending.size());
+    for(const auto & element : pending) {
+        const FdCall & call = element.second;
+        out.putI64(call.pid);
+        out.putI64(call.usec);
+        out.putU8(static_cast<uint8_t>(call.call));
+        out.putU8(static_cast<uint8_t>(call.phase));
+        out.putI64(call.arg0);
+        out.putI64(call.arg1);
+        out.putI64(call.pair0);
+        out.putI64(call.pair1);
+        out.putU8(call.dupCmd);
+        out.putU8(call.shareFiles);
+        out.putI64(call.ret);
+        out.putU8(call.hasRet);
+        out.putU8(call.ebadf);
+        out.putU8(call.joined);
+        out.putU64(call.offset);
+        out.putString(call.detail);
+    }
+
+    LongestQueue longest = mLongest;
+    out.putU64(longest.size());
+    while(!longest.empty()) {
+        const Lifetime & life = longest.top();
+        out.putI64(life.pid);
+        out.putI64(life.fd);
+        putOpen(out, life.open);
+        out.putI64(life.closeUsec);
+        longest.pop();
+    }
+    // leaks of tables already gone
+    out.putU64(mResult.leaks.size());
+    for(const auto & life : mResult.leaks) {
+        out.putI64(life.pid);
+        out.putI64(life.fd);
+        putOpen(out, life.open);
+        out.putI64(life.closeUsec);
+    }
+
+    mRaces.put(out);
+    mLatency.put(out);
+    putTallies(out, mResult);
+
+    auto counts = mTimeline.counts();
+    out.putU64(counts.size());
+    for(const auto & element : counts) {
+        out.putI64(element.first);
+        out.putI64(element.second.base);
+        out.putU64(element.second.counts.size());
+        for(const auto & bucket : element.second.counts) {
+            out.putI64(bucket.opens);
+            out.putI64(bucket.closes);
+            out.putI64(bucket.untracked);
+        }
+    }
+
+    if(!out.commit(mCheckpointPath)) {
+        return false;
+    }
+    mCheckpointAt = offset;
+    DEG_LOG("checkpoint at byte %llu: %zu bytes in %.3f ms", static_cast<unsigned long long>(offset), out.size(),
+            std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count());
+    return true;
+}
+
+bool
+DescriptorMatch::loadCheckpoint(
+    uint64_t &  offset
+) {
+    CheckpointReader in;
+    if(!in.load(mCheckpointPath)) {
+        return false;
+    }
+    uint64_t    size = 0;
+    long long   mtime = 0;
+    traceIdentity(size, mtime);
+    if(in.getString() != mFilePath || in.getU64() != size || in.getI64() != mtime
+       || in.getI64() != mProcessId || in.getI64() != mTimeline.bucket()) {
+        std::cout<<mCheckpointPath<<" belongs to another trace or setting, start over"<<std::endl;
+        return false;
+    }
+
+    offset = in.getU64();
+    mAppliedLine = mReadLine = static_cast<long>(in.getU64());
+    mResult.firstUsec     = in.getI64();
+    mResult.lastUsec      = in.getI64();
+    mResult.opens         = in.getU64();
+    mResult.closes        = in.getU64();
+    mResult.unknownCloses = in.getU64();
+    mResult.badFds        = in.getU64();
+
+    uint64_t tables = in.getU64();
+    for(uint64_t indx = 0; in.ok() && indx < tables; ++indx) {
+        pid_t    owner  = static_cast<pid_t>(in.getI64());
+        uint64_t serial = in.getU64();
+        LiveTables::Id table = mTables.create(owner, serial);
+        for(uint64_t fds = in.getU64(); in.ok() && fds > 0; --fds) {
+            long fd = static_cast<long>(in.getI64());
+            uint64_t origin = in.getU64();
+            OpenRecord record = getOpen(in);
+            if(fd < 0 || fd >= LiveTables::MAXFD || origin == 0) {
+                in.fail();
+                break;
+            }
+            LiveTables::Slot & slot = mTables.put(table, fd);
+            slot.origin = origin;
+            slot.value  = std::move(record);
+        }
+    }
+    for(uint64_t tasks = in.getU64(); in.ok() && tasks > 0; --tasks) {
+        pid_t tid = static_cast<pid_t>(in.getI64());
+        uint64_t table = in.getU64();
+        if(table >= tables) {
+            in.fail();
+            break;
+        }
+        mTables.assign(tid, static_cast<LiveTables::Id>(table));
+    }
+    mTables.reclaim();
+    for(uint64_t pids = in.getU64(); in.ok() && pids > 0; --pids) {
+        mFamily.insert(static_cast<pid_t>(in.getI64()));
+    }
+    for(uint64_t events = in.getU64(); in.ok() && events > 0; --events) {
+        FdEvent event;
+        event.pid    = static_cast<pid_t>(in.getI64());
+        event.usec   = in.getI64();
+        event.call   = static_cast<SYSCALL>(in.getU8());
+        event.kind   = static_cast<FDEVENT>(in.getU8());
+        event.fd     = static_cast<long>(in.getI64());
+        event.last   = static_cast<long>(in.getI64());
+        event.offset = in.getU64();
+        event.joined = in.getU8();
+        event.detail = in.getString();
+        mDeferred[event.pid].push_back(std::move(event));
+        ++mDeferredCount;
+    }
+
+    for(uint64_t calls = in.getU64(); in.ok() && calls > 0; --calls) {
+        FdCall call;
+        call.pid    = static_cast<pid_t>(in.getI64());
+        call.usec   = in.getI64();
+        call.call   = static_cast<SYSCALL>(in.getU8());
+        call.phase  = static_cast<PHASE>(in.getU8());
+        call.arg0   = static_cast<long>(in.getI64());
+        call.arg1   = static_cast<long>(in.getI64());
+        call.pair0  = static_cast<long>(in.getI64());
+        call.pair1  = static_cast<long>(in.getI64());
+        call.dupCmd = in.getU8();
+        call.shareFiles = in.getU8();
+        call.ret    = static_cast<long>(in.getI64());
+        call.hasRet = in.getU8();
+        call.ebadf  = in.getU8();
+        call.joined = in.getU8();
+        call.offset = in.getU64();
+        call.detail = in.getString();
+        mBuilder.restore(std::move(call));
+    }
+
+    for(uint64_t lives = in.getU64(); in.ok() && lives > 0; --lives) {
+        Lifetime life;
+        life.pid       = static_cast<pid_t>(in.getI64());
+        life.fd        = static_cast<long>(in.getI64());
+        life.open      = getOpen(in);
+        life.closeUsec = in.getI64();
+        mLongest.push(std::move(life));
+    }
+    for(uint64_t lives = in.getU64(); in.ok() && lives > 0; --lives) {
+        Lifetime life;
+        life.pid       = static_cast<pid_t>(in.getI64());
+        life.fd        = static_cast<long>(in.getI64());
+        life.open      = getOpen(in);
+        life.closeUsec = in.getI64();
+        life.leaked    = true;
+        mResult.leaks.push_back(std::move(life));
+    }
+
+    mRaces.get(in);
+    mLatency.get(in);
+    getTallies(in, mResult);
+
+    std::map<pid_t, FdTimeline::Range> counts;
+    for(uint64_t pids = in.getU64(); in.ok() && pids > 0; --pids) {
+        FdTimeline::Range & range = counts[static_cast<pid_t>(in.getI64())];
+        range.base = in.getI64();
+        range.counts.resize(std::min<uint64_t>(in.getU64(), 1ull << 24));
+        for(auto & bucket : range.counts) {
+            bucket.opens     = in.getI64();
+            bucket.closes    = in.getI64();
+            bucket.untracked = in.getI64();
+        }
+    }
+    mTimeline.restore(counts);
+
+    if(!in.ok() || !in.atEnd() || offset > mFileBytes) {
+        std::cerr<<mCheckpointPath<<" is damaged, start over"<<std::endl;
+        release();
+        mAppliedLine = mReadLine = 0;
+        return false;
+    }
+    return true;
+}
+
+void
+DescriptorMatch::putOpen(
+    CheckpointWriter &  out,
+    const OpenRecord &  record
+) {
+    out.putI64(record.tid);
+    out.putU8(static_cast<uint8_t>(record.call));
+    out.putI64(record.usec);
+    out.putU64(record.offset);
+    out.putString(record.detail);
+}
+
+DescriptorMatch::OpenRecord
+DescriptorMatch::getOpen(
+    CheckpointReader &  in
+) {
+    OpenRecord record;
+    record.tid    = static_cast<pid_t>(in.getI64());
+    record.call   = static_cast<SYSCALL>(in.getU8());
+    record.usec   = in.getI64();
+    record.offset = in.getU64();
+    record.detail = in.getString();
+    return record;
+}
+
+void
+DescriptorMatch::putTallies(
+    CheckpointWriter &  out,
+    const MatchResult & result
+) {
+    for(size_t count : result.calls) {
+        out.putU64(count);
+    }
+    out.putU64(result.balance.size());
+    for(const auto & element : result.balance) {
+        out.putI64(element.first);
+        out.putU64(element.second.opens);
+        out.putU64(element.second.closes);
+    }
+    out.putU64(result.ebadf.size());
+    for(const auto & element : result.ebadf) {
+        out.putU8(static_cast<uint8_t>(element.first.first));
+        out.putI64(element.first.second);
+        out.putU64(element.second);
+    }
+}
+
+bool
+DescriptorMatch::getTallies(
+    CheckpointReader &  in,
+    MatchResult &       result
+) {
+    for(size_t & count : result.calls) {
+        count = in.getU64();
+    }
+    result.balance.clear();
+    for(uint64_t fds = in.getU64(); in.ok() && fds > 0; --fds) {
+        FdBalance & balance = result.balance[static_cast<long>(in.getI64())];
+        balance.opens  = in.getU64();
+        balance.closes = in.getU64();
+    }
+    result.ebadf.clear();
+    for(uint64_t keys = in.getU64(); in.ok() && keys > 0; --keys) {
+        SYSCALL call = static_cast<SYSCALL>(in.getU8());
+        long    fd   = static_cast<long>(in.getI64());
+        result.ebadf[BadFdKey(call, fd)] = in.getU64();
+    }
+    return in.ok();
+}
@@ -0,0 +1,240 @@
+#ifndef _DESCRIPTORMATCH_H_
+#define _DESCRIPTORMATCH_H_
+
+#include <map>
+#include <array>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <queue>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "Analyzer.h"
+#include "FdEvent.h"
+#include "FdTables.h"
+#include "FdTimeline.h"
+#include "LatencyStats.h"
+#include "MemoryStats.h"
+#include "RaceDetector.h"
+#include "HandlerThread.h"
+#include "ThreadPool.h"
+#include "TraceReader.h"
+#include "util.h"
+
+class CheckpointWriter;
+class CheckpointReader;
+class TraceIndex;
+
+// Open/close matching (fd leak) analysis.
+//
+// The trace is read once: chunks of lines are parsed on the ThreadPool and
+// applied in trace order on a HandlerThread. Only live fds, one pending
+// unfinished call per task and the top LONGESTLEN lifetimes are kept, so
+// memory follows the number of live fds and not the size of the trace.
+//
+// Live fds are kept in FdTables: clone/fork/vfork lines give the child the
+// parent's table (CLONE_FILES) or a copy-on-write copy of it, so a close in
+// one thread matches an open in another, and an fd a child inherited is
+// the parent's lifetime, not the child's leak. Leaks and lifetimes carry
+// the task their table was made for. An exit notice takes the task out of
+// its table; the fds a table still holds when its last task exits are
+// leaks then. With a pid set, its descendants are analyzed too.
+class DescriptorMatch : public Analyzer {
+public:
+    struct OpenRecord {
+        pid_t       tid     = -1;
+        SYSCALL     call    = SYSCALL::UNKNOWN;
+        long long   usec    = -1;
+        uint64_t    offset  = 0;
+        std::string detail;
+    };
+
+    struct Lifetime {
+        pid_t       pid     = -1;
+        long        fd      = -1;
+        OpenRecord  open;
+        long long   closeUsec = -1;     // leaked: exit of the last task of the table, or end of trace
+        bool        leaked  = false;
+
+        long long   duration() const {
+            return (open.usec < 0 || closeUsec < 0) ? 0 : closeUsec - open.usec;
+        }
+    };
+
+    struct LeakBucket {
+        long long   usec        = 0;    // bucket start
+        size_t      opened      = 0;    // leaked fds opened in this bucket
+        size_t      cumulative  = 0;    // leaked fds opened up to the bucket end
+    };
+
+    struct FdBalance {
+        size_t      opens       = 0;
+        size_t      closes      = 0;    // of fds opened in the trace
+    };
+
+    using CallCounts = std::array<size_t, static_cast<size_t>(SYSCALL::COUNT)>;
+    using BadFdKey   = std::pair<SYSCALL, long>;
+
+    struct MatchResult {
+        std::vector<Lifetime>   leaks;      // still open at EOF, by open time
+        std::vector<LeakBucket> timeline;
+        std::vector<Lifetime>   longest;    // longest lived first
+        long long   firstUsec       = -1;
+        long long   lastUsec        = -1;
+        size_t      opens           = 0;
+        size_t      closes          = 0;
+        size_t      unknownCloses   = 0;    // fds opened before the trace started
+        size_t      badFds          = 0;
+        size_t      pending         = 0;    // unfinished calls never resumed
+        std::map<pid_t, FdTimeline::Series> usage;  // open-fd count and rates per table, by its owner
+        std::vector<RaceDetector::Race> races;      // first RACELEN, in trace order
+        RaceDetector::Counts    raceCounts{};       // every finding, by RACE
+        LatencyStats            latency;            // strace -T durations, empty without
+        CallCounts              calls{};            // complete fd calls by syscall
+        std::map<long, FdBalance>       balance;    // by fd number
+        std::map<BadFdKey, size_t>      ebadf;      // EBADF calls by syscall and fd
+    };
+
+public:
+    DescriptorMatch();
+    DescriptorMatch(const DescriptorMatch &) = delete;
+    DescriptorMatch& operator=(const DescriptorMatch &) = delete;
+
+public:
+    static DescriptorMatch* getInstance();
+    void    initResources(pid_t, const std::string, unsigned) override;
+    void    process() override;
+    double  progress() override;
+    void    cancel() override;
+
+    // Width of the leak timeline buckets; 0 spreads the trace over LEAKBUCKETS.
+    void    setLeakBucket(long long usec);
+    // Width of the open-fd count buckets, 1s by default.
+    void    setTimelineBucket(long long usec);
+    MatchResult getResult();
+
+    // Saves the match state to `path` every `everyBytes` of trace, and makes
+    // process() resume from it when it belongs to the same trace file
+    // (path, size and mtime) and settings. Removed once a run completes;
+    // empty turns checkpoints off. strace -ff input is not checkpointed.
+    // An exporter only receives the records after the resume point.
+    void    setCheckpoint(const std::string & path, uint64_t everyBytes = CHECKPOINTBYTES);
+    // Files every fd event of the next process() into `index` for later
+    // queries (from the resume point on a resumed run); the index must
+    // outlive the run, nullptr stops it.
+    void    setIndex(TraceIndex * index) {
+        mpIndex = index;
+    }
+
+    // Live input in place of process(), e.g. from PtraceTracer: beginLive(),
+    // then feedLive() with every call in completion order from one thread,
+    // then endLive() makes the result. Nothing is checkpointed or indexed.
+    void    beginLive();
+    void    feedLive(FdCall && call);
+    void    endLive();
+
+    // Snapshot coding of one open record, shared with DaemonProtocol.
+    static void         putOpen(CheckpointWriter & out, const OpenRecord & record);
+    static OpenRecord   getOpen(CheckpointReader & in);
+    // Same for the calls, balance and ebadf tallies of a result.
+    static void         putTallies(CheckpointWriter & out, const MatchResult & result);
+    static bool         getTallies(CheckpointReader & in, MatchResult & result);
+
+    // Trace offset the last process() resumed from, 0 for a fresh run.
+    uint64_t    resumedFrom() const {
+        return mResumedFrom;
+    }
+
+private:
+    // Lines back to back, '\n' between them: in place in a stable reader's
+    // blocks, copied into `text` otherwise.
+    struct Chunk {
+        std::string         text;
+        std::string_view    lines;
+        uint64_t            offset = 0;     // of the first line
+        size_t              count = 0;
+        uint64_t            bytes = 0;
+        MemoryCharge        memory = MemoryCharge(MemoryStats::getInstance()->account("DescriptorMatch.chunks"));
+    };
+
+    static std::vector<FdCall>  parseChunk(std::shared_ptr<Chunk> chunk, const CancelToken * cancel);
+
+    using LiveTables = FdTables<OpenRecord>;
+
+    static MemoryAccount &  callAccount();
+
+    void    submit(std::shared_ptr<Chunk> chunk, TraceReader & reader, HandlerThread & handler);
+    void    apply(const FdEvent & event);
+    void    update(const FdEvent & event);
+    void    completed(const FdCall & call);
+    void    undefer();
+    void    retire(LiveTables::Id table, long fd, const LiveTables::Slot & slot, long long usec);
+    void    leave(const FdEvent & event);
+    void    countClose(pid_t owner, LiveTables::Id table, const LiveTables::Slot & slot, long long usec);
+    void    leak(LiveTables::Id table, long long usec);
+    void    finish();
+    void    release();
+    bool    selected(pid_t pid) const;
+
+    void    drain();
+    bool    traceIdentity(uint64_t & size, long long & mtime) const;
+    bool    saveCheckpoint(uint64_t offset);
+    bool    loadCheckpoint(uint64_t & offset);
+
+private:
+    static constexpr uint64_t   CHECKPOINTBYTES = 64ull << 20;
+    static const size_t CHUNKLINES  = 4096;
+    static const size_t LONGESTLEN  = 16;
+    static const size_t LEAKBUCKETS = 100;
+    static const size_t DEFERLEN    = 1 << 16;  // events held for children of unfinished clones
+
+    using LongestQueue = std::priority_queue<Lifetime, std::vector<Lifetime>,
+                            bool (*)(const Lifetime &, const Lifetime &)>;
+
+    pid_t           mProcessId;
+    std::string     mFilePath;
+    long long       mBucketUsec;
+    long long       mTimelineUsec;
+
+    // touched only by the ordered apply thread
+    LiveTables      mTables;
+    std::unordered_set<pid_t>   mFamily;    // descendants of mProcessId
+    // events of tasks not known yet while a clone is unfinished: a child
+    // runs before strace prints its parent's clone() = tid
+    std::unordered_map<pid_t, std::vector<FdEvent>> mDeferred;
+    size_t          mDeferredCount;
+    MemoryCharge    mDeferredCharge;    // DescriptorMatch.deferred, set per chunk
+    FdEventBuilder  mBuilder;
+    RaceDetector    mRaces;
+    LatencyStats    mLatency;
+    LongestQueue    mLongest;
+    MatchResult     mResult;
+    FdTimeline      mTimeline;
+
+    TraceIndex      *mpIndex;
+
+    std::atomic<long>       mReadLine;
+    std::atomic<long>       mAppliedLine;
+    std::atomic<uint64_t>   mAppliedBytes;
+    uint64_t                mFileBytes;
+
+    std::string             mCheckpointPath;
+    uint64_t                mCheckpointBytes;
+    uint64_t                mCheckpointAt;      // offset of the last checkpoint
+    uint64_t                mResumedFrom;
+
+    std::mutex              mFlightLock;
+    std::condition_variable mFlightCond;
+    size_t                  mInFlight;
+    size_t                  mMaxInFlight;
+
+    unsigned int            mThreadCnt;
+    ThreadPool              *mpThreadPool;
+};
+
+#endif
@@ -0,0 +1,430 @@
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <algorithm>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "Exporter.h"
+
+static const char *
+eventName(FDEVENT kind) {
+    switch(kind) {
+    case FDEVENT::OPEN:
+        return "open";
+    case FDEVENT::CLOSE:
+        return "close";
+    case FDEVENT::CLOSERANGE:
+        return "close_range";
+    case FDEVENT::BADFD:
+        return "ebadf";
+    case FDEVENT::SPAWN:
+        return "spawn";
+    case FDEVENT::EXIT:
+        return "exit";
+    }
+    return "";
+}
+
+static const char *
+statusName(FDSTATUS status) {
+    switch(status) {
+    case FDSTATUS::OPENING:
+        return "opening";
+    case FDSTATUS::DUMPING:
+        return "dumping";
+    case FDSTATUS::CLOSING:
+        return "closing";
+    case FDSTATUS::CLOSED:
+        return "closed";
+    case FDSTATUS::NORMAL:
+        return "normal";
+    case FDSTATUS::BADFD:
+        return "ebadf";
+    default:
+        return "";
+    }
+}
+
+static const char *
+recordName(uint8_t record) {
+    static const char * names[] = {"", "event", "closed", "leaked", "ebadf"};
+    return record < sizeof(names) / sizeof(names[0]) ? names[record] : "";
+}
+
+/******************* public function ********************************/
+Exporter::Exporter(
+    const std::string & path,
+    EXPORTFORMAT        format
+) : mFd(-1)
+  , mFormat(format)
+  , mBuffer(new char[BUFFERSIZE])
+  , mLength(0)
+  , mWritten(0)
+  , mFailed(false) {
+    mFd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if(mFd < 0) {
+        std::cerr<<path<<" can not be created!"<<std::endl;
+        return ;
+    }
+    header();
+    DEG_LOG("export to %s, format %d", path.c_str(), static_cast<int>(mFormat));
+}
+
+Exporter::~Exporter() {
+    flush();
+    if(mFd >= 0) {
+        ::close(mFd);
+    }
+}
+
+EXPORTFORMAT
+Exporter::formatOf(
+    const std::string & path
+) {
+    auto endsWith = [&](const char * suffix) {
+        size_t length = std::strlen(suffix);
+        return path.size() >= length && path.compare(path.size() - length, length, suffix) == 0;
+    };
+    if(endsWith(".csv")) {
+        return EXPORTFORMAT::CSV;
+    }
+    if(endsWith(".bin")) {
+        return EXPORTFORMAT::BINARY;
+    }
+    return EXPORTFORMAT::JSONL;
+}
+
+void
+Exporter::write(
+    const FdEvent & event
+) {
+    Record record;
+    record.record   = RECORD::EVENT;
+    record.kind     = static_cast<uint8_t>(event.kind);
+    record.kindName = eventName(event.kind);
+    record.call     = event.call;
+    record.joined   = event.joined;
+    record.pid      = event.pid;
+    record.fd       = event.fd;
+    record.last     = event.last;
+    record.usec     = event.usec;
+    record.endUsec  = -1;
+    record.offset   = event.offset;
+    record.detail   = event.detail;
+    if(event.kind == FDEVENT::SPAWN) {
+        record.last   = event.child;
+        record.detail = event.shared ? "CLONE_FILES" : "";
+    }
+    put(record);
+}
+
+void
+Exporter::write(
+    const DescriptorMatch::Lifetime &   life
+) {
+    Record record;
+    record.record   = life.leaked ? RECORD::LEAKED : RECORD::CLOSED;
+    record.kind     = static_cast<uint8_t>(FDEVENT::OPEN);
+    record.kindName = life.leaked ? "leaked" : "closed";
+    record.call     = life.open.call;
+    record.joined   = false;
+    record.pid      = life.pid;
+    record.fd       = life.fd;
+    record.last     = -1;
+    record.usec     = life.open.usec;
+    record.endUsec  = life.closeUsec;
+    record.offset   = life.open.offset;
+    record.detail   = life.open.detail;
+    put(record);
+}
+
+void
+Exporter::write(
+    const ResultRow &   row
+) {
+    Record record;
+    record.record   = RECORD::BADFILE;
+    record.kind     = static_cast<uint8_t>(-static_cast<int>(row.status));
+    record.kindName = statusName(row.status);
+    record.call     = SYSCALL::UNKNOWN;
+    record.joined   = false;
+    record.pid      = row.pid;
+    record.fd       = row.fd;
+    record.last     = -1;
+    record.usec     = row.usec;
+    record.endUsec  = row.incident;
+    record.offset   = 0;
+    put(record);
+}
+
+bool
+Exporter::flush() {
+    size_t done = 0;
+    while(mFd >= 0 && done < mLength) {
+        ssize_t bytes = ::write(mFd, mBuffer.get() + done, mLength - done);
+        if(bytes < 0) {
+            if(errno == EINTR) {
+                continue;
+            }
+            if(!mFailed) {
+                std::cerr<<"export write failed: "<<std::strerror(errno)<<std::endl;
+            }
+            mFailed = true;
+            break;
+        }
+        done += static_cast<size_t>(bytes);
+    }
+    mWritten += done;
+    mLength = 0;
+    return !mFailed;
+}
+
+/******************* private function ********************************/
+void
+Exporter::header() {
+    switch(mFormat) {
+    case EXPORTFORMAT::CSV:
+        append("record,pid,fd,last,usec,end_usec,call,kind,offset,detail\n");
+        break;
+    case EXPORTFORMAT::BINARY:
+        append(std::string_view("FDTRACE\0", 8));
+        appendLE(VERSION, 4);
+        appendLE(RECORDSIZE, 4);
+        break;
+    default:
+        break;
+    }
+}
+
+void
+Exporter::put(
+    const Record &  record
+) {
+    if(mFd < 0) {
+        return ;
+    }
+    switch(mFormat) {
+    case EXPORTFORMAT::CSV:
+        putCsv(record);
+        break;
+    case EXPORTFORMAT::BINARY:
+        putBinary(record);
+        break;
+    default:
+        putJson(record);
+        break;
+    }
+}
+
+void
+Exporter::putJson(
+    const Record &  record
+) {
+    append("{\"record\":\"");
+    append(recordName(static_cast<uint8_t>(record.record)));
+    append("\",\"pid\":");
+    appendInt(record.pid);
+    append(",\"fd\":");
+    appendInt(record.fd);
+    if(record.last >= 0) {
+        append(",\"last\":");
+        appendInt(record.last);
+    }
+    append(",\"usec\":");
+    appendInt(record.usec);
+    if(record.endUsec >= 0) {
+        append(",\"end_usec\":");
+        appendInt(record.endUsec);
+    }
+    if(record.call != SYSCALL::UNKNOWN) {
+        append(",\"call\":\"");
+        append(SyscallTable::name(record.call));
+        append('"');
+    }
+    append(",\"kind\":\"");
+    append(record.kindName);
+    append('"');
+    if(record.record != RECORD::BADFILE) {
+        append(",\"offset\":");
+        appendInt(static_cast<long long>(record.offset));
+    }
+    if(record.joined) {
+        append(",\"joined\":true");
+    }
+    if(!record.detail.empty()) {
+        append(",\"detail\":");
+        appendJsonString(record.detail);
+    }
+    append("}\n");
+}
+
+void
+Exporter::putCsv(
+    const Record &  record
+) {
+    append(recordName(static_cast<uint8_t>(record.record)));
+    append(',');
+    appendInt(record.pid);
+    append(',');
+    appendInt(record.fd);
+    append(',');
+    if(record.last >= 0) {
+        appendInt(record.last);
+    }
+    append(',');
+    appendInt(record.usec);
+    append(',');
+    if(record.endUsec >= 0) {
+        appendInt(record.endUsec);
+    }
+    append(',');
+    if(record.call != SYSCALL::UNKNOWN) {
+        append(SyscallTable::name(record.call));
+    }
+    append(',');
+    append(record.kindName);
+    append(',');
+    if(record.record != RECORD::BADFILE) {
+        appendInt(static_cast<long long>(record.offset));
+    }
+    append(',');
+    appendCsvField(record.detail);
+    append('\n');
+}
+
+void
+Exporter::putBinary(
+    const Record &  record
+) {
+    reserve(RECORDSIZE);
+    appendLE(static_cast<uint8_t>(record.record), 1);
+    appendLE(record.kind, 1);
+    appendLE(static_cast<uint8_t>(record.call), 1);
+    appendLE(record.joined ? 1 : 0, 1);
+    appendLE(static_cast<uint32_t>(static_cast<int32_t>(record.pid)), 4);
+    appendLE(static_cast<uint32_t>(static_cast<int32_t>(record.fd)), 4);
+    appendLE(static_cast<uint32_t>(static_cast<int32_t>(record.last)), 4);
+    appendLE(static_cast<uint64_t>(record.usec), 8);
+    appendLE(static_cast<uint64_t>(record.endUsec), 8);
+    appendLE(record.offset, 8);
+}
+
+void
+Exporter::reserve(
+    size_t  bytes
+) {
+    if(mLength + bytes > BUFFERSIZE) {
+        flush();
+    }
+}
+
+void
+Exporter::append(
+    std::string_view    text
+) {
+    if(mLength + text.size() > BUFFERSIZE) {
+        flush();
+        if(text.size() > BUFFERSIZE) {
+            // longer than the whole buffer: goes out in pieces
+            while(!text.empty()) {
+                size_t piece = std::min(text.size(), BUFFERSIZE);
+                std::memcpy(mBuffer.get(), text.data(), piece);
+                mLength = piece;
+                flush();
+                text.remove_prefix(piece);
+            }
+            return ;
+        }
+    }
+    std::memcpy(mBuffer.get() + mLength, text.data(), text.size());
+    mLength += text.size();
+}
+
+void
+Exporter::append(
+    char    ch
+) {
+    if(mLength == BUFFERSIZE) {
+        flush();
+    }
+    mBuffer[mLength++] = ch;
+}
+
+void
+Exporter::appendInt(
+    long long   value
+) {
+    char digits[24];
+    size_t pos = sizeof(digits);
+    unsigned long long magnitude = value < 0 ? 0ull - static_cast<unsigned long long>(value)
+                                             : static_cast<unsigned long long>(value);
+    do {
+        digits[--pos] = static_cast<char>('0' + magnitude % 10);
+        magnitude /= 10;
+    } while(magnitude);
+    if(value < 0) {
+        digits[--pos] = '-';
+    }
+    append(std::string_view(digits + pos, sizeof(digits) - pos));
+}
+
+void
+Exporter::appendJsonString(
+    std::string_view    text
+) {
+    // strace already escapes non-printable bytes, only quotes and
+    // backslashes need care; control bytes get \u escapes to be safe
+    append('"');
+    size_t begin = 0;
+    for(size_t pos = 0; pos < text.size(); ++pos) {
+        unsigned char ch = static_cast<unsigned char>(text[pos]);
+        if(ch != '"' && ch != '\\' && ch >= 0x20) {
+            continue;
+        }
+        append(text.substr(begin, pos - begin));
+        if(ch == '"' || ch == '\\') {
+            append('\\');
+            append(static_cast<char>(ch));
+        } else {
+            static const char hex[] = "0123456789abcdef";
+            append("\\u00");
+            append(hex[ch >> 4]);
+            append(hex[ch & 0xf]);
+        }
+        begin = pos + 1;
+    }
+    append(text.substr(begin));
+    append('"');
+}
+
+void
+Exporter::appendCsvField(
+    std::string_view    text
+) {
+    if(text.find_first_of(",\"\n\r") == std::string_view::npos) {
+        append(text);
+        return ;
+    }
+    append('"');
+    size_t begin = 0;
+    for(size_t pos = text.find('"'); pos != std::string_view::npos; pos = text.find('"', begin)) {
+        append(text.substr(begin, pos + 1 - begin));
+        append('"');
+        begin = pos + 1;
+    }
+    append(text.substr(begin));
+    append('"');
+}
+
+void
+Exporter::appendLE(
+    uint64_t    value,
+    size_t      bytes
+) {
+    reserve(bytes);
+    for(size_t indx = 0; indx < bytes; ++indx) {
+        mBuffer[mLength++] = static_cast<char>((value >> (8 * indx)) & 0xff);
+    }
+}
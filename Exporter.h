@@ -0,0 +1,120 @@
+#ifndef _EXPORTER_H_
+#define _EXPORTER_H_
+
+#include <string>
+#include <string_view>
+#include <memory>
+
+#include "FdEvent.h"
+#include "DescriptorMatch.h"
+#include "ResultStore.h"
+
+enum class EXPORTFORMAT {
+    JSONL,
+    CSV,
+    BINARY
+};
+
+// Streams analysis output to a file while the engines run.
+//
+// Records of every kind share one layout, so a single file can carry fd
+// events, fd lifetimes and EBADF history together:
+//
+//   record  event | closed | leaked | ebadf
+//   pid, fd, last       last is the upper bound of a close_range event and
+//                       the new task of a spawn event
+//   usec, end_usec      end_usec is the close time of a lifetime and the
+//                       EBADF an ebadf history row leads up to
+//   call, kind          syscall name; event kind or EBADF history status
+//   offset              byte offset of the line in the trace
+//   detail              path of open calls, CLONE_FILES for a spawn that
+//                       shares the fd table (not in BINARY)
+//
+// BINARY is a 16 byte header ("FDTRACE\0", u32 version, u32 record size)
+// followed by RECORDSIZE byte little-endian records:
+//
+//   0  u8  record (1 event, 2 closed, 3 leaked, 4 ebadf)
+//   1  u8  kind   (FDEVENT, or -FDSTATUS for ebadf)
+//   2  u8  call   (SYSCALL)
+//   3  u8  flags  (1: joined from an unfinished/resumed pair)
+//   4  i32 pid    8  i32 fd    12 i32 last
+//   16 i64 usec   24 i64 end_usec   32 u64 offset
+//
+// Output goes through a fixed buffer and write(2); memory does not grow
+// with the output. Not thread safe: each engine writes from one thread.
+class Exporter {
+public:
+    static constexpr uint32_t   VERSION     = 1;
+    static constexpr uint32_t   RECORDSIZE  = 40;
+
+public:
+    Exporter(const std::string & path, EXPORTFORMAT format);
+    ~Exporter();
+    Exporter(const Exporter &) = delete;
+    Exporter& operator=(const Exporter &) = delete;
+
+    // Format from the extension: .csv, .bin, anything else JSON Lines.
+    static EXPORTFORMAT formatOf(const std::string & path);
+
+    bool    isOpen() const {
+        return mFd >= 0;
+    }
+    uint64_t    written() const {
+        return mWritten + mLength;
+    }
+
+    void    write(const FdEvent & event);
+    void    write(const DescriptorMatch::Lifetime & life);
+    void    write(const ResultRow & row);
+    // Flushes the buffer; returns false if any write failed.
+    bool    flush();
+
+private:
+    enum class RECORD : uint8_t {
+        EVENT   = 1,
+        CLOSED  = 2,
+        LEAKED  = 3,
+        BADFILE = 4
+    };
+
+    struct Record {
+        RECORD      record;
+        uint8_t     kind;
+        const char  *kindName;
+        SYSCALL     call;
+        bool        joined;
+        long long   pid;
+        long long   fd;
+        long long   last;
+        long long   usec;
+        long long   endUsec;
+        uint64_t    offset;
+        std::string_view    detail;
+    };
+
+    void    put(const Record & record);
+    void    putJson(const Record & record);
+    void    putCsv(const Record & record);
+    void    putBinary(const Record & record);
+    void    header();
+
+    void    reserve(size_t bytes);
+    void    append(std::string_view text);
+    void    append(char ch);
+    void    appendInt(long long value);
+    void    appendJsonString(std::string_view text);
+    void    appendCsvField(std::string_view text);
+    void    appendLE(uint64_t value, size_t bytes);
+
+private:
+    static constexpr size_t BUFFERSIZE  = 1 << 20;
+
+    int             mFd;
+    EXPORTFORMAT    mFormat;
+    std::unique_ptr<char[]> mBuffer;
+    size_t          mLength;
+    uint64_t        mWritten;
+    bool            mFailed;
+};
+
+#endif
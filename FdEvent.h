@@ -0,0 +1,300 @@
+#ifndef _FDEVENT_H_
+#define _FDEVENT_H_
+
+#include <cstdint>
+#include <climits>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+#include <sys/types.h>
+
+#include "SyscallLine.h"
+
+enum class FDEVENT : uint8_t {
+    OPEN        = 0,    // fd became valid (open, socket, dup target, pipe end, ...)
+    CLOSE       = 1,    // fd released
+    CLOSERANGE  = 2,    // every fd in [fd, last] released
+    BADFD       = 3,    // syscall on fd failed with EBADF
+    SPAWN       = 4,    // clone/fork/vfork made task `child`
+    EXIT        = 5     // the task is gone
+};
+
+// One change of a task's fd table, in trace order.
+struct FdEvent {
+    pid_t       pid     = -1;       // task that issued the syscall
+    long long   usec    = -1;       // completion time, microseconds; -1 when untimed
+    SYSCALL     call    = SYSCALL::UNKNOWN;
+    FDEVENT     kind    = FDEVENT::OPEN;
+    long        fd      = -1;
+    long        last    = -1;       // upper bound of CLOSERANGE
+    uint64_t    offset  = 0;        // byte offset of the completing line, in the merged
+                                    // stream for strace -ff input
+    bool        joined  = false;    // built from an unfinished/resumed pair
+    pid_t       child   = -1;       // SPAWN: the new task
+    bool        shared  = false;    // SPAWN: CLONE_FILES, the child uses the same fd table
+    std::string detail;             // path of open/openat/creat, empty otherwise
+};
+
+// An fd-relevant syscall line reduced to the values events are built from.
+// Unfinished and resumed halves are joined later, in trace order, by FdEventBuilder.
+struct FdCall {
+    pid_t       pid     = -1;
+    long long   usec    = -1;
+    SYSCALL     call    = SYSCALL::UNKNOWN;
+    PHASE       phase   = PHASE::WHOLE;
+    long        arg0    = -1;
+    long        arg1    = -1;
+    long        pair0   = -1;
+    long        pair1   = -1;
+    bool        dupCmd  = false;    // fcntl(F_DUPFD*)
+    bool        shareFiles = false; // clone/clone3 with CLONE_FILES
+    long        ret     = 0;
+    bool        hasRet  = false;
+    bool        ebadf   = false;
+    bool        joined  = false;
+    uint64_t    offset  = 0;
+    long long   duration = -1;      // time in the call (strace -T), microseconds; -1 unknown
+    std::string detail;
+
+    // Returns false for lines that do not touch the fd table.
+    static bool
+    fromLine(std::string_view line, uint64_t offset, FdCall & out) {
+        SyscallLine sc;
+        if(SyscallLine::extract(line) == SYSCALL::UNKNOWN) {
+            if(!sc.parseExit(line)) {
+                return false;
+            }
+            out = FdCall();
+            out.pid    = sc.pid;
+            out.usec   = SyscallLine::toMicros(sc.time);
+            out.call   = sc.call;
+            out.offset = offset;
+            return true;
+        }
+        if(!sc.parse(line)) {
+            return false;
+        }
+        out = FdCall();
+        out.pid     = sc.pid;
+        out.usec    = SyscallLine::toMicros(sc.time);
+        out.call    = sc.call;
+        out.phase   = sc.phase;
+        out.offset  = offset;
+        out.ret     = sc.ret;
+        out.hasRet  = sc.hasRet;
+        out.ebadf   = sc.error == "EBADF";
+        out.duration = sc.duration;
+
+        switch(sc.call) {
+        case SYSCALL::OPEN:
+        case SYSCALL::CREAT:
+            out.detail = unquote(sc.arg(0));
+            break;
+        case SYSCALL::OPENAT:
+        case SYSCALL::OPENAT2:
+            out.detail = unquote(sc.arg(1));
+            break;
+        case SYSCALL::PIPE:
+        case SYSCALL::PIPE2:
+            sc.fdPair(0, out.pair0, out.pair1);
+            break;
+        case SYSCALL::SOCKETPAIR:
+            sc.fdPair(3, out.pair0, out.pair1);
+            break;
+        case SYSCALL::FCNTL:
+            out.dupCmd = sc.arg(1).substr(0, 7) == "F_DUPFD";
+            out.arg0   = sc.intArg(0);
+            break;
+        case SYSCALL::CLOSE_RANGE:
+            out.arg0 = sc.intArg(0);
+            out.arg1 = sc.intArg(1, LONG_MAX);
+            break;
+        case SYSCALL::CLONE:
+        case SYSCALL::CLONE3:
+            // flags=CLONE_VM|CLONE_FS|CLONE_FILES|... in the entering half
+            out.shareFiles = sc.args.find("CLONE_FILES") != std::string_view::npos;
+            break;
+        case SYSCALL::FORK:
+        case SYSCALL::VFORK:
+            break;
+        default:
+            out.arg0 = sc.intArg(0);
+            out.arg1 = sc.intArg(1);
+            break;
+        }
+        return true;
+    }
+
+private:
+    static std::string
+    unquote(std::string_view text) {
+        if(text.size() >= 2 && text.front() == '"') {
+            size_t end = text.rfind('"');
+            return std::string(text.substr(1, end > 0 ? end - 1 : 0));
+        }
+        return std::string(text);
+    }
+};
+
+// Joins unfinished/resumed halves per task and turns complete calls into
+// FdEvents. Must be fed in trace order; holds one pending call per task.
+class FdEventBuilder {
+public:
+    template<typename Sink>
+    void    feed(FdCall && call, Sink && sink) {
+        feed(std::move(call), sink, [](const FdCall &){});
+    }
+
+    // `done` also sees every complete call, after its events: whole, or
+    // joined from its halves with the resumed half's duration.
+    template<typename Sink, typename Done>
+    void    feed(FdCall && call, Sink && sink, Done && done) {
+        if(call.phase == PHASE::UNFINISH) {
+            FdCall & pending = mPending[call.pid];
+            mSpawning -= SyscallTable::spawns(pending.call);
+            mSpawning += SyscallTable::spawns(call.call);
+            pending = std::move(call);
+            return ;
+        }
+        if(call.phase == PHASE::RESUME) {
+            auto it = mPending.find(call.pid);
+            if(it == mPending.end()) {
+                // the first half is before the start of the trace
+                emit(call, sink);
+                done(call);
+                return ;
+            }
+            FdCall whole = std::move(it->second);
+            mPending.erase(it);
+            mSpawning -= SyscallTable::spawns(whole.call);
+            whole.phase  = PHASE::WHOLE;
+            whole.joined = true;
+            whole.usec   = call.usec;
+            whole.offset = call.offset;
+            whole.ret    = call.ret;
+            whole.hasRet = call.hasRet;
+            whole.ebadf  = call.ebadf;
+            whole.duration = call.duration;
+            if(call.pair0 >= 0) {
+                whole.pair0 = call.pair0;
+                whole.pair1 = call.pair1;
+            }
+            emit(whole, sink);
+            done(whole);
+            return ;
+        }
+        emit(call, sink);
+        done(call);
+    }
+
+    size_t  pending() const {
+        return mPending.size();
+    }
+
+    // Unfinished clone/fork/vfork calls: their children may already be
+    // running, with events in the trace before the parent learns the tid.
+    size_t  spawning() const {
+        return mSpawning;
+    }
+
+    const std::unordered_map<pid_t, FdCall> &   pendingCalls() const {
+        return mPending;
+    }
+
+    // Puts back an unfinished call, when resuming from a checkpoint.
+    void    restore(FdCall && call) {
+        FdCall & pending = mPending[call.pid];
+        mSpawning -= SyscallTable::spawns(pending.call);
+        mSpawning += SyscallTable::spawns(call.call);
+        pending = std::move(call);
+    }
+
+    void    clear() {
+        mPending.clear();
+        mSpawning = 0;
+    }
+
+private:
+    template<typename Sink>
+    static void emit(const FdCall & call, Sink && sink) {
+        FdEvent event;
+        event.pid    = call.pid;
+        event.usec   = call.usec;
+        event.call   = call.call;
+        event.offset = call.offset;
+        event.joined = call.joined;
+
+        auto push = [&](FDEVENT kind, long fd) {
+            if(fd < 0) {
+                return ;
+            }
+            event.kind = kind;
+            event.fd   = fd;
+            sink(event);
+        };
+
+        if(call.ebadf) {
+            push(FDEVENT::BADFD, call.arg0);
+            return ;
+        }
+
+        switch(call.call) {
+        case SYSCALL::CLOSE:
+            // Linux releases the fd even when close() reports EINTR/EIO
+            if(call.phase != PHASE::RESUME && call.hasRet) {
+                push(FDEVENT::CLOSE, call.arg0);
+            }
+            break;
+        case SYSCALL::CLOSE_RANGE:
+            if(call.phase != PHASE::RESUME && call.hasRet && call.ret == 0 && call.arg0 >= 0) {
+                event.last = call.arg1;
+                push(FDEVENT::CLOSERANGE, call.arg0);
+            }
+            break;
+        case SYSCALL::PIPE:
+        case SYSCALL::PIPE2:
+        case SYSCALL::SOCKETPAIR:
+            if(call.hasRet && call.ret == 0) {
+                push(FDEVENT::OPEN, call.pair0);
+                push(FDEVENT::OPEN, call.pair1);
+            }
+            break;
+        case SYSCALL::FCNTL:
+            if(call.dupCmd && call.hasRet && call.ret >= 0) {
+                push(FDEVENT::OPEN, call.ret);
+            }
+            break;
+        case SYSCALL::CLONE:
+        case SYSCALL::CLONE3:
+        case SYSCALL::FORK:
+        case SYSCALL::VFORK:
+            // the child's side returns 0 and is not traced as a call
+            if(call.phase != PHASE::UNFINISH && call.hasRet && call.ret > 0) {
+                event.kind   = FDEVENT::SPAWN;
+                event.child  = static_cast<pid_t>(call.ret);
+                event.shared = call.shareFiles;
+                sink(event);
+            }
+            break;
+        case SYSCALL::EXITED:
+            event.kind = FDEVENT::EXIT;
+            sink(event);
+            break;
+        default:
+            // open*, creat, socket, accept*, dup*, eventfd*, epoll_create*, ...
+            // dup2/dup3 onto a live fd replace it, which OPEN of a live fd implies
+            if(call.hasRet && call.ret >= 0) {
+                event.detail = call.detail;
+                push(FDEVENT::OPEN, call.ret);
+            }
+            break;
+        }
+    }
+
+private:
+    std::unordered_map<pid_t, FdCall>   mPending;
+    size_t                              mSpawning = 0;
+};
+
+#endif
@@ -0,0 +1,185 @@
+#include <chrono>
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+
+#include <fcntl.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "FdSampler.h"
+#include "threadlog.h"
+
+/******************* public function ********************************/
+FdSampler::FdSampler(
+) : mIntervalUsec(100000)
+  , mSamples(0)
+  , mSequence(0)
+  , mStop(false) {
+}
+
+void
+FdSampler::addPid(
+    pid_t   pid
+) {
+    mTargets[pid];
+}
+
+void
+FdSampler::setInterval(
+    long long   usec
+) {
+    mIntervalUsec = usec > 0 ? usec : 100000;
+}
+
+bool
+FdSampler::sample(
+    const Sink &    sink
+) {
+    bool alive = false;
+    for(auto & element : mTargets) {
+        pid_t    pid    = element.first;
+        Target & target = element.second;
+        if(!target.alive) {
+            continue;
+        }
+        long long usec = SyscallLine::nowMicros();
+        auto emit = [&](SYSCALL call, int fd, std::string && detail) {
+            FdCall out;
+            out.pid    = pid;
+            out.usec   = usec;
+            out.call   = call;
+            out.hasRet = true;
+            out.offset = mSequence++;
+            if(call == SYSCALL::CLOSE) {
+                out.arg0 = fd;
+                out.ret  = 0;
+            } else {
+                out.ret    = fd;
+                out.detail = std::move(detail);
+            }
+            sink(std::move(out));
+        };
+
+        std::string directory = "/proc/" + std::to_string(pid) + "/fd";
+        int dirfd = ::open(directory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        DIR *dir  = dirfd >= 0 ? fdopendir(dirfd) : nullptr;
+        if(!dir) {
+            if(dirfd >= 0) {
+                ::close(dirfd);
+            }
+            // exit closed everything it still had
+            for(const auto & fd : target.fds) {
+                emit(SYSCALL::CLOSE, fd.first, std::string());
+            }
+            target.fds.clear();
+            target.alive = false;
+            DEG_LOG("sampled pid %d is gone", pid);
+            continue;
+        }
+        alive = true;
+
+        std::map<int, OpenFd> now;
+        while(struct dirent *entry = readdir(dir)) {
+            if(entry->d_name[0] < '0' || entry->d_name[0] > '9') {
+                continue;
+            }
+            struct stat info;
+            // follows the magic link: the open file's device and inode
+            if(fstatat(dirfd, entry->d_name, &info, 0) != 0) {
+                continue;           // closed since the listing
+            }
+            OpenFd & open = now[std::atoi(entry->d_name)];
+            open.dev = info.st_dev;
+            open.ino = info.st_ino;
+        }
+
+        auto before = target.fds.begin();
+        for(const auto & element : now) {
+            int fd = element.first;
+            while(before != target.fds.end() && before->first < fd) {
+                emit(SYSCALL::CLOSE, before->first, std::string());
+                ++before;
+            }
+            bool same = before != target.fds.end() && before->first == fd
+                        && before->second.dev == element.second.dev && before->second.ino == element.second.ino;
+            if(before != target.fds.end() && before->first == fd) {
+                if(!same) {
+                    emit(SYSCALL::CLOSE, fd, std::string());
+                }
+                ++before;
+            }
+            if(same) {
+                continue;
+            }
+            char    link[PATH_MAX];
+            ssize_t length = readlinkat(dirfd, std::to_string(fd).c_str(), link, sizeof(link));
+            std::string path = length > 0 ? std::string(link, static_cast<size_t>(length)) : std::string();
+            SYSCALL call = callOf(path);
+            emit(call, fd, std::move(path));
+        }
+        for(; before != target.fds.end(); ++before) {
+            emit(SYSCALL::CLOSE, before->first, std::string());
+        }
+        target.fds.swap(now);
+        closedir(dir);
+    }
+    ++mSamples;
+    return alive;
+}
+
+void
+FdSampler::run(
+    const Sink &    sink,
+    double          seconds
+) {
+    using Clock = std::chrono::steady_clock;
+    auto begin = Clock::now();
+    auto next  = begin;
+    std::unique_lock<std::mutex> lock(mStopLock);
+    while(!mStop) {
+        lock.unlock();
+        bool alive = sample(sink);
+        lock.lock();
+        if(!alive || (seconds > 0 && std::chrono::duration<double>(Clock::now() - begin).count() >= seconds)) {
+            break;
+        }
+        // a fixed grid: a slow listing does not push the later ones back
+        next += std::chrono::microseconds(mIntervalUsec);
+        mStopCond.wait_until(lock, next, [&](){return mStop;});
+    }
+    DEG_LOG("fd sampler end: %llu samples", static_cast<unsigned long long>(mSamples));
+}
+
+void
+FdSampler::stop() {
+    std::lock_guard<std::mutex> lock(mStopLock);
+    mStop = true;
+    mStopCond.notify_all();
+}
+
+/******************* private function ********************************/
+SYSCALL
+FdSampler::callOf(
+    const std::string & link
+) {
+    static const struct {
+        const char *    prefix;
+        SYSCALL         call;
+    } KINDS[] = {
+        {"socket:",                 SYSCALL::SOCKET},
+        {"anon_inode:[eventfd]",    SYSCALL::EVENTFD2},
+        {"anon_inode:[eventpoll]",  SYSCALL::EPOLL_CREATE1},
+        {"anon_inode:[timerfd]",    SYSCALL::TIMERFD_CREATE},
+        {"anon_inode:[signalfd]",   SYSCALL::SIGNALFD4},
+        {"anon_inode:inotify",      SYSCALL::INOTIFY_INIT1},
+        {"/memfd:",                 SYSCALL::MEMFD_CREATE},
+    };
+    for(const auto & kind : KINDS) {
+        if(link.compare(0, std::strlen(kind.prefix), kind.prefix) == 0) {
+            return kind.call;
+        }
+    }
+    return SYSCALL::OPENAT;
+}
@@ -0,0 +1,82 @@
+#ifndef _FDSAMPLER_H_
+#define _FDSAMPLER_H_
+
+#include <map>
+#include <mutex>
+#include <atomic>
+#include <string>
+#include <vector>
+#include <functional>
+#include <condition_variable>
+
+#include <sys/types.h>
+
+#include "FdEvent.h"
+
+// Live fd usage without tracing: /proc/<pid>/fd is listed every interval
+// and each listing is diffed against the previous one into synthetic
+// FdCalls for DescriptorMatch::feedLive(). The target is never stopped;
+// it only shares its fd table lock with the /proc reads.
+//
+//   fd number new                     open, detail = link target
+//   fd number gone                    close
+//   same number, other dev/inode      close, then open
+//   process gone                      close of every fd it had
+//
+// The open's call is guessed from the link target (socket:, anon_inode:
+// [eventfd], /memfd:, ...), OPENAT for files. The fds found by the first
+// listing are opens at that time. Anything opened and closed between two
+// listings is not seen, and a close and reopen of the same file on the
+// same fd number reads as no change.
+class FdSampler {
+public:
+    using Sink = std::function<void(FdCall &&)>;
+
+public:
+    FdSampler();
+    FdSampler(const FdSampler &) = delete;
+    FdSampler& operator=(const FdSampler &) = delete;
+
+    void    addPid(pid_t pid);
+    // Time between listings, 100ms by default.
+    void    setInterval(long long usec);
+
+    // Lists every pid once and sends the differences to `sink`; false once
+    // no pid is left.
+    bool    sample(const Sink & sink);
+    // Samples until every pid has exited, `seconds` passed (0: no limit)
+    // or stop() is called.
+    void    run(const Sink & sink, double seconds = 0);
+    // Ends run(), also one that has not started yet. Callable from any
+    // thread; not from a signal handler.
+    void    stop();
+
+    uint64_t    samples() const {
+        return mSamples;
+    }
+
+private:
+    struct OpenFd {
+        dev_t       dev = 0;
+        ino_t       ino = 0;
+    };
+
+    struct Target {
+        std::map<int, OpenFd>   fds;
+        bool        alive = true;
+    };
+
+    static SYSCALL  callOf(const std::string & link);
+
+private:
+    std::map<pid_t, Target>     mTargets;
+    long long       mIntervalUsec;
+    uint64_t        mSamples;
+    uint64_t        mSequence;          // FdCall::offset, in emission order
+
+    std::mutex      mStopLock;
+    std::condition_variable mStopCond;
+    bool            mStop;
+};
+
+#endif
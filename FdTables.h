@@ -0,0 +1,281 @@
+#ifndef _FDTABLES_H_
+#define _FDTABLES_H_
+
+#include <array>
+#include <algorithm>
+#include <memory>
+#include <vector>
+#include <cstdint>
+#include <unordered_map>
+
+#include <sys/types.h>
+
+#include "MemoryStats.h"
+
+// The fd tables of a traced process tree, kept the way the kernel keeps
+// them: tasks cloned with CLONE_FILES (threads) use one table, fork, vfork
+// and clone without it give the child a copy. A copy shares the parent's
+// pages of PAGESIZE slots until one side writes to a page, so each child of
+// a forking server costs a vector of page pointers, not a table.
+//
+// Every slot remembers the table its fd was opened in: fds a child only
+// inherited stay the parent's. A task first seen without a spawn gets a
+// table of its own. An exited task leaves its table; a table without tasks
+// drops its pages and its id is reused, so memory follows the live tasks,
+// not every task ever forked. Not thread safe. Pages are charged to
+// `account` when one is given.
+template<typename Value>
+class FdTables {
+public:
+    using Id = uint32_t;
+    static constexpr Id     NONE    = ~0u;
+    static constexpr long   MAXFD   = 1l << 30;     // the kernel's nr_open ceiling; fds are below
+
+    struct Slot {
+        uint64_t    origin  = 0;    // serial() of the table the fd was opened in
+        Value       value;
+    };
+
+public:
+    FdTables(): mSerial(0), mpAccount(nullptr) {}
+    explicit FdTables(MemoryAccount & account): mSerial(0), mpAccount(&account) {}
+
+    // Table of task `tid`, NONE before its first use.
+    Id      find(pid_t tid) const {
+        auto it = mTasks.find(tid);
+        return it == mTasks.end() ? NONE : it->second;
+    }
+
+    // Table of task `tid`; a new empty one for a task not seen before.
+    Id      of(pid_t tid) {
+        Id id = find(tid);
+        if(id == NONE) {
+            id = create(tid);
+            assign(tid, id);
+        }
+        return id;
+    }
+
+    // `parent` made task `child`. With `shared` both use the parent's
+    // table, otherwise the child gets a copy-on-write copy of it. What a
+    // child already seen opened on its own is moved over.
+    void    spawn(pid_t parent, pid_t child, bool shared) {
+        if(child <= 0 || child == parent) {
+            return ;
+        }
+        Id from = of(parent);
+        Id to   = from;
+        if(!shared) {
+            to = create(child);
+            mTables[to].pages = mTables[from].pages;
+            mTables[to].size  = mTables[from].size;
+        }
+        Id old = find(child);
+        if(old == to) {
+            return ;
+        }
+        assign(child, to);
+        if(old == NONE || --mTables[old].tasks > 0) {
+            return ;
+        }
+        visit(old, 0, MAXFD, [&](long fd, const Slot & slot) {
+            Slot & moved = put(to, fd);
+            moved.origin = openedIn(old, slot) ? serial(to) : slot.origin;
+            moved.value  = slot.value;
+        });
+        free(old);
+    }
+
+    // Task `tid` exited: it leaves its table, which is freed with its last
+    // task. Returns the table left, NONE for a task never seen.
+    Id      exit(pid_t tid) {
+        auto it = mTasks.find(tid);
+        if(it == mTasks.end()) {
+            return NONE;
+        }
+        Id id = it->second;
+        mTasks.erase(it);
+        if(--mTables[id].tasks == 0) {
+            free(id);
+        }
+        return id;
+    }
+
+    const Slot *    get(Id id, long fd) const {
+        const Table & table = mTables[id];
+        size_t index = static_cast<size_t>(fd) / PAGESIZE;
+        if(fd < 0 || index >= table.pages.size() || !table.pages[index]) {
+            return nullptr;
+        }
+        const Page & page = *table.pages[index];
+        size_t bit = static_cast<size_t>(fd) % PAGESIZE;
+        return (page.used >> bit) & 1 ? &page.slots[bit] : nullptr;
+    }
+
+    // Slot of `fd` in [0, MAXFD), made when it is not in the table; copies
+    // its page first when another table still shares it.
+    Slot &  put(Id id, long fd) {
+        Page & page = writable(id, fd);
+        size_t bit  = static_cast<size_t>(fd) % PAGESIZE;
+        if(!((page.used >> bit) & 1)) {
+            page.used |= 1ull << bit;
+            ++mTables[id].size;
+        }
+        return page.slots[bit];
+    }
+
+    void    erase(Id id, long fd) {
+        if(!get(id, fd)) {
+            return ;
+        }
+        Page & page = writable(id, fd);
+        size_t bit  = static_cast<size_t>(fd) % PAGESIZE;
+        page.used &= ~(1ull << bit);
+        page.slots[bit] = Slot();
+        --mTables[id].size;
+    }
+
+    // Calls visit(fd, slot) for every fd in [first, last], in fd order.
+    template<typename Visit>
+    void    visit(Id id, long first, long last, Visit && each) const {
+        const Table & table = mTables[id];
+        first = first < 0 ? 0 : first;
+        for(size_t index = static_cast<size_t>(first) / PAGESIZE; index < table.pages.size(); ++index) {
+            if(!table.pages[index]) {
+                continue;
+            }
+            const Page & page = *table.pages[index];
+            for(uint64_t used = page.used; used; used &= used - 1) {
+                long fd = static_cast<long>(index * PAGESIZE) + __builtin_ctzll(used);
+                if(fd > last) {
+                    return ;
+                }
+                if(fd >= first) {
+                    each(fd, page.slots[__builtin_ctzll(used)]);
+                }
+            }
+        }
+    }
+
+    // Ids are [0, count()); freed ones have no users.
+    size_t  count() const {
+        return mTables.size();
+    }
+    // Never reused, unlike ids: a slot inherited from a freed table does
+    // not look opened in the table that gets its id next.
+    uint64_t    serial(Id id) const {
+        return mTables[id].serial;
+    }
+    bool    openedIn(Id id, const Slot & slot) const {
+        return slot.origin == mTables[id].serial;
+    }
+    // Task the table was made for.
+    pid_t   owner(Id id) const {
+        return mTables[id].owner;
+    }
+    // Tasks using the table; 0 once its last task moved to another one.
+    size_t  users(Id id) const {
+        return mTables[id].tasks;
+    }
+    size_t  size(Id id) const {
+        return mTables[id].size;
+    }
+    const std::unordered_map<pid_t, Id> &   tasks() const {
+        return mTasks;
+    }
+
+    // An empty table with no task, a freed id when there is one. With a
+    // `serial`, assign() and reclaim() it rebuilds a snapshot.
+    Id      create(pid_t owner, uint64_t serial = 0) {
+        Id id;
+        if(!mFree.empty()) {
+            id = mFree.back();
+            mFree.pop_back();
+            mTables[id] = Table();
+        } else {
+            id = static_cast<Id>(mTables.size());
+            mTables.emplace_back();
+        }
+        mSerial = std::max(mSerial, serial);
+        mTables[id].owner  = owner;
+        mTables[id].serial = serial > 0 ? serial : ++mSerial;
+        return id;
+    }
+
+    void    assign(pid_t tid, Id id) {
+        mTasks[tid] = id;
+        ++mTables[id].tasks;
+    }
+
+    // Frees the tables no task was assigned to.
+    void    reclaim() {
+        for(Id id = 0; id < mTables.size(); ++id) {
+            if(mTables[id].tasks == 0 && std::find(mFree.begin(), mFree.end(), id) == mFree.end()) {
+                free(id);
+            }
+        }
+    }
+
+    void    clear() {
+        std::vector<Table>().swap(mTables);
+        std::unordered_map<pid_t, Id>().swap(mTasks);
+        std::vector<Id>().swap(mFree);
+        mSerial = 0;
+    }
+
+private:
+    static constexpr size_t PAGESIZE    = 64;       // one bit each in Page::used
+
+    struct Page {
+        uint64_t                    used = 0;
+        std::array<Slot, PAGESIZE>  slots;
+    };
+
+    struct Table {
+        pid_t       owner   = -1;
+        uint64_t    serial  = 0;
+        size_t      tasks   = 0;
+        size_t      size    = 0;
+        std::vector<std::shared_ptr<Page>>  pages;
+    };
+
+    // Pages a copy still shares stay with the copy.
+    void    free(Id id) {
+        std::vector<std::shared_ptr<Page>>().swap(mTables[id].pages);
+        mTables[id].size  = 0;
+        mTables[id].tasks = 0;
+        mFree.push_back(id);
+    }
+
+    Page &  writable(Id id, long fd) {
+        Table & table = mTables[id];
+        size_t index = static_cast<size_t>(fd) / PAGESIZE;
+        if(index >= table.pages.size()) {
+            table.pages.resize(index + 1);
+        }
+        std::shared_ptr<Page> & page = table.pages[index];
+        if(!page) {
+            page = makePage();
+        } else if(page.use_count() > 1) {
+            page = makePage(*page);
+        }
+        return *page;
+    }
+
+    template<typename... Args>
+    std::shared_ptr<Page>   makePage(Args &&... args) {
+        if(mpAccount) {
+            return std::allocate_shared<Page>(CountingAllocator<Page>(*mpAccount), std::forward<Args>(args)...);
+        }
+        return std::make_shared<Page>(std::forward<Args>(args)...);
+    }
+
+private:
+    std::vector<Table>              mTables;
+    std::unordered_map<pid_t, Id>   mTasks;
+    std::vector<Id>                 mFree;
+    uint64_t                        mSerial;    // last serial handed out
+    MemoryAccount                   *mpAccount;
+};
+
+#endif
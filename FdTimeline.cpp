@@ -0,0 +1,71 @@
+#include <algorithm>
+
+#include "FdTimeline.h"
+
+FdTimeline::FdTimeline(
+    long long   bucketUsec
+) : mBucketUsec(bucketUsec > 0 ? bucketUsec : 1000000)
+  , mLastPid(-1)
+  , mpLast(nullptr) {
+}
+
+void
+FdTimeline::reset(
+    long long   bucketUsec
+) {
+    mBucketUsec = bucketUsec > 0 ? bucketUsec : 1000000;
+    mLastPid    = -1;
+    mpLast      = nullptr;
+    std::unordered_map<pid_t, Range>().swap(mPids);
+}
+
+std::map<pid_t, FdTimeline::Range>
+FdTimeline::counts() const {
+    std::map<pid_t, Range> result;
+    for(const auto & element : mPids) {
+        if(!element.second.counts.empty()) {
+            result.emplace(element.first, element.second);
+        }
+    }
+    return result;
+}
+
+std::map<pid_t, FdTimeline::Series>
+FdTimeline::series() const {
+    std::map<pid_t, Series> result;
+    double seconds = mBucketUsec / 1e6;
+    for(const auto & element : counts()) {
+        const Range & range = element.second;
+        Series & series = result[element.first];
+        series.resize(range.counts.size());
+        long long openFds = 0;
+        for(size_t indx = 0; indx < range.counts.size(); ++indx) {
+            const Counts & counts = range.counts[indx];
+            openFds += counts.opens - (counts.closes - counts.untracked);
+            Point & point    = series[indx];
+            point.usec       = (range.base + static_cast<long long>(indx)) * mBucketUsec;
+            point.openFds    = openFds;
+            point.opens      = counts.opens;
+            point.closes     = counts.closes;
+            point.openRate   = counts.opens / seconds;
+            point.closeRate  = counts.closes / seconds;
+        }
+    }
+    return result;
+}
+
+void
+FdTimeline::restore(
+    const std::map<pid_t, Range> &  counts
+) {
+    for(const auto & element : counts) {
+        Range & range = mPids[element.first];
+        for(size_t indx = 0; indx < element.second.counts.size(); ++indx) {
+            const Counts & from = element.second.counts[indx];
+            Counts & to = at(range, element.second.base + static_cast<long long>(indx));
+            to.opens     += from.opens;
+            to.closes    += from.closes;
+            to.untracked += from.untracked;
+        }
+    }
+}
@@ -0,0 +1,98 @@
+#ifndef _FDTIMELINE_H_
+#define _FDTIMELINE_H_
+
+#include <map>
+#include <vector>
+#include <cstdint>
+#include <unordered_map>
+
+#include <sys/types.h>
+
+// Per-pid open-fd count, open rate and close rate in fixed time buckets.
+// DescriptorMatch counts each fd table under the task it was made for, on
+// its ordered apply thread, since only the table knows that task.
+//
+// One thread counts, so counting an event is a few adds and no lock; the
+// buckets are turned into plot-ready series once, in series(). Not thread
+// safe: read it only while nothing counts. Per-worker shards merged at the
+// end were dropped on purpose: a parse worker can not tell which table,
+// and so which owner, a line counts for.
+class FdTimeline {
+public:
+    struct Counts {
+        int64_t     opens       = 0;
+        int64_t     closes      = 0;
+        int64_t     untracked   = 0;    // closes of fds opened before the trace, or inherited
+    };
+
+    struct Point {
+        long long   usec        = 0;    // bucket start
+        long long   openFds     = 0;    // fds opened in the trace and still open at bucket end
+        int64_t     opens       = 0;
+        int64_t     closes      = 0;
+        double      openRate    = 0;    // per second
+        double      closeRate   = 0;    // per second
+    };
+
+    using Series = std::vector<Point>;
+
+    // Raw bucket counts of one pid, buckets [base, base + counts.size()).
+    struct Range {
+        long long           base = 0;
+        std::vector<Counts> counts;
+    };
+
+public:
+    explicit FdTimeline(long long bucketUsec = 1000000);
+    FdTimeline(const FdTimeline &) = delete;
+    FdTimeline& operator=(const FdTimeline &) = delete;
+
+    // Drops every count.
+    void    reset(long long bucketUsec);
+    long long   bucket() const {
+        return mBucketUsec;
+    }
+
+    void    add(pid_t pid, long long usec, int64_t opens, int64_t closes, int64_t untracked = 0) {
+        if(usec < 0) {
+            return ;
+        }
+        if(!mpLast || pid != mLastPid) {
+            mpLast   = &mPids[pid];
+            mLastPid = pid;
+        }
+        Counts & counts = at(*mpLast, usec / mBucketUsec);
+        counts.opens     += opens;
+        counts.closes    += closes;
+        counts.untracked += untracked;
+    }
+
+    std::map<pid_t, Series> series() const;
+    std::map<pid_t, Range>  counts() const;
+
+    // Adds `counts` to the buckets, to carry a timeline over a checkpoint.
+    void    restore(const std::map<pid_t, Range> & counts);
+
+private:
+    Counts &    at(Range & range, long long index) {
+        if(range.counts.empty()) {
+            range.base = index;
+        } else if(index < range.base) {
+            range.counts.insert(range.counts.begin(), range.base - index, Counts());
+            range.base = index;
+        }
+        size_t pos = static_cast<size_t>(index - range.base);
+        if(pos >= range.counts.size()) {
+            range.counts.resize(pos + 1);
+        }
+        return range.counts[pos];
+    }
+
+private:
+    long long   mBucketUsec;
+    pid_t       mLastPid;
+    Range       *mpLast;            // counts of mLastPid; map nodes do not move
+    std::unordered_map<pid_t, Range>    mPids;
+};
+
+#endif
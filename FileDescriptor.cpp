@@ -1,9 +1,11 @@
 #include <regex>
 #include <fstream>
+#include <algorithm>
 
 #include <iostream>
 
 #include "FileDescriptor.h"
+#include "Exporter.h"
 #include "ThreadPool.h"
 #include "HandlerThread.h"
 
@@ -22,6 +24,8 @@ std::regex FilePattern::Close_Resume("^([0-9]*) *([^<]*) .*close resumed>.*= *(-
 std::regex FilePattern::Close_Unfinish("^([0-9]*) *(.*) .*close\\(([0-9]*) <.*\\)*");
 std::regex FilePattern::Close_BadFile("^([0-9]*) *(.*) .*close\\(([0-9]*)\\) .*= (-*[0-9]*) .*Bad file descriptor.*");
 
+const FileDescriptor::Dispatch FileDescriptor::sDispatch = FileDescriptor::buildDispatch();
+
 /******************* public function ********************************/
 FileDescriptor*
 FileDescriptor::getInstance() {
@@ -38,13 +42,25 @@ FileDescriptor::initResources(
     setProcessId(pid);
     setFilePath(file);
     setProcessThread(threads);
+    mCancel.reset();
 
     mProcessLine = 0;
     mMaxProcessLine = 0;
+    mWakeLine = -1;
+    mScanBytes = 0;
+    mFileBytes = 0;
+    mTriageFound = 0;
+    mTriageHit = false;
 
     mCloseGraph.clear();
     mOpenGraph.clear();
     mBadFileMap.clear();
+    mBadTimeMap.clear();
+    mHistoryBytes = 0;
+    mHistoryCharge.set(0);
+    mIncidentCharge.set(0);
+    mSpillable = true;
+    mSpill.clear();
     mMapGraph.clear();
     for(fd_t fd = 0; fd < 1024; ++fd) {
         mMapGraph[fd] = Status(-1, "", FDSTATUS::CLOSED);
@@ -57,42 +73,87 @@ FileDescriptor::process() {
     mpThreadPool = ThreadPool::getInstance(mThreadCnt);
     mpThreadPool->adjust(mThreadCnt);
     detectEBADF();
+    if(cancelled()) {
+        mProcessLine = 0;
+        release();
+        DEG_LOG("Detect Bad File Descriptor cancelled");
+        return ;
+    }
 
     std::cout<<"Detect Bad File Descriptor end xxx"<<std::endl;
     DEG_LOG("Detect Bad File Descriptor End...");
 
     
-    std::ifstream in(mFilePath, std::ios::in);
-    if(!in.is_open()) {
+    auto in = TraceReader::open(mFilePath, mpThreadPool);
+    if(!in) {
         std::cerr<<mFilePath<<" do not exist!"<<std::endl;
         return ;
     } else {
         std::string line;
-        while(std::getline(in, line)) {
-            if(line.find("openat") != std::string::npos) {
-                mpThreadPool->enqueue(processOpen,  line, this);
-            } else if(line.find("close") != std::string::npos) {
-                mpThreadPool->enqueue(processClose, line, this);
-            } else if(line.find("dup") != std::string::npos) {
-                mpThreadPool->enqueue(processDump, line, this);
-            } else {
-                mpThreadPool->enqueue(irrelevantProcess, line, this);
+        long        enqueued = 0;
+        while(in->next(line)) {
+            if(cancelled()) {
+                break;
+            }
+            if(mTriageHit && enqueued >= mMaxProcessLine) {
+                // nothing after the last incident wanted is history of it
+                break;
             }
+            SYSCALL call = SyscallLine::extract(line);
+            mpThreadPool->enqueueFor(this, sDispatch[static_cast<size_t>(call)], line, this);
+            if(++enqueued % QUEUEDLINES == 0) {
+                // queued lines are most of the memory: let the pool drain half
+                std::unique_lock<std::mutex> lock(mSuccessLock);
+                mWakeLine = mMaxProcessLine - enqueued + QUEUEDLINES / 2;
+                mSuccessCond.wait(lock, [&](){return mProcessLine <= mWakeLine || cancelled();});
+                mWakeLine = -1;
+            }
+        }
+
+        {
+            std::unique_lock<std::mutex> lock(mSuccessLock);
+            mSuccessCond.wait(lock, [&](){return !mProcessLine || cancelled();});
+        }
+
+        if(cancelled()) {
+            // lines never read and tasks never run will not count down; only
+            // our line tasks count, not the reader's batches on the same pool
+            long dropped = static_cast<long>(mpThreadPool->purge(this));
+            {
+                std::unique_lock<std::mutex> lock(mSuccessLock);
+                mProcessLine -= (mMaxProcessLine - enqueued) + dropped;
+                mSuccessCond.wait(lock, [&](){return mProcessLine <= 0;});
+                mProcessLine = 0;
+            }
+            release();
+            DEG_LOG("Bad File Descriptor cancelled after %ld lines", enqueued);
         }
     }
     
 }
 
-long 
-FileDescriptor::processedLine() {
-    if(mMaxProcessLine == 0) {
-        return mProcessLine;
-    } else {
-        return mMaxProcessLine - mProcessLine + mMaxProcessLine;
+void
+FileDescriptor::cancel() {
+    Analyzer::cancel();
+    std::lock_guard<std::mutex> lock(mSuccessLock);
+    mSuccessCond.notify_all();
+}
+
+double
+FileDescriptor::progress() {
+    if(mFileBytes == 0) {
+        return 0;
     }
+    long maxLine = mMaxProcessLine;
+    if(maxLine == 0) {
+        // first pass: bytes applied by the EBADF scan
+        return std::min(1.0, 1.0 * mScanBytes / mFileBytes) / 2;
+    }
+    // second pass: the first one counted the lines, so lines left are exact
+    return 0.5 + 0.5 * (maxLine - std::max(0L, mProcessLine.load())) / maxLine;
 }
 
-FileDescriptor::ResultData
+ResultHandle
 FileDescriptor::getResult() {
     {
         //wait for threadpool to finish all jobs
@@ -100,42 +161,122 @@ FileDescriptor::getResult() {
         mSuccessCond.wait(lock, [&](){return !mProcessLine;});
     }
 
-    ResultData data;
-    for(auto it = mBadFileMap.begin(); it != mBadFileMap.end(); ++it) {
-        std::priority_queue<Status, std::vector<Status>, std::greater<Status>> rank;
-        while(!it->second.empty()) {
-            auto node = it->second.front();
-            it->second.pop();
-            if(std::get<1>(node.get()) > mFileTimeMap[it->first]) {
-                continue;
-            }
-            if(rank.size() == PRINTLEN) {
-                rank.push(node);
-                rank.pop();
-            } else {
-                rank.push(node);
-            }
+    // every EBADF of an fd with the newest PRINTLEN events before it: the
+    // fd's history is sorted once and each incident is a binary search
+    auto earlier = [](const HistoryRecord & lhs, const HistoryRecord & rhs) {
+        return std::tie(lhs.usec, lhs.pid, lhs.status) < std::tie(rhs.usec, rhs.pid, rhs.status);
+    };
+    std::vector<fd_t> fds;
+    fds.reserve(mBadFileMap.size());
+    size_t incidents = 0;
+    for(auto & element : mBadTimeMap) {
+        fds.push_back(element.first);
+        // the scan applies lines in trace order; -f traces are only mostly sorted
+        std::sort(element.second.begin(), element.second.end());
+        incidents += element.second.size();
+    }
+    std::sort(fds.begin(), fds.end());
+
+    auto store = std::make_shared<ResultStore>();
+    store->badFds    = mBadFileMap.size();
+    store->incidents = incidents;
+    store->partial   = mTriageHit;
+    store->rows.reserve(incidents * (PRINTLEN + 1));
+    std::vector<HistoryRecord> history;
+    for(fd_t fd : fds) {
+        history.clear();
+        std::queue<Status> & queue = mBadFileMap[fd];
+        while(!queue.empty()) {
+            auto node = queue.front().get();
+            queue.pop();
+            HistoryRecord record;
+            record.usec   = SyscallLine::toMicros(std::get<1>(node));
+            record.pid    = static_cast<int32_t>(std::get<0>(node));
+            record.fd     = fd;
+            record.status = static_cast<int16_t>(std::get<2>(node));
+            history.push_back(record);
         }
+        mSpill.forEach(fd, [&](const HistoryRecord & record){ history.push_back(record); });
+        std::sort(history.begin(), history.end(), earlier);
 
-        std::vector<Status> status;
-        while(!rank.empty()) {
-            auto node = rank.top();
-            rank.pop();
-            status.push_back(node);
+        auto push = [&](const ResultRow & row) {
+            store->rows.push_back(row);
+            if(mpExporter) {
+                mpExporter->write(row);
+            }
+        };
+        for(long long bound : mBadTimeMap[fd]) {
+            // strictly before the EBADF, which is itself a close of the fd;
+            // untimed lines come before everything
+            auto end = std::partition_point(history.begin(), history.end(), [&](const HistoryRecord & record) {
+                return bound >= 0 ? record.usec < bound : record.usec <= bound;
+            });
+            auto begin = end - std::min<std::ptrdiff_t>(end - history.begin(), PRINTLEN);
+            ResultRow row;
+            row.fd       = fd;
+            row.incident = bound;
+            for(auto it = begin; it != end; ++it) {
+                row.usec   = it->usec;
+                row.pid    = static_cast<pid_t>(it->pid);
+                row.status = static_cast<FDSTATUS>(it->status);
+                push(row);
+            }
+            row.usec   = bound;
+            row.pid    = mProcessId;
+            row.status = FDSTATUS::BADFD;
+            push(row);
         }
-        data.insert({it->first, status});
     }
-    return data;
+    if(mSpill.runs()) {
+        DEG_LOG("merged %zu spilled runs, %llu bytes", mSpill.runs(),
+                static_cast<unsigned long long>(mSpill.bytes()));
+        mSpill.clear();
+    }
+    // the history queues were emptied into the rows
+    mHistoryBytes = 0;
+    mHistoryCharge.set(0);
+    store->account();
+    if(mpExporter) {
+        mpExporter->flush();
+    }
+    return store;
 }
 
 
+void
+FileDescriptor::setMemoryBudget(
+    size_t  bytes
+) {
+    mMemoryBudget = bytes;
+    DEG_LOG("set history memory budget: %zu", mMemoryBudget);
+}
+
+void
+FileDescriptor::setTriage(
+    size_t  incidents
+) {
+    mTriage = incidents;
+    DEG_LOG("set triage: first %zu incidents", mTriage);
+}
+
 /******************* private function ********************************/
 FileDescriptor::FileDescriptor(
 ) : mProcessId(-1)
-  , mThreadCnt(1)
-  , mpThreadPool(nullptr)
+  , mMemoryBudget(MEMORYBUDGET)
+  , mHistoryBytes(0)
+  , mSpillable(true)
+  , mHistoryCharge(MemoryStats::getInstance()->account("FileDescriptor.history"))
+  , mIncidentCharge(MemoryStats::getInstance()->account("FileDescriptor.incidents"))
+  , mTriage(0)
+  , mTriageFound(0)
+  , mTriageHit(false)
   , mProcessLine(0)
-  , mMaxProcessLine(0) {
+  , mMaxProcessLine(0)
+  , mWakeLine(-1)
+  , mScanBytes(0)
+  , mFileBytes(0)
+  , mThreadCnt(1)
+  , mpThreadPool(nullptr) {
     mCloseGraph.clear();
     mOpenGraph.clear();
     mBadFileMap.clear();
@@ -144,6 +285,46 @@ FileDescriptor::FileDescriptor(
     }
 }
 
+void
+FileDescriptor::release() {
+    // swap, not clear: clear() keeps the bucket arrays allocated
+    std::unordered_map<pid_t,std::queue<fd_t>>().swap(mCloseGraph);
+    std::unordered_map<pid_t,std::queue<fd_t>>().swap(mOpenGraph);
+    std::unordered_map<fd_t, std::queue<Status>>().swap(mBadFileMap);
+    std::unordered_map<fd_t, std::vector<long long>>().swap(mBadTimeMap);
+    mHistoryBytes = 0;
+    mHistoryCharge.set(0);
+    mIncidentCharge.set(0);
+    mSpill.clear();
+}
+
+void
+FileDescriptor::spillHistory() {
+    // called with mProcessLock held, every queue moves into one run
+    std::vector<HistoryRecord> records;
+    records.reserve(mHistoryBytes / sizeof(Status));
+    for(auto & element : mBadFileMap) {
+        std::queue<Status> & queue = element.second;
+        while(!queue.empty()) {
+            auto node = queue.front().get();
+            queue.pop();
+            HistoryRecord record;
+            record.usec   = SyscallLine::toMicros(std::get<1>(node));
+            record.pid    = static_cast<int32_t>(std::get<0>(node));
+            record.fd     = element.first;
+            record.status = static_cast<int16_t>(std::get<2>(node));
+            records.push_back(record);
+        }
+        std::queue<Status>().swap(queue);
+    }
+    mHistoryBytes = 0;
+    mHistoryCharge.set(0);
+    if(!mSpill.spill(records)) {
+        // no disk to spill to: keep going in memory rather than fail the run
+        mSpillable = false;
+    }
+}
+
 void
 FileDescriptor::setProcessId(
     pid_t   pid
@@ -195,12 +376,13 @@ FileDescriptor::regexProcess(
 void
 FileDescriptor::detectEBADF() {
 
-    std::ifstream in(mFilePath, std::ios::in);
+    auto in = TraceReader::open(mFilePath, mpThreadPool);
 
-    if(!in.is_open()) {
+    if(!in) {
         std::cerr<<mFilePath<<" does not exist!"<<std::endl;
         return ;
     } else {
+        mFileBytes = in->size();
         std::string line;
         //int num = 0;
 
@@ -212,24 +394,67 @@ FileDescriptor::detectEBADF() {
         HandlerThread handler;
         
 
-        while(std::getline(in, line)) {
-            
+        uint64_t consumed = 0;
+        long     enqueued = 0;
+        while(in->next(line)) {
+            if(cancelled()) {
+                mpThreadPool->purge(this);
+                break;
+            }
+            if(mTriageHit) {
+                // lines parsed past the last incident wanted are dropped,
+                // other runs on the pool keep theirs
+                mpThreadPool->purge(this);
+                DEG_LOG("triage: %zu incidents in %ld lines", mTriage, mProcessLine.load());
+                break;
+            }
 
-            auto res = mpThreadPool->enqueue(doProcess, line, mProcessId);
+            auto     res   = mpThreadPool->enqueueFor(this, doProcess, line, mProcessId);
+            uint64_t bytes = in->consumed() - consumed;
+            consumed = in->consumed();
 
-            handler.enqueue([&,res](){
-                auto result = res.get();
+            handler.enqueue([&,res,bytes](){
+                if(cancelled() || mTriageHit) {
+                    return ;
+                }
+                std::vector<std::pair<int,std::string>> result;
+                try {
+                    result = res.get();
+                } catch(const std::future_error &) {
+                    // purged by a cancel that raced with this line
+                    return ;
+                }
+                // lines are applied in trace order, so the first incidents
+                // found are the first ones of the trace
                 for(auto & element : result) {
                     mBadFileMap.insert({element.first, std::queue<Status>()});
-                    mFileTimeMap.insert(element);
+                    mBadTimeMap[element.first].push_back(SyscallLine::toMicros(element.second));
+                    mIncidentCharge.set(mIncidentCharge.bytes() + sizeof(long long));
+                    if(mTriage && ++mTriageFound >= mTriage) {
+                        mTriageHit = true;
+                        break;
+                    }
+                }
+                long applied = ++mProcessLine;
+                mScanBytes += bytes;
+                if(mTriageHit || applied % (QUEUEDLINES / 2) == 0) {
+                    std::lock_guard<std::mutex> lock(mSuccessLock);
+                    mSuccessCond.notify_all();
                 }
-                ++mProcessLine;
             });
+            if(++enqueued % QUEUEDLINES == 0) {
+                // read at most QUEUEDLINES ahead of the lines applied: every
+                // queued line holds a pool task and a handler closure
+                std::unique_lock<std::mutex> lock(mSuccessLock);
+                mSuccessCond.wait(lock, [&](){
+                    return mProcessLine >= enqueued - QUEUEDLINES / 2 || mTriageHit || cancelled();
+                });
+            }
         }
     }
 
-    mMaxProcessLine = mProcessLine;
-    DEG_LOG("max line is %d", mMaxProcessLine);
+    mMaxProcessLine = mProcessLine.load();
+    DEG_LOG("max line is %ld", mMaxProcessLine.load());
 }
 
 std::vector<std::pair<int,std::string>> 
@@ -238,6 +463,9 @@ FileDescriptor::doProcess(
     pid_t               spid
 ) {
             std::vector<std::pair<int,std::string>> res;
+            if(line.find("EBADF") == std::string::npos) {
+                return res;
+            }
             auto result = regexProcess(FilePattern::Close_BadFile, line);
             if(std::get<3>(result) != -2) {
                 pid_t   pid      = std::get<0>(result);
@@ -256,6 +484,14 @@ FileDescriptor::doProcess(
                     res.push_back(std::pair<int,std::string>(fd, time));
                 }
             }
+            if(res.empty()) {
+                // dup2/dup3/fcntl on a closed fd explain an EBADF just as well
+                SyscallLine sc;
+                if(sc.parse(line) && sc.pid == spid && sc.error == "EBADF" 
+                   && (sc.call == SYSCALL::DUP2 || sc.call == SYSCALL::DUP3 || sc.call == SYSCALL::FCNTL)) {
+                    res.push_back(std::pair<int,std::string>(sc.intArg(0), std::string(sc.time)));
+                }
+            }
             return res;
 }
 
@@ -286,10 +522,7 @@ FileDescriptor::openWhole(
 
     Status status(pid, time, FDSTATUS::OPENING);
 
-    if(handle->mBadFileMap.count(fd) > 0) {
-        std::lock_guard<std::mutex> lock(handle->mProcessLock);
-        handle->mBadFileMap[fd].push(status);
-    }
+    record(handle, fd, status);
 
     /*
     {
@@ -300,13 +533,7 @@ FileDescriptor::openWhole(
     }
     */
 
-    {
-        std::lock_guard<std::mutex> lock(handle->mSuccessLock);
-        --handle->mProcessLine;
-        if(handle->mProcessLine == 0) {
-            handle->mSuccessCond.notify_all();
-        }
-    }
+    lineDone(handle);
 }
 
 void
@@ -317,14 +544,7 @@ FileDescriptor::openUnfinish(
     auto res = regexProcess(FilePattern::Open_Unfinish, line);
     //to do
 
-    {
-        std::lock_guard<std::mutex> lock(handle->mSuccessLock);
-        --handle->mProcessLine;
-        
-        if(handle->mProcessLine == 0) {
-            handle->mSuccessCond.notify_all();
-        }
-    }
+    lineDone(handle);
 
 
 }
@@ -342,10 +562,7 @@ FileDescriptor::openResume(
 
     Status status(pid, time, FDSTATUS::OPENING);
 
-    if(handle->mBadFileMap.count(fd) > 0) {
-        std::lock_guard<std::mutex> lock(handle->mProcessLock);
-        handle->mBadFileMap[fd].push(status);
-    }
+    record(handle, fd, status);
 
     /*
     {
@@ -356,13 +573,7 @@ FileDescriptor::openResume(
     }
     */
 
-    {
-        std::lock_guard<std::mutex> lock(handle->mSuccessLock);
-        --handle->mProcessLine;
-        if(handle->mProcessLine == 0) {
-            handle->mSuccessCond.notify_all();
-        }
-    }
+    lineDone(handle);
 
 }
 
@@ -394,10 +605,7 @@ FileDescriptor::closeWhole(
 
     Status status(pid, time, FDSTATUS::CLOSED);
 
-    if(handle->mBadFileMap.count(fd) > 0) {
-        std::lock_guard<std::mutex> lock(handle->mProcessLock);
-        handle->mBadFileMap[fd].push(status);
-    }
+    record(handle, fd, status);
 
     /*
     {
@@ -408,13 +616,7 @@ FileDescriptor::closeWhole(
     }
     */
 
-    {
-        std::lock_guard<std::mutex> lock(handle->mSuccessLock);
-        --handle->mProcessLine;
-        if(handle->mProcessLine == 0) {
-            handle->mSuccessCond.notify_all();
-        }
-    }
+    lineDone(handle);
 
 }
 
@@ -431,10 +633,7 @@ FileDescriptor::closeUnfinish(
 
     Status status(pid, time, FDSTATUS::CLOSED);
 
-    if(handle->mBadFileMap.count(fd) > 0) {
-        std::lock_guard<std::mutex> lock(handle->mProcessLock);
-        handle->mBadFileMap[fd].push(status);
-    }
+    record(handle, fd, status);
     /*
     {
         std::lock_guard<std::mutex> lock(handle->mProcessLock);
@@ -444,13 +643,7 @@ FileDescriptor::closeUnfinish(
     }
     */
 
-    {
-        std::lock_guard<std::mutex> lock(handle->mSuccessLock);
-        --handle->mProcessLine;
-        if(handle->mProcessLine == 0) {
-            handle->mSuccessCond.notify_all();
-        } 
-    }
+    lineDone(handle);
 }
 
 void 
@@ -460,13 +653,7 @@ FileDescriptor::closeResume(
 ) {
     auto res = regexProcess(FilePattern::Close_Resume, line);
     //to do
-    {
-        std::lock_guard<std::mutex> lock(handle->mSuccessLock);
-        --handle->mProcessLine;
-        if(handle->mProcessLine == 0) {
-            handle->mSuccessCond.notify_all();
-        }    
-    }
+    lineDone(handle);
 }
 
 void
@@ -497,10 +684,7 @@ FileDescriptor::dumpWhole(
 
     Status status(pid, time, FDSTATUS::DUMPING);
 
-    if(handle->mBadFileMap.count(fd) > 0) {
-        std::lock_guard<std::mutex> lock(handle->mProcessLock);
-        handle->mBadFileMap[fd].push(status);
-    }
+    record(handle, fd, status);
 
     /*
     {
@@ -512,10 +696,7 @@ FileDescriptor::dumpWhole(
     */
 
     status = Status(pid, time, FDSTATUS::OPENING);
-    if(handle->mBadFileMap.count(dumpfd) > 0) {
-        std::lock_guard<std::mutex> lock(handle->mProcessLock);
-        handle->mBadFileMap[dumpfd].push(status);
-    }
+    record(handle, dumpfd, status);
 
     /*
     {
@@ -526,13 +707,7 @@ FileDescriptor::dumpWhole(
     }
     */
 
-    {
-        std::lock_guard<std::mutex> lock(handle->mSuccessLock);
-        --handle->mProcessLine;
-        if(handle->mProcessLine == 0) {
-            handle->mSuccessCond.notify_all();
-        }
-    }
+    lineDone(handle);
 
 }
 
@@ -548,10 +723,7 @@ FileDescriptor::dumpUnfinish(
 
     Status status(pid, time, FDSTATUS::DUMPING);
 
-    if(handle->mBadFileMap.count(fd) > 0) {
-        std::lock_guard<std::mutex> lock(handle->mProcessLock);
-        handle->mBadFileMap[fd].push(status);
-    }
+    record(handle, fd, status);
 
     /*
     {
@@ -562,13 +734,7 @@ FileDescriptor::dumpUnfinish(
     }
     */
 
-    {
-        std::lock_guard<std::mutex> lock(handle->mSuccessLock);
-        --handle->mProcessLine;
-        if(handle->mProcessLine == 0) {
-            handle->mSuccessCond.notify_all();
-        }
-    }
+    lineDone(handle);
 }
 
 void 
@@ -582,10 +748,7 @@ FileDescriptor::dumpResume(
     std::string time = std::get<2>(res);
 
     Status status(pid, time, FDSTATUS::OPENING);
-    if(handle->mBadFileMap.count(fd) > 0) {
-        std::lock_guard<std::mutex> lock(handle->mProcessLock);
-        handle->mBadFileMap[fd].push(status);
-    }
+    record(handle, fd, status);
 
     /*
     {
@@ -596,13 +759,7 @@ FileDescriptor::dumpResume(
     }
     */
 
-    {
-        std::lock_guard<std::mutex> lock(handle->mSuccessLock);
-        --handle->mProcessLine;
-        if(handle->mProcessLine == 0) {
-            handle->mSuccessCond.notify_all();
-        }
-    }
+    lineDone(handle);
 }
 
 void    
@@ -610,11 +767,171 @@ FileDescriptor::irrelevantProcess(
     const std::string &line, 
     FileDescriptor * handle
 ) {
-    {
-        std::lock_guard<std::mutex> lock(handle->mSuccessLock);
-        --handle->mProcessLine;
-        if(handle->mProcessLine == 0) {
-            handle->mSuccessCond.notify_all();
+    lineDone(handle);
+}
+
+FileDescriptor::Dispatch
+FileDescriptor::buildDispatch() {
+    Dispatch dispatch;
+    dispatch.fill(irrelevantProcess);
+
+    auto set = [&](SYSCALL call, Handler handler) {
+        dispatch[static_cast<size_t>(call)] = handler;
+    };
+    set(SYSCALL::OPENAT,        processOpen);
+    set(SYSCALL::CLOSE,         processClose);
+    set(SYSCALL::DUP,           processDump);
+
+    set(SYSCALL::OPEN,          processCreate);
+    set(SYSCALL::OPENAT2,       processCreate);
+    set(SYSCALL::CREAT,         processCreate);
+    set(SYSCALL::SOCKET,        processCreate);
+    set(SYSCALL::ACCEPT,        processCreate);
+    set(SYSCALL::ACCEPT4,       processCreate);
+    set(SYSCALL::EVENTFD,       processCreate);
+    set(SYSCALL::EVENTFD2,      processCreate);
+    set(SYSCALL::EPOLL_CREATE,  processCreate);
+    set(SYSCALL::EPOLL_CREATE1, processCreate);
+    set(SYSCALL::MEMFD_CREATE,  processCreate);
+    set(SYSCALL::TIMERFD_CREATE,processCreate);
+    set(SYSCALL::SIGNALFD,      processCreate);
+    set(SYSCALL::SIGNALFD4,     processCreate);
+    set(SYSCALL::INOTIFY_INIT,  processCreate);
+    set(SYSCALL::INOTIFY_INIT1, processCreate);
+
+    set(SYSCALL::DUP2,          processDup2);
+    set(SYSCALL::DUP3,          processDup2);
+    set(SYSCALL::FCNTL,         processFcntl);
+    set(SYSCALL::PIPE,          processPipe);
+    set(SYSCALL::PIPE2,         processPipe);
+    set(SYSCALL::SOCKETPAIR,    processPipe);
+    set(SYSCALL::CLOSE_RANGE,   processCloseRange);
+    return dispatch;
+}
+
+void
+FileDescriptor::record(
+    FileDescriptor*     handle,
+    long                fd,
+    const Status &      status
+) {
+    if(fd < 0 || handle->mBadFileMap.count(fd) == 0) {
+        return ;
+    }
+    std::lock_guard<std::mutex> lock(handle->mProcessLock);
+    handle->mBadFileMap[fd].push(status);
+    handle->mHistoryBytes += sizeof(Status);
+    handle->mHistoryCharge.set(handle->mHistoryBytes);
+    if(handle->mSpillable && handle->mMemoryBudget && handle->mHistoryBytes > handle->mMemoryBudget) {
+        handle->spillHistory();
+    }
+}
+
+void
+FileDescriptor::lineDone(
+    FileDescriptor*     handle
+) {
+    std::lock_guard<std::mutex> lock(handle->mSuccessLock);
+    long left = --handle->mProcessLine;
+    if(left == 0 || left == handle->mWakeLine) {
+        handle->mSuccessCond.notify_all();
+    }
+}
+
+void
+FileDescriptor::processCreate(
+    const std::string   &line,
+    FileDescriptor*     handle
+) {
+    // open, socket, accept4, eventfd2, ...: the new fd is the return value
+    SyscallLine sc;
+    if(sc.parse(line) && sc.phase != PHASE::UNFINISH && sc.hasRet && sc.ret >= 0) {
+        record(handle, sc.ret, Status(sc.pid, std::string(sc.time), FDSTATUS::OPENING));
+    }
+    lineDone(handle);
+}
+
+void
+FileDescriptor::processDup2(
+    const std::string   &line,
+    FileDescriptor*     handle
+) {
+    // dup2(old, new) / dup3(old, new, flags): new is silently closed and reopened
+    SyscallLine sc;
+    if(sc.parse(line)) {
+        std::string time(sc.time);
+        if(sc.phase == PHASE::RESUME) {
+            if(sc.hasRet && sc.ret >= 0) {
+                record(handle, sc.ret, Status(sc.pid, time, FDSTATUS::OPENING));
+            }
+        } else {
+            long oldfd = sc.intArg(0);
+            long newfd = sc.intArg(1);
+            record(handle, oldfd, Status(sc.pid, time, FDSTATUS::DUMPING));
+            if(sc.phase == PHASE::WHOLE && !sc.failed() && newfd != oldfd) {
+                record(handle, newfd, Status(sc.pid, time, FDSTATUS::OPENING));
+            }
+        }
+    }
+    lineDone(handle);
+}
+
+void
+FileDescriptor::processFcntl(
+    const std::string   &line,
+    FileDescriptor*     handle
+) {
+    // only F_DUPFD / F_DUPFD_CLOEXEC create fds; a resumed fcntl line does not
+    // carry its command, so only whole and unfinished lines are considered
+    SyscallLine sc;
+    if(sc.parse(line) && sc.phase != PHASE::RESUME && sc.arg(1).substr(0, 7) == "F_DUPFD") {
+        std::string time(sc.time);
+        record(handle, sc.intArg(0), Status(sc.pid, time, FDSTATUS::DUMPING));
+        if(sc.phase == PHASE::WHOLE && sc.hasRet && sc.ret >= 0) {
+            record(handle, sc.ret, Status(sc.pid, time, FDSTATUS::OPENING));
+        }
+    }
+    lineDone(handle);
+}
+
+void
+FileDescriptor::processPipe(
+    const std::string   &line,
+    FileDescriptor*     handle
+) {
+    // pipe/pipe2([r, w]) and socketpair(d, t, p, [a, b]) return 0 and fill an array
+    SyscallLine sc;
+    if(sc.parse(line) && sc.phase != PHASE::UNFINISH && sc.hasRet && sc.ret == 0) {
+        size_t index = sc.call == SYSCALL::SOCKETPAIR ? 3 : 0;
+        long first = -1, second = -1;
+        if(sc.fdPair(index, first, second)) {
+            std::string time(sc.time);
+            record(handle, first,  Status(sc.pid, time, FDSTATUS::OPENING));
+            record(handle, second, Status(sc.pid, time, FDSTATUS::OPENING));
+        }
+    }
+    lineDone(handle);
+}
+
+void
+FileDescriptor::processCloseRange(
+    const std::string   &line,
+    FileDescriptor*     handle
+) {
+    // close_range(first, last, flags): last is often ~0U
+    SyscallLine sc;
+    if(sc.parse(line) && sc.phase != PHASE::RESUME && !sc.failed()) {
+        long first = sc.intArg(0);
+        long last  = sc.intArg(1, LONG_MAX);
+        if(first >= 0) {
+            std::string time(sc.time);
+            // the key set of mBadFileMap is fixed once detectEBADF() is done
+            for(const auto & element : handle->mBadFileMap) {
+                if(element.first >= first && element.first <= last) {
+                    record(handle, element.first, Status(sc.pid, time, FDSTATUS::CLOSED));
+                }
+            }
         }
     }
+    lineDone(handle);
 }
@@ -9,8 +9,15 @@
 #include <atomic>
 
 #include <set>
+#include <array>
 
+#include "Analyzer.h"
+#include "ResultStore.h"
 #include "ThreadPool.h"
+#include "SyscallLine.h"
+#include "TraceReader.h"
+#include "HistorySpill.h"
+#include "MemoryStats.h"
 #include "util.h"
 
 
@@ -39,9 +46,10 @@ private:
     FilePattern& operator=(const FilePattern &) = delete;
 };
 
-class FileDescriptor {
+class FileDescriptor : public Analyzer {
 private:
-    using ResultData = std::unordered_map<fd_t, std::vector<Status>>;
+    using Handler    = void (*)(const std::string &, FileDescriptor *);
+    using Dispatch   = std::array<Handler, static_cast<size_t>(SYSCALL::COUNT)>;
 
 public:
     FileDescriptor(const FileDescriptor &) = delete;
@@ -49,18 +57,29 @@ public:
 
 public:
     static FileDescriptor*  getInstance();  
-    void    initResources(pid_t, const std::string, unsigned);
-    void    process();  
+    void    initResources(pid_t, const std::string, unsigned) override;
+    void    process() override;
     //void    dump();
 
-    long    processedLine();
-    ResultData  getResult();
+    double  progress() override;
+    void    cancel() override;
+    ResultHandle    getResult();
+
+    // Bytes of queued fd history kept in memory before it spills to sorted
+    // run files on disk (see HistorySpill); 0 keeps everything in memory.
+    void    setMemoryBudget(size_t bytes);
+
+    // Triage: stop reading once the first `incidents` EBADF calls of the
+    // process, in trace order, are found, and report only those with the
+    // history before them (ResultStore::partial); 0 scans the whole trace.
+    void    setTriage(size_t incidents);
+
+    static std::tuple<pid_t, fd_t, std::string, fd_t> 
+        regexProcess(const std::regex & pattern, const std::string & line);
 
 private:
     static std::vector<std::pair<int,std::string>>    
         doProcess(const std::string, pid_t pid);
-    static std::tuple<pid_t, fd_t, std::string, fd_t> 
-        regexProcess(const std::regex & pattern, const std::string & line);
 
     void    setProcessId(pid_t pid);
     void    setFilePath(const std::string file);
@@ -71,6 +90,8 @@ private:
 
 
     void    detectEBADF();
+    void    release();
+    void    spillHistory();
 
     static void    processOpen(const std::string & line, FileDescriptor * instance);
     static void    openWhole(const std::string & line, FileDescriptor * instance);
@@ -87,8 +108,20 @@ private:
     static void    dumpUnfinish(const std::string & line, FileDescriptor * instance);
     static void    dumpResume(const std::string & line, FileDescriptor * instance);
 
+    static void    processCreate(const std::string & line, FileDescriptor * instance);
+    static void    processDup2(const std::string & line, FileDescriptor * instance);
+    static void    processFcntl(const std::string & line, FileDescriptor * instance);
+    static void    processPipe(const std::string & line, FileDescriptor * instance);
+    static void    processCloseRange(const std::string & line, FileDescriptor * instance);
+
     static void    irrelevantProcess(const std::string &line, FileDescriptor * instance);
 
+    static Dispatch    buildDispatch();
+    static void    record(FileDescriptor * instance, long fd, const Status & status);
+    static void    lineDone(FileDescriptor * instance);
+
+    static const Dispatch   sDispatch;
+
 private:
     pid_t           mProcessId;
     std::string     mFilePath;
@@ -96,13 +129,30 @@ private:
     std::unordered_map<pid_t,std::queue<fd_t>>  mOpenGraph;
     std::unordered_map<fd_t, Status>            mMapGraph;
     std::unordered_map<fd_t, std::queue<Status>>mBadFileMap;
-    std::unordered_map<fd_t, std::string>       mFileTimeMap;
+    std::unordered_map<fd_t, std::vector<long long>>    mBadTimeMap;   // every EBADF time per fd
+
+    // queued history over mMemoryBudget moves to mSpill; both under mProcessLock
+    static constexpr size_t MEMORYBUDGET = 256u << 20;
+    static constexpr long   QUEUEDLINES  = 1 << 16;     // lines queued in the pool at most, either pass
+    size_t                  mMemoryBudget;
+    size_t                  mHistoryBytes;
+    bool                    mSpillable;
+    HistorySpill            mSpill;
+    MemoryCharge            mHistoryCharge;     // mHistoryBytes, FileDescriptor.history
+    MemoryCharge            mIncidentCharge;    // mBadTimeMap, FileDescriptor.incidents
+
+    size_t                  mTriage;            // incidents wanted, 0: all
+    size_t                  mTriageFound;       // applied so far, handler thread only
+    std::atomic<bool>       mTriageHit;         // mTriage found, the scan stops
 
     //used when multi-thread
     std::mutex              mProcessLock;
     std::mutex              mSuccessLock;
-    long                    mProcessLine;
-    long                    mMaxProcessLine;
+    std::atomic<long>       mProcessLine;
+    std::atomic<long>       mMaxProcessLine;
+    long                    mWakeLine;          // mProcessLine that wakes the reader, under mSuccessLock
+    std::atomic<uint64_t>   mScanBytes;         // bytes through the EBADF pass
+    uint64_t                mFileBytes;
     std::condition_variable mSuccessCond;
 
     unsigned int            mThreadCnt;
@@ -12,11 +12,16 @@
 #include <queue>
 //#include <string>
 #include "FileDescriptor.h"
+#include "DescriptorMatch.h"
+#include "ResultStore.h"
+#include "DaemonClient.h"
 
 
-using ResultData = QHash<fd_t,QVector<Status>>;
+using ResultData = ResultHandle;
+using MatchData  = DescriptorMatch::MatchResult;
 
 Q_DECLARE_METATYPE(ResultData);
+Q_DECLARE_METATYPE(MatchData);
 
 class QProcessThread: public QThread {
     Q_OBJECT
@@ -42,13 +47,8 @@ protected:
     void run() {
         DEG_LOG("process(%p) begin xxx", mpFileDescriptor);
         mpFileDescriptor->process();
-        auto res = mpFileDescriptor->getResult();
+        ResultData data = mpFileDescriptor->getResult();
         DEG_LOG("process(%p) end xxx", mpFileDescriptor);
-        ResultData data;
-        for(auto it = res.begin(); it != res.end(); ++it) {
-            QVector<Status> rank = QVector<Status>::fromStdVector(it->second);
-            data.insert(it->first, rank);
-        }
         emit notify(data);
     }
 
@@ -62,41 +62,125 @@ private:
 
 
 
+class QMatchThread: public QThread {
+    Q_OBJECT
+public:
+    explicit QMatchThread(QObject *parent = 0): QThread(parent){
+        qRegisterMetaType<MatchData>("MatchData");
+    }
+
+    void initResources(
+        DescriptorMatch     *pHandler
+    ) {
+        mpDescriptorMatch = pHandler;
+    }
+
+protected:
+    void run() {
+        DEG_LOG("match(%p) begin xxx", mpDescriptorMatch);
+        mpDescriptorMatch->process();
+        DEG_LOG("match(%p) end xxx", mpDescriptorMatch);
+        emit notify(mpDescriptorMatch->getResult());
+    }
+
+signals:
+    void    notify(MatchData);
+
+
+private:
+    DescriptorMatch *mpDescriptorMatch = nullptr;
+};
+
+
+
+// Asks a running fdtraced for the result instead of analysing in process;
+// emits the same signals as the two threads above. An answer the daemon
+// has cached arrives at once. A failed request emits an empty result.
+class QDaemonThread: public QThread {
+    Q_OBJECT
+public:
+    explicit QDaemonThread(QObject *parent = 0): QThread(parent){
+        qRegisterMetaType<ResultData>("ResultData");
+        qRegisterMetaType<MatchData>("MatchData");
+    }
+
+    void initResources(
+        const std::string   &path,
+        pid_t               pid,
+        bool                match
+    ) {
+        mPath  = path;
+        mPid   = pid;
+        mMatch = match;
+    }
+
+    // makes the pending request fail; the daemon still finishes and caches the run
+    void abort() {
+        mClient.abort();
+    }
+
+protected:
+    void run() {
+        DEG_LOG("daemon request %s begin xxx", mPath.c_str());
+        if(mMatch) {
+            MatchData data;
+            if(!mClient.match(mPath, mPid, data)) {
+                std::cerr<<mClient.error()<<std::endl;
+                data = MatchData();
+            }
+            DEG_LOG("daemon request end, cached %d xxx", mClient.cached());
+            emit notifyMatch(data);
+        } else {
+            ResultData data;
+            if(!mClient.ebadf(mPath, mPid, data)) {
+                std::cerr<<mClient.error()<<std::endl;
+            }
+            DEG_LOG("daemon request end, cached %d xxx", mClient.cached());
+            emit notifyResult(data);
+        }
+    }
+
+signals:
+    void    notifyResult(ResultData);
+    void    notifyMatch(MatchData);
+
+
+private:
+    DaemonClient    mClient;
+    std::string     mPath;
+    pid_t           mPid   = -1;
+    bool            mMatch = true;
+};
+
+
+
+// Polls Analyzer::progress() at most PERIOD_MS apart and emits the percent
+// when it moved. Stops at 100%, on cancel, or on requestInterruption().
 class QBarThread: public QThread {
     Q_OBJECT
 public:
     explicit QBarThread(QObject *parent = 0): QThread(parent){}
-    explicit QBarThread(FileDescriptor * pHandler, const long lines, QObject * parent)
+    explicit QBarThread(Analyzer * pHandler, QObject * parent)
         : QThread(parent)
-        , mpFileDescriptor(pHandler)
-        , mFileLines(lines){}
+        , mpAnalyzer(pHandler){}
 
-    void    initResources(FileDescriptor * pHandler, const long lines) {
-        mpFileDescriptor = pHandler;
-        mFileLines = lines;
+    void    initResources(Analyzer * pHandler) {
+        mpAnalyzer = pHandler;
     }
 
 protected:
     void run() {
-        long lineBefore = 0;
-        while(true) {
-            long nlines = mpFileDescriptor->processedLine();
-            //DEG_LOG("PROCESS LINE: %d", nlines);
-            if(nlines >= 2 * mFileLines) {
-                long schedual = 1.0 * nlines / 2 / mFileLines * 100;
-                emit notify(schedual);
-                break;
-            }
-            if(nlines == lineBefore) {
-                continue;
-            } else {
-                double schedual = 1.0 * nlines / 2 / mFileLines * 100;
-                lineBefore = nlines;
+        double before = -1;
+        while(!isInterruptionRequested() && !mpAnalyzer->cancelled()) {
+            double schedual = mpAnalyzer->progress() * 100;
+            if(schedual != before) {
+                before = schedual;
                 emit notify(schedual);
             }
-            if(nlines >= 2 * mFileLines) {
+            if(schedual >= 100) {
                 break;
             }
+            msleep(PERIOD_MS);
         }
     }
 
@@ -104,8 +188,9 @@ signals:
     void notify(double);
 
 private:
-    FileDescriptor  *mpFileDescriptor = nullptr;
-    long            mFileLines = 0;
+    static const unsigned long  PERIOD_MS = 50;     // 20 Hz
+
+    Analyzer        *mpAnalyzer = nullptr;
 };
 
 
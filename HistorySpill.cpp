@@ -0,0 +1,128 @@
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <algorithm>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "HistorySpill.h"
+
+/******************* public function ********************************/
+HistorySpill::HistorySpill() {
+}
+
+HistorySpill::~HistorySpill() {
+    clear();
+}
+
+std::string
+HistorySpill::directory() {
+    const char * tmp = std::getenv("TMPDIR");
+    return tmp && *tmp ? tmp : "/tmp";
+}
+
+bool
+HistorySpill::spill(
+    std::vector<HistoryRecord> &    records
+) {
+    if(records.empty()) {
+        return true;
+    }
+    std::sort(records.begin(), records.end());
+
+    std::string path = directory() + "/fdhistory.XXXXXX";
+    int fd = mkstemp(&path[0]);
+    if(fd < 0) {
+        std::cerr<<path<<" can not be created: "<<std::strerror(errno)<<std::endl;
+        mRuns.emplace_back(new Run(std::move(records)));
+        return false;
+    }
+    // the open fd keeps the run alive; the name is not needed any more
+    unlink(path.c_str());
+
+    const char * data  = reinterpret_cast<const char *>(records.data());
+    size_t       total = records.size() * sizeof(HistoryRecord);
+    size_t       done  = 0;
+    while(done < total) {
+        ssize_t bytes = ::write(fd, data + done, total - done);
+        if(bytes < 0 && errno == EINTR) {
+            continue;
+        }
+        if(bytes <= 0) {
+            std::cerr<<"history spill failed: "<<std::strerror(errno)<<std::endl;
+            ::close(fd);
+            mRuns.emplace_back(new Run(std::move(records)));
+            return false;
+        }
+        done += static_cast<size_t>(bytes);
+    }
+
+    mRuns.emplace_back(new Run(fd, records.size()));
+    mBytes += total;
+    DEG_LOG("spilled %zu history records, run %zu", records.size(), mRuns.size());
+    std::vector<HistoryRecord>().swap(records);
+    return true;
+}
+
+void
+HistorySpill::clear() {
+    mRuns.clear();
+    mBytes = 0;
+}
+
+/******************* Run ********************************/
+HistorySpill::Run::Run(
+    int         fd,
+    uint64_t    count
+) : mFd(fd)
+  , mCount(count) {
+}
+
+HistorySpill::Run::Run(
+    std::vector<HistoryRecord> &&   records
+) : mFd(-1)
+  , mCount(records.size())
+  , mRead(records.size())
+  , mBuffer(std::move(records)) {
+}
+
+HistorySpill::Run::~Run() {
+    if(mFd >= 0) {
+        ::close(mFd);
+    }
+}
+
+bool
+HistorySpill::Run::fill() {
+    if(mFd < 0) {
+        return false;
+    }
+    size_t want = static_cast<size_t>(std::min<uint64_t>(BUFFERRECORDS, mCount - mRead));
+    mBuffer.resize(want);
+    mPos = 0;
+    if(want == 0) {
+        return false;
+    }
+
+    char *  data  = reinterpret_cast<char *>(mBuffer.data());
+    size_t  total = want * sizeof(HistoryRecord);
+    size_t  done  = 0;
+    while(done < total) {
+        off_t   offset = static_cast<off_t>(mRead * sizeof(HistoryRecord) + done);
+        ssize_t bytes  = ::pread(mFd, data + done, total - done, offset);
+        if(bytes < 0 && errno == EINTR) {
+            continue;
+        }
+        if(bytes <= 0) {
+            std::cerr<<"history run read failed: "<<std::strerror(errno)<<std::endl;
+            mBuffer.resize(done / sizeof(HistoryRecord));
+            mRead = mCount;
+            return !mBuffer.empty();
+        }
+        done += static_cast<size_t>(bytes);
+    }
+    mRead += want;
+    return true;
+}
@@ -0,0 +1,103 @@
+#ifndef _HISTORYSPILL_H_
+#define _HISTORYSPILL_H_
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <cstdint>
+
+#include "util.h"
+
+// One lifecycle event of a bad fd, packed for the spill files.
+struct HistoryRecord {
+    long long   usec;               // time of day, -1 when untimed
+    int32_t     pid;
+    fd_t        fd;
+    int16_t     status;             // FDSTATUS
+
+    friend bool operator<(const HistoryRecord & lhs, const HistoryRecord & rhs) {
+        return lhs.fd != rhs.fd ? lhs.fd < rhs.fd : lhs.usec < rhs.usec;
+    }
+};
+static_assert(sizeof(HistoryRecord) == 16, "spill files hold raw HistoryRecord");
+
+// Sorted run files of per-fd histories that no longer fit in memory.
+//
+// spill() sorts a batch by (fd, time) and writes it as one run to an
+// unlinked temporary file, so nothing is left on disk even after a crash.
+// The runs are read back with a small buffer each, merged by fd: ask for
+// the fds in ascending order and every record of an fd is visited once.
+class HistorySpill {
+public:
+    HistorySpill();
+    ~HistorySpill();
+    HistorySpill(const HistorySpill &) = delete;
+    HistorySpill& operator=(const HistorySpill &) = delete;
+
+    // Run files go to $TMPDIR, or /tmp.
+    static std::string  directory();
+
+    // Writes `records` as a new run and empties it. When the file can not
+    // be written the batch stays in memory as a run and false is returned.
+    bool    spill(std::vector<HistoryRecord> & records);
+
+    // Calls visit(record) for every spilled record of `fd`; fds must be
+    // asked in ascending order after the last spill().
+    template<typename Visit>
+    void    forEach(fd_t fd, Visit visit) {
+        for(auto & run : mRuns) {
+            const HistoryRecord * record;
+            while((record = run->peek()) && record->fd < fd) {
+                run->pop();
+            }
+            while((record = run->peek()) && record->fd == fd) {
+                visit(*record);
+                run->pop();
+            }
+        }
+    }
+
+    // Closes and drops every run.
+    void    clear();
+
+    size_t      runs() const {
+        return mRuns.size();
+    }
+    uint64_t    bytes() const {
+        return mBytes;
+    }
+
+private:
+    class Run {
+    public:
+        Run(int fd, uint64_t count);
+        explicit Run(std::vector<HistoryRecord> && records);
+        ~Run();
+
+        const HistoryRecord *   peek() {
+            if(mPos == mBuffer.size() && !fill()) {
+                return nullptr;
+            }
+            return &mBuffer[mPos];
+        }
+        void    pop() {
+            ++mPos;
+        }
+
+    private:
+        bool    fill();
+
+        static constexpr size_t BUFFERRECORDS = 4096;     // 64 KB per run
+
+        int         mFd;            // -1: the whole run is in mBuffer
+        uint64_t    mCount;
+        uint64_t    mRead = 0;
+        std::vector<HistoryRecord>  mBuffer;
+        size_t      mPos = 0;
+    };
+
+    std::vector<std::unique_ptr<Run>>   mRuns;
+    uint64_t    mBytes = 0;
+};
+
+#endif
@@ -0,0 +1,270 @@
+#include <cmath>
+#include <algorithm>
+
+#include "LatencyStats.h"
+#include "Checkpoint.h"
+
+/******************* LatencyHistogram ********************************/
+void
+LatencyHistogram::record(
+    long long   usec
+) {
+    usec = usec < 0 ? 0 : usec;
+    size_t index = indexOf(usec);
+    if(index >= mCounts.size()) {
+        mCounts.resize(index + 1, 0);
+    }
+    ++mCounts[index];
+    ++mCount;
+    mSum += usec;
+    mMax  = std::max(mMax, usec);
+}
+
+void
+LatencyHistogram::merge(
+    const LatencyHistogram &    other
+) {
+    if(other.mCounts.size() > mCounts.size()) {
+        mCounts.resize(other.mCounts.size(), 0);
+    }
+    for(size_t index = 0; index < other.mCounts.size(); ++index) {
+        mCounts[index] += other.mCounts[index];
+    }
+    mCount += other.mCount;
+    mSum   += other.mSum;
+    mMax    = std::max(mMax, other.mMax);
+}
+
+long long
+LatencyHistogram::percentile(
+    double  fraction
+) const {
+    if(mCount == 0) {
+        return 0;
+    }
+    uint64_t rank = static_cast<uint64_t>(std::ceil(std::min(std::max(fraction, 0.0), 1.0) * mCount));
+    rank = std::max<uint64_t>(rank, 1);
+    uint64_t seen = 0;
+    for(size_t index = 0; index < mCounts.size(); ++index) {
+        seen += mCounts[index];
+        if(seen >= rank) {
+            return std::min(highest(index), mMax);
+        }
+    }
+    return mMax;
+}
+
+void
+LatencyHistogram::put(
+    CheckpointWriter &  out
+) const {
+    out.putU64(mCount);
+    out.putI64(mSum);
+    out.putI64(mMax);
+    // sparse: most buckets of a long tail are empty
+    size_t used = static_cast<size_t>(std::count_if(mCounts.begin(), mCounts.end(),
+                                                    [](uint64_t count){ return count > 0; }));
+    out.putU64(used);
+    for(size_t index = 0; index < mCounts.size(); ++index) {
+        if(mCounts[index] > 0) {
+            out.putU32(static_cast<uint32_t>(index));
+            out.putU64(mCounts[index]);
+        }
+    }
+}
+
+bool
+LatencyHistogram::get(
+    CheckpointReader &  in
+) {
+    *this = LatencyHistogram();
+    mCount = in.getU64();
+    mSum   = in.getI64();
+    mMax   = in.getI64();
+    for(uint64_t used = in.getU64(); in.ok() && used > 0; --used) {
+        size_t index = in.getU32();
+        if(index > indexOf(1ll << 62)) {
+            in.fail();
+            break;
+        }
+        if(index >= mCounts.size()) {
+            mCounts.resize(index + 1, 0);
+        }
+        mCounts[index] = in.getU64();
+    }
+    return in.ok();
+}
+
+size_t
+LatencyHistogram::indexOf(
+    long long   usec
+) {
+    uint64_t value = static_cast<uint64_t>(usec);
+    if(value < SUBBUCKETS) {
+        return static_cast<size_t>(value);
+    }
+    int shift = 63 - __builtin_clzll(value) - (SUBBITS - 1);
+    return static_cast<size_t>(shift) * (SUBBUCKETS / 2) + static_cast<size_t>(value >> shift);
+}
+
+long long
+LatencyHistogram::highest(
+    size_t  index
+) {
+    if(index < SUBBUCKETS) {
+        return static_cast<long long>(index);
+    }
+    size_t shift = index / (SUBBUCKETS / 2) - 1;
+    uint64_t lowest = static_cast<uint64_t>(index - shift * (SUBBUCKETS / 2)) << shift;
+    return static_cast<long long>(lowest + (uint64_t(1) << shift) - 1);
+}
+
+/******************* LatencyStats ********************************/
+void
+LatencyStats::add(
+    const FdCall &  call
+) {
+    if(call.duration < 0) {
+        return ;
+    }
+    ++mCalls;
+    mPerCall[static_cast<size_t>(call.call)].record(call.duration);
+    mPerTid[call.pid].record(call.duration);
+    long fd = fdOf(call);
+    if(fd >= 0) {
+        mPerFd[fd].record(call.duration);
+    }
+    if(mSlowest.size() < TOPLEN || call.duration > mSlowest.front().duration) {
+        Slow slow;
+        slow.duration = call.duration;
+        slow.pid      = call.pid;
+        slow.call     = call.call;
+        slow.fd       = fd;
+        slow.ret      = call.ret;
+        slow.usec     = call.usec;
+        slow.offset   = call.offset;
+        keep(slow);
+    }
+}
+
+void
+LatencyStats::merge(
+    const LatencyStats &    other
+) {
+    for(size_t indx = 0; indx < mPerCall.size(); ++indx) {
+        mPerCall[indx].merge(other.mPerCall[indx]);
+    }
+    for(const auto & element : other.mPerFd) {
+        mPerFd[element.first].merge(element.second);
+    }
+    for(const auto & element : other.mPerTid) {
+        mPerTid[element.first].merge(element.second);
+    }
+    for(const auto & slow : other.mSlowest) {
+        if(mSlowest.size() < TOPLEN || slow.duration > mSlowest.front().duration) {
+            keep(slow);
+        }
+    }
+    mCalls += other.mCalls;
+}
+
+void
+LatencyStats::clear() {
+    *this = LatencyStats();
+}
+
+std::vector<LatencyStats::Slow>
+LatencyStats::slowest() const {
+    std::vector<Slow> slowest = mSlowest;
+    std::sort(slowest.begin(), slowest.end(), slower);
+    return slowest;
+}
+
+long
+LatencyStats::fdOf(
+    const FdCall &  call
+) {
+    if(SyscallTable::takesFd(call.call)) {
+        return call.arg0;
+    }
+    if(SyscallTable::spawns(call.call) || call.call == SYSCALL::PIPE || call.call == SYSCALL::PIPE2
+       || call.call == SYSCALL::SOCKETPAIR) {
+        return call.pair0;
+    }
+    return call.hasRet && call.ret >= 0 ? call.ret : -1;
+}
+
+void
+LatencyStats::put(
+    CheckpointWriter &  out
+) const {
+    out.putU64(mCalls);
+    for(const auto & histogram : mPerCall) {
+        histogram.put(out);
+    }
+    out.putU64(mPerFd.size());
+    for(const auto & element : mPerFd) {
+        out.putI64(element.first);
+        element.second.put(out);
+    }
+    out.putU64(mPerTid.size());
+    for(const auto & element : mPerTid) {
+        out.putI64(element.first);
+        element.second.put(out);
+    }
+    out.putU64(mSlowest.size());
+    for(const auto & slow : mSlowest) {
+        out.putI64(slow.duration);
+        out.putI64(slow.pid);
+        out.putU8(static_cast<uint8_t>(slow.call));
+        out.putI64(slow.fd);
+        out.putI64(slow.ret);
+        out.putI64(slow.usec);
+        out.putU64(slow.offset);
+    }
+}
+
+bool
+LatencyStats::get(
+    CheckpointReader &  in
+) {
+    clear();
+    mCalls = in.getU64();
+    for(auto & histogram : mPerCall) {
+        histogram.get(in);
+    }
+    for(uint64_t fds = in.getU64(); in.ok() && fds > 0; --fds) {
+        long fd = static_cast<long>(in.getI64());
+        mPerFd[fd].get(in);
+    }
+    for(uint64_t tids = in.getU64(); in.ok() && tids > 0; --tids) {
+        pid_t tid = static_cast<pid_t>(in.getI64());
+        mPerTid[tid].get(in);
+    }
+    for(uint64_t slows = in.getU64(); in.ok() && slows > 0; --slows) {
+        Slow slow;
+        slow.duration = in.getI64();
+        slow.pid      = static_cast<pid_t>(in.getI64());
+        slow.call     = static_cast<SYSCALL>(in.getU8());
+        slow.fd       = static_cast<long>(in.getI64());
+        slow.ret      = static_cast<long>(in.getI64());
+        slow.usec     = in.getI64();
+        slow.offset   = in.getU64();
+        keep(slow);
+    }
+    return in.ok();
+}
+
+/******************* private function ********************************/
+void
+LatencyStats::keep(
+    const Slow &    slow
+) {
+    // min-heap: the fastest of the kept calls is the one to drop
+    if(mSlowest.size() >= TOPLEN) {
+        std::pop_heap(mSlowest.begin(), mSlowest.end(), slower);
+        mSlowest.pop_back();
+    }
+    mSlowest.push_back(slow);
+    std::push_heap(mSlowest.begin(), mSlowest.end(), slower);
+}
@@ -0,0 +1,122 @@
+#ifndef _LATENCYSTATS_H_
+#define _LATENCYSTATS_H_
+
+#include <array>
+#include <vector>
+#include <cstdint>
+#include <unordered_map>
+
+#include <sys/types.h>
+
+#include "FdEvent.h"
+
+class CheckpointWriter;
+class CheckpointReader;
+
+// Counts of durations in log-linear buckets, the HdrHistogram layout:
+// values below SUBBUCKETS each have a bucket, every power of two above
+// that is split into SUBBUCKETS / 2, so a bucket is within 1/64 of its
+// values. Recording is a count-leading-zeros and an add; histograms of the
+// same layout merge by adding buckets.
+class LatencyHistogram {
+public:
+    void        record(long long usec);
+    void        merge(const LatencyHistogram & other);
+
+    uint64_t    count() const {
+        return mCount;
+    }
+    long long   max() const {
+        return mMax;
+    }
+    double      mean() const {
+        return mCount > 0 ? static_cast<double>(mSum) / mCount : 0.0;
+    }
+    // Highest value of the bucket holding the `fraction` quantile, 0 when empty.
+    long long   percentile(double fraction) const;
+
+    // Snapshot coding, shared by checkpoints and DaemonProtocol.
+    void        put(CheckpointWriter & out) const;
+    bool        get(CheckpointReader & in);
+
+    static size_t       indexOf(long long usec);
+    static long long    highest(size_t index);
+
+private:
+    static constexpr int    SUBBITS     = 7;
+    static constexpr size_t SUBBUCKETS  = size_t(1) << SUBBITS;
+
+    std::vector<uint64_t>   mCounts;    // grows to the highest bucket used
+    uint64_t    mCount  = 0;
+    long long   mSum    = 0;
+    long long   mMax    = 0;
+};
+
+// Durations of the fd calls of a strace -T trace, per syscall, per fd
+// number and per task, and the TOPLEN slowest calls. Fed with complete
+// calls in trace order; calls without a duration are skipped at the cost
+// of one compare.
+class LatencyStats {
+public:
+    struct Slow {
+        long long   duration    = 0;
+        pid_t       pid         = -1;
+        SYSCALL     call        = SYSCALL::UNKNOWN;
+        long        fd          = -1;
+        long        ret         = 0;
+        long long   usec        = -1;   // completion time
+        uint64_t    offset      = 0;
+    };
+
+    using CallHistograms = std::array<LatencyHistogram, static_cast<size_t>(SYSCALL::COUNT)>;
+
+public:
+    void    add(const FdCall & call);
+    void    merge(const LatencyStats & other);
+    void    clear();
+
+    bool    empty() const {
+        return mCalls == 0;
+    }
+    uint64_t    calls() const {
+        return mCalls;
+    }
+    const LatencyHistogram &    of(SYSCALL call) const {
+        return mPerCall[static_cast<size_t>(call)];
+    }
+    const CallHistograms &      perCall() const {
+        return mPerCall;
+    }
+    const std::unordered_map<long, LatencyHistogram> &  perFd() const {
+        return mPerFd;
+    }
+    const std::unordered_map<pid_t, LatencyHistogram> & perTid() const {
+        return mPerTid;
+    }
+    // Slowest first.
+    std::vector<Slow>   slowest() const;
+
+    // The fd a call worked on: the one it closed or duplicated, or the one
+    // it made (a pipe's read end); -1 for spawns and failed opens.
+    static long fdOf(const FdCall & call);
+
+    void    put(CheckpointWriter & out) const;
+    bool    get(CheckpointReader & in);
+
+private:
+    static constexpr size_t TOPLEN = 16;
+
+    static bool slower(const Slow & lhs, const Slow & rhs) {
+        return lhs.duration > rhs.duration;
+    }
+    void    keep(const Slow & slow);
+
+private:
+    CallHistograms      mPerCall;
+    std::unordered_map<long, LatencyHistogram>  mPerFd;
+    std::unordered_map<pid_t, LatencyHistogram> mPerTid;
+    std::vector<Slow>   mSlowest;       // min-heap on duration, at most TOPLEN
+    uint64_t            mCalls = 0;
+};
+
+#endif
@@ -0,0 +1,94 @@
+#ifndef _LTTB_H_
+#define _LTTB_H_
+
+#include <cmath>
+#include <vector>
+#include <algorithm>
+
+struct LttbPoint {
+    double  x;
+    double  y;
+};
+
+// Largest-Triangle-Three-Buckets downsampling (Steinarsson, 2013).
+// `points` must be sorted by x. Keeps the first and last point and, per
+// bucket, the point spanning the largest triangle with its neighbours,
+// which preserves peaks far better than averaging or striding.
+class Lttb {
+public:
+    static std::vector<LttbPoint>
+    sample(const LttbPoint * points, size_t count, size_t threshold) {
+        std::vector<LttbPoint> out;
+        if(threshold >= count || threshold < 3) {
+            out.assign(points, points + count);
+            return out;
+        }
+
+        out.reserve(threshold);
+        out.push_back(points[0]);
+
+        double every = static_cast<double>(count - 2) / (threshold - 2);
+        size_t a = 0;
+        for(size_t bucket = 0; bucket < threshold - 2; ++bucket) {
+            // average of the next bucket is the third triangle corner
+            size_t nextBegin = static_cast<size_t>(std::floor((bucket + 1) * every)) + 1;
+            size_t nextEnd   = std::min(static_cast<size_t>(std::floor((bucket + 2) * every)) + 1, count);
+            double avgX = 0, avgY = 0;
+            for(size_t indx = nextBegin; indx < nextEnd; ++indx) {
+                avgX += points[indx].x;
+                avgY += points[indx].y;
+            }
+            size_t nextCount = nextEnd > nextBegin ? nextEnd - nextBegin : 1;
+            avgX /= nextCount;
+            avgY /= nextCount;
+            if(nextEnd <= nextBegin) {
+                avgX = points[count - 1].x;
+                avgY = points[count - 1].y;
+            }
+
+            size_t begin = static_cast<size_t>(std::floor(bucket * every)) + 1;
+            size_t end   = static_cast<size_t>(std::floor((bucket + 1) * every)) + 1;
+            double ax = points[a].x, ay = points[a].y;
+            double best = -1;
+            size_t pick = begin;
+            for(size_t indx = begin; indx < end && indx < count - 1; ++indx) {
+                double area = std::fabs((ax - avgX) * (points[indx].y - ay)
+                                      - (ax - points[indx].x) * (avgY - ay));
+                if(area > best) {
+                    best = area;
+                    pick = indx;
+                }
+            }
+            out.push_back(points[pick]);
+            a = pick;
+        }
+
+        out.push_back(points[count - 1]);
+        return out;
+    }
+
+    // Downsamples only the points with x in [lo, hi], plus one neighbour on
+    // each side so the line runs to the edges of the visible range.
+    static std::vector<LttbPoint>
+    sampleRange(const std::vector<LttbPoint> & points, double lo, double hi, size_t threshold) {
+        auto less = [](const LttbPoint & point, double x){ return point.x < x; };
+        auto first = std::lower_bound(points.begin(), points.end(), lo, less);
+        auto last  = std::lower_bound(first, points.end(), hi, less);
+        if(first != points.begin()) {
+            --first;
+        }
+        if(last != points.end()) {
+            ++last;
+        }
+        size_t count = static_cast<size_t>(last - first);
+        if(count == 0) {
+            return std::vector<LttbPoint>();
+        }
+        return sample(&*first, count, threshold);
+    }
+
+private:
+    Lttb() = delete;
+};
+
+#endif
@@ -0,0 +1,211 @@
+#ifndef _MEMORYSTATS_H_
+#define _MEMORYSTATS_H_
+
+#include <map>
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstdint>
+
+// Bytes held by one kind of engine structure, summed over all its
+// instances, with the peak since the last resetPeak(). Relaxed atomics:
+// callable from any thread, a count is off by at most the updates in flight.
+class MemoryAccount {
+public:
+    explicit MemoryAccount(const std::string & name): mName(name), mCurrent(0), mPeak(0) {}
+
+    void    add(size_t bytes) {
+        int64_t now  = mCurrent.fetch_add(static_cast<int64_t>(bytes), std::memory_order_relaxed)
+                     + static_cast<int64_t>(bytes);
+        int64_t peak = mPeak.load(std::memory_order_relaxed);
+        while(now > peak && !mPeak.compare_exchange_weak(peak, now, std::memory_order_relaxed)) {
+        }
+    }
+
+    void    sub(size_t bytes) {
+        mCurrent.fetch_sub(static_cast<int64_t>(bytes), std::memory_order_relaxed);
+    }
+
+    size_t  current() const {
+        int64_t now = mCurrent.load(std::memory_order_relaxed);
+        return now > 0 ? static_cast<size_t>(now) : 0;
+    }
+
+    size_t  peak() const {
+        return static_cast<size_t>(mPeak.load(std::memory_order_relaxed));
+    }
+
+    void    resetPeak() {
+        mPeak.store(static_cast<int64_t>(current()), std::memory_order_relaxed);
+    }
+
+    const std::string & name() const {
+        return mName;
+    }
+
+private:
+    MemoryAccount(const MemoryAccount &) = delete;
+    MemoryAccount& operator=(const MemoryAccount &) = delete;
+
+private:
+    std::string             mName;
+    std::atomic<int64_t>    mCurrent;
+    std::atomic<int64_t>    mPeak;
+};
+
+// Bytes one object holds in an account, set as the object grows and
+// shrinks and given back when it dies. A copy holds nothing until set.
+class MemoryCharge {
+public:
+    explicit MemoryCharge(MemoryAccount & account): mpAccount(&account), mBytes(0) {}
+    MemoryCharge(const MemoryCharge & other): mpAccount(other.mpAccount), mBytes(0) {}
+    MemoryCharge& operator=(const MemoryCharge &) {
+        return *this;
+    }
+    ~MemoryCharge() {
+        mpAccount->sub(mBytes);
+    }
+
+    void    set(size_t bytes) {
+        if(bytes > mBytes) {
+            mpAccount->add(bytes - mBytes);
+        } else {
+            mpAccount->sub(mBytes - bytes);
+        }
+        mBytes = bytes;
+    }
+
+    size_t  bytes() const {
+        return mBytes;
+    }
+
+private:
+    MemoryAccount   *mpAccount;
+    size_t          mBytes;
+};
+
+// std::allocator that counts what it hands out in an account, for node and
+// page containers whose size is not worth measuring by hand.
+template<typename T>
+class CountingAllocator {
+public:
+    using value_type = T;
+
+    explicit CountingAllocator(MemoryAccount & account): mpAccount(&account) {}
+    template<typename U>
+    CountingAllocator(const CountingAllocator<U> & other): mpAccount(other.account()) {}
+
+    T *     allocate(size_t count) {
+        mpAccount->add(count * sizeof(T));
+        return std::allocator<T>().allocate(count);
+    }
+
+    void    deallocate(T * pointer, size_t count) {
+        mpAccount->sub(count * sizeof(T));
+        std::allocator<T>().deallocate(pointer, count);
+    }
+
+    MemoryAccount * account() const {
+        return mpAccount;
+    }
+
+    template<typename U>
+    bool    operator==(const CountingAllocator<U> & other) const {
+        return mpAccount == other.account();
+    }
+    template<typename U>
+    bool    operator!=(const CountingAllocator<U> & other) const {
+        return mpAccount != other.account();
+    }
+
+private:
+    MemoryAccount   *mpAccount;
+};
+
+// Registry of the accounts by structure name ("ThreadPool.queue", ...).
+// Accounts are made on first use and live until the process exits, so
+// structures torn down by static destructors can still give bytes back.
+class MemoryStats {
+public:
+    struct Usage {
+        std::string name;
+        size_t      current = 0;
+        size_t      peak    = 0;
+    };
+
+public:
+    static MemoryStats* getInstance() {
+        static MemoryStats * instance = new MemoryStats();
+        return instance;
+    }
+
+    // Callers keep the reference: the lookup takes a lock.
+    MemoryAccount & account(const std::string & name) {
+        std::lock_guard<std::mutex> lock(mLock);
+        auto & account = mAccounts[name];
+        if(!account) {
+            account.reset(new MemoryAccount(name));
+        }
+        return *account;
+    }
+
+    // Every account, in name order.
+    std::vector<Usage>  usage() {
+        std::lock_guard<std::mutex> lock(mLock);
+        std::vector<Usage> usage;
+        usage.reserve(mAccounts.size());
+        for(const auto & element : mAccounts) {
+            Usage entry;
+            entry.name    = element.first;
+            entry.current = element.second->current();
+            entry.peak    = element.second->peak();
+            usage.push_back(entry);
+        }
+        return usage;
+    }
+
+    void    resetPeaks() {
+        std::lock_guard<std::mutex> lock(mLock);
+        for(auto & element : mAccounts) {
+            element.second->resetPeak();
+        }
+    }
+
+    // One "name  current  peak" line per account, in KiB, for run summaries.
+    static std::string  format(const std::vector<Usage> & usage) {
+        std::string text;
+        char line[128];
+        for(const auto & entry : usage) {
+            std::snprintf(line, sizeof(line), "  %-28s %10.1f KiB  peak %10.1f KiB\n", entry.name.c_str(),
+                          entry.current / 1024.0, entry.peak / 1024.0);
+            text += line;
+        }
+        return text;
+    }
+
+    // Accounts as a JSON object: {"name":{"current":..,"peak":..},...}
+    static std::string  json(const std::vector<Usage> & usage) {
+        std::string text = "{";
+        char field[160];
+        for(const auto & entry : usage) {
+            std::snprintf(field, sizeof(field), "%s\"%s\":{\"current\":%zu,\"peak\":%zu}", text.size() > 1 ? "," : "",
+                          entry.name.c_str(), entry.current, entry.peak);
+            text += field;
+        }
+        return text + "}";
+    }
+
+private:
+    MemoryStats() = default;
+    MemoryStats(const MemoryStats &) = delete;
+    MemoryStats& operator=(const MemoryStats &) = delete;
+
+private:
+    std::mutex  mLock;
+    std::map<std::string, std::unique_ptr<MemoryAccount>>   mAccounts;
+};
+
+#endif
@@ -0,0 +1,550 @@
+#include <array>
+#include <cerrno>
+#include <csignal>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <climits>
+#include <iostream>
+
+#include <fcntl.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/uio.h>
+#include <sys/wait.h>
+#include <sys/prctl.h>
+#include <sys/ptrace.h>
+#include <sys/syscall.h>
+#include <linux/kcmp.h>
+#include <linux/audit.h>
+#include <linux/filter.h>
+#include <linux/seccomp.h>
+
+#include "PtraceTracer.h"
+#include "threadlog.h"
+
+#if defined(__x86_64__)
+#define NATIVE_ARCH AUDIT_ARCH_X86_64
+#elif defined(__aarch64__)
+#define NATIVE_ARCH AUDIT_ARCH_AARCH64
+#endif
+
+struct SyscallNumber {
+    long        nr;
+    SYSCALL     call;
+};
+
+// Architectures without the legacy calls (aarch64) simply lack their entries.
+static const SyscallNumber NUMBERS[] = {
+#ifdef SYS_open
+    {SYS_open,              SYSCALL::OPEN},
+#endif
+    {SYS_openat,            SYSCALL::OPENAT},
+#ifdef SYS_openat2
+    {SYS_openat2,           SYSCALL::OPENAT2},
+#endif
+#ifdef SYS_creat
+    {SYS_creat,             SYSCALL::CREAT},
+#endif
+    {SYS_close,             SYSCALL::CLOSE},
+#ifdef SYS_close_range
+    {SYS_close_range,       SYSCALL::CLOSE_RANGE},
+#endif
+    {SYS_dup,               SYSCALL::DUP},
+#ifdef SYS_dup2
+    {SYS_dup2,              SYSCALL::DUP2},
+#endif
+    {SYS_dup3,              SYSCALL::DUP3},
+    {SYS_fcntl,             SYSCALL::FCNTL},
+    {SYS_socket,            SYSCALL::SOCKET},
+    {SYS_socketpair,        SYSCALL::SOCKETPAIR},
+    {SYS_accept,            SYSCALL::ACCEPT},
+    {SYS_accept4,           SYSCALL::ACCEPT4},
+#ifdef SYS_pipe
+    {SYS_pipe,              SYSCALL::PIPE},
+#endif
+    {SYS_pipe2,             SYSCALL::PIPE2},
+#ifdef SYS_eventfd
+    {SYS_eventfd,           SYSCALL::EVENTFD},
+#endif
+    {SYS_eventfd2,          SYSCALL::EVENTFD2},
+#ifdef SYS_epoll_create
+    {SYS_epoll_create,      SYSCALL::EPOLL_CREATE},
+#endif
+    {SYS_epoll_create1,     SYSCALL::EPOLL_CREATE1},
+    {SYS_memfd_create,      SYSCALL::MEMFD_CREATE},
+    {SYS_timerfd_create,    SYSCALL::TIMERFD_CREATE},
+#ifdef SYS_signalfd
+    {SYS_signalfd,          SYSCALL::SIGNALFD},
+#endif
+    {SYS_signalfd4,         SYSCALL::SIGNALFD4},
+#ifdef SYS_inotify_init
+    {SYS_inotify_init,      SYSCALL::INOTIFY_INIT},
+#endif
+    {SYS_inotify_init1,     SYSCALL::INOTIFY_INIT1},
+};
+
+static const unsigned long TRACEOPTIONS = PTRACE_O_TRACESYSGOOD | PTRACE_O_TRACEFORK | PTRACE_O_TRACEVFORK
+                                        | PTRACE_O_TRACECLONE | PTRACE_O_TRACEEXEC;
+
+static void
+wakeUp(int) {
+}
+
+// RET_TRACE for the fd syscalls of the native ABI, RET_ALLOW for the rest.
+static std::vector<sock_filter>
+buildFilter() {
+    std::vector<sock_filter> filter;
+#ifdef NATIVE_ARCH
+    filter.push_back(BPF_STMT(BPF_LD | BPF_W | BPF_ABS, offsetof(struct seccomp_data, arch)));
+    filter.push_back(BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, NATIVE_ARCH, 1, 0));
+    filter.push_back(BPF_STMT(BPF_RET | BPF_K, SECCOMP_RET_ALLOW));
+    filter.push_back(BPF_STMT(BPF_LD | BPF_W | BPF_ABS, offsetof(struct seccomp_data, nr)));
+    for(const auto & number : NUMBERS) {
+        filter.push_back(BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, static_cast<uint32_t>(number.nr), 0, 1));
+        filter.push_back(BPF_STMT(BPF_RET | BPF_K, SECCOMP_RET_TRACE));
+    }
+    filter.push_back(BPF_STMT(BPF_RET | BPF_K, SECCOMP_RET_ALLOW));
+#endif
+    return filter;
+}
+
+/******************* public function ********************************/
+PtraceTracer::PtraceTracer(
+) : mLeader(-1)
+  , mLaunched(false)
+  , mSeccomp(false)
+  , mThread(pthread_self())
+  , mStop(false)
+  , mExitStatus(-1)
+  , mStops(0)
+  , mCalls(0) {
+}
+
+PtraceTracer::~PtraceTracer() {
+    if(!mTasks.empty()) {
+        detachAll();
+    }
+}
+
+bool
+PtraceTracer::launch(
+    const std::vector<std::string> &    argv
+) {
+    if(argv.empty()) {
+        return false;
+    }
+    // everything the child needs is built before fork()
+    std::vector<char *> args;
+    for(const auto & arg : argv) {
+        args.push_back(const_cast<char *>(arg.c_str()));
+    }
+    args.push_back(nullptr);
+    std::vector<sock_filter> filter = buildFilter();
+    struct sock_fprog program;
+    program.len    = static_cast<unsigned short>(filter.size());
+    program.filter = filter.data();
+
+    pid_t child = fork();
+    if(child < 0) {
+        std::cerr<<"fork: "<<std::strerror(errno)<<std::endl;
+        return false;
+    }
+    if(child == 0) {
+        ptrace(PTRACE_TRACEME, 0, nullptr, nullptr);
+        raise(SIGSTOP);
+        if(!filter.empty()) {
+            prctl(PR_SET_NO_NEW_PRIVS, 1, 0, 0, 0);
+            prctl(PR_SET_SECCOMP, SECCOMP_MODE_FILTER, &program);
+        }
+        execvp(args[0], args.data());
+        _exit(127);
+    }
+
+    int status = 0;
+    if(waitpid(child, &status, __WALL) != child || !WIFSTOPPED(status)) {
+        std::cerr<<argv[0]<<" could not be started"<<std::endl;
+        return false;
+    }
+    unsigned long options = TRACEOPTIONS | PTRACE_O_EXITKILL;
+    if(!filter.empty()) {
+        options |= PTRACE_O_TRACESECCOMP;
+    }
+    if(ptrace(PTRACE_SETOPTIONS, child, nullptr, options) != 0) {
+        std::cerr<<"ptrace: "<<std::strerror(errno)<<std::endl;
+        kill(child, SIGKILL);
+        waitpid(child, &status, __WALL);
+        return false;
+    }
+    mThread   = pthread_self();
+    mLeader   = child;
+    mLaunched = true;
+    mSeccomp  = !filter.empty();
+    mTasks[child].started = true;
+    mTasks[child].known   = true;
+    DEG_LOG("launched %s as %d, seccomp %d", argv[0].c_str(), child, mSeccomp);
+    return true;
+}
+
+bool
+PtraceTracer::attach(
+    pid_t   pid
+) {
+    mThread  = pthread_self();
+    mLeader  = pid;
+    mSeccomp = false;
+    // threads started while we seize the others show up in the next round
+    std::string directory = "/proc/" + std::to_string(pid) + "/task";
+    for(bool found = true; found;) {
+        found = false;
+        DIR *dir = opendir(directory.c_str());
+        if(!dir) {
+            std::cerr<<pid<<" does not exist!"<<std::endl;
+            break;
+        }
+        while(struct dirent *entry = readdir(dir)) {
+            pid_t tid = static_cast<pid_t>(std::strtol(entry->d_name, nullptr, 10));
+            if(tid <= 0 || mTasks.count(tid)) {
+                continue;
+            }
+            if(ptrace(PTRACE_SEIZE, tid, nullptr, TRACEOPTIONS) != 0) {
+                std::cerr<<"can not attach to "<<tid<<": "<<std::strerror(errno)<<std::endl;
+                continue;
+            }
+            ptrace(PTRACE_INTERRUPT, tid, nullptr, nullptr);
+            mTasks[tid].known = true;
+            found = true;
+        }
+        closedir(dir);
+    }
+    DEG_LOG("attached to %d, %zu threads", pid, mTasks.size());
+    return !mTasks.empty();
+}
+
+void
+PtraceTracer::run(
+    const Sink &    sink
+) {
+    struct sigaction action, saved;
+    std::memset(&action, 0, sizeof(action));
+    action.sa_handler = wakeUp;         // no SA_RESTART: stop() interrupts waitpid()
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGURG, &action, &saved);
+
+    if(mLaunched && mTasks.count(mLeader)) {
+        resume(mLeader, mTasks[mLeader], 0);
+    }
+    while(!mTasks.empty()) {
+        if(mStop) {
+            detachAll();
+            break;
+        }
+        int   status = 0;
+        pid_t tid    = waitpid(-1, &status, __WALL);
+        if(tid < 0) {
+            if(errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+        ++mStops;
+        if(WIFEXITED(status) || WIFSIGNALED(status)) {
+            // what strace prints as "+++ exited with N +++"
+            FdCall gone;
+            gone.pid    = tid;
+            gone.usec   = SyscallLine::nowMicros();
+            gone.call   = SYSCALL::EXITED;
+            gone.offset = mCalls++;
+            sink(std::move(gone));
+            mTasks.erase(tid);
+            if(mLaunched && tid == mLeader) {
+                mExitStatus = WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+            }
+            continue;
+        }
+        if(!WIFSTOPPED(status)) {
+            continue;
+        }
+
+        // a new task may report before its parent's clone event
+        Task &  task   = mTasks[tid];
+        int     signal = WSTOPSIG(status);
+        int     event  = status >> 16;
+        if(signal == (SIGTRAP | 0x80) || event == PTRACE_EVENT_SECCOMP) {
+            task.started = true;
+            onSyscall(tid, task, sink);
+            resume(tid, task, 0);
+        } else if(event == PTRACE_EVENT_STOP) {
+            bool groupStop = signal == SIGSTOP || signal == SIGTSTP || signal == SIGTTIN || signal == SIGTTOU;
+            if(task.started && groupStop) {
+                ptrace(PTRACE_LISTEN, tid, nullptr, nullptr);
+            } else {
+                start(tid, task);
+            }
+        } else if(event != 0) {
+            unsigned long message = 0;
+            ptrace(PTRACE_GETEVENTMSG, tid, nullptr, &message);
+            if(event == PTRACE_EVENT_FORK || event == PTRACE_EVENT_VFORK || event == PTRACE_EVENT_CLONE) {
+                onSpawn(tid, static_cast<pid_t>(message), event, sink);
+            } else if(event == PTRACE_EVENT_EXEC && static_cast<pid_t>(message) != tid) {
+                // a thread that called execve takes over the leader's tid
+                mTasks.erase(static_cast<pid_t>(message));
+            }
+            resume(tid, task, 0);
+        } else if(!task.started && signal == SIGSTOP) {
+            start(tid, task);
+        } else {
+            resume(tid, task, signal);
+        }
+    }
+    sigaction(SIGURG, &saved, nullptr);
+    DEG_LOG("tracing ended: %llu stops, %llu fd calls", static_cast<unsigned long long>(mStops),
+            static_cast<unsigned long long>(mCalls));
+}
+
+void
+PtraceTracer::stop() {
+    mStop = true;
+    pthread_kill(mThread, SIGURG);
+}
+
+/******************* private function ********************************/
+void
+PtraceTracer::start(
+    pid_t   tid,
+    Task &  task
+) {
+    if(!task.known) {
+        // a new task that reports before its parent's clone event waits
+        // for it, so the spawn reaches the sink before the child's calls
+        task.held = true;
+        return ;
+    }
+    task.started = true;
+    resume(tid, task, 0);
+}
+
+void
+PtraceTracer::onSpawn(
+    pid_t           tid,
+    pid_t           child,
+    int             event,
+    const Sink &    sink
+) {
+    FdCall out;
+    out.pid    = tid;
+    out.usec   = SyscallLine::nowMicros();
+    out.call   = event == PTRACE_EVENT_FORK ? SYSCALL::FORK
+               : event == PTRACE_EVENT_VFORK ? SYSCALL::VFORK : SYSCALL::CLONE;
+    out.ret    = child;
+    out.hasRet = true;
+    // kcmp tells whether both use one files_struct; without it, guess that
+    // a clone that is no fork is a thread
+    long same = syscall(SYS_kcmp, tid, child, KCMP_FILES, 0, 0);
+    out.shareFiles = same < 0 ? event == PTRACE_EVENT_CLONE : same == 0;
+    out.offset = mCalls++;
+    sink(std::move(out));
+
+    Task & task = mTasks[child];
+    task.known = true;
+    if(task.held) {
+        task.held = false;
+        start(child, task);
+    }
+}
+
+void
+PtraceTracer::onSyscall(
+    pid_t           tid,
+    Task &          task,
+    const Sink &    sink
+) {
+    struct __ptrace_syscall_info info;
+    if(ptrace(PTRACE_GET_SYSCALL_INFO, tid, sizeof(info), &info) <= 0) {
+        return ;
+    }
+
+    if(info.op == PTRACE_SYSCALL_INFO_ENTRY || info.op == PTRACE_SYSCALL_INFO_SECCOMP) {
+        bool        seccomp = info.op == PTRACE_SYSCALL_INFO_SECCOMP;
+        uint64_t    nr      = seccomp ? info.seccomp.nr : info.entry.nr;
+        const auto  & args  = seccomp ? info.seccomp.args : info.entry.args;
+        SYSCALL     call    = SYSCALL::UNKNOWN;
+#ifdef NATIVE_ARCH
+        if(info.arch == NATIVE_ARCH) {
+            call = classify(static_cast<long>(nr));
+        }
+#endif
+        task.inCall = call != SYSCALL::UNKNOWN;
+        if(!task.inCall) {
+            return ;
+        }
+
+        // the same fields FdCall::fromLine() fills from an strace line
+        FdCall & out = task.call;
+        out = FdCall();
+        out.pid  = tid;
+        out.call = call;
+        out.usec = SyscallLine::nowMicros();    // entry, for the duration
+        switch(call) {
+        case SYSCALL::OPEN:
+        case SYSCALL::CREAT:
+            out.detail = readPath(tid, args[0]);
+            break;
+        case SYSCALL::OPENAT:
+        case SYSCALL::OPENAT2:
+            out.detail = readPath(tid, args[1]);
+            break;
+        case SYSCALL::PIPE:
+        case SYSCALL::PIPE2:
+            out.arg0 = static_cast<long>(args[0]);      // the int[2] read on exit
+            break;
+        case SYSCALL::SOCKETPAIR:
+            out.arg0 = static_cast<long>(args[3]);
+            break;
+        case SYSCALL::FCNTL:
+            out.dupCmd = args[1] == F_DUPFD || args[1] == F_DUPFD_CLOEXEC;
+            out.arg0   = static_cast<int>(args[0]);
+            break;
+        case SYSCALL::CLOSE_RANGE:
+            out.arg0 = static_cast<unsigned int>(args[0]);
+            out.arg1 = static_cast<unsigned int>(args[1]) == UINT_MAX ? LONG_MAX
+                     : static_cast<long>(static_cast<unsigned int>(args[1]));
+            break;
+        default:
+            out.arg0 = static_cast<int>(args[0]);
+            out.arg1 = static_cast<int>(args[1]);
+            break;
+        }
+        return ;
+    }
+
+    if(info.op != PTRACE_SYSCALL_INFO_EXIT || !task.inCall) {
+        return ;
+    }
+    task.inCall = false;
+    FdCall & out = task.call;
+    long long entry = out.usec;
+    out.usec   = SyscallLine::nowMicros();
+    // entry to exit stop, as strace -T measures it: tracer overhead included
+    out.duration = out.usec >= entry ? out.usec - entry : -1;
+    out.ret    = static_cast<long>(info.exit.rval);
+    out.hasRet = true;
+    out.ebadf  = info.exit.is_error && info.exit.rval == -EBADF;
+    if(out.call == SYSCALL::PIPE || out.call == SYSCALL::PIPE2 || out.call == SYSCALL::SOCKETPAIR) {
+        int pair[2] = {-1, -1};
+        uint64_t address = static_cast<uint64_t>(out.arg0);
+        out.arg0 = -1;
+        if(!info.exit.is_error && readMemory(tid, address, pair, sizeof(pair))) {
+            out.pair0 = pair[0];
+            out.pair1 = pair[1];
+        }
+    }
+    out.offset = mCalls++;
+    sink(std::move(out));
+}
+
+void
+PtraceTracer::resume(
+    pid_t           tid,
+    const Task &    task,
+    int             signal
+) {
+    // with the filter only the exit of a stopped fd syscall needs a stop
+    auto request = !mSeccomp || task.inCall ? PTRACE_SYSCALL : PTRACE_CONT;
+    ptrace(request, tid, nullptr, reinterpret_cast<void *>(static_cast<long>(signal)));
+}
+
+void
+PtraceTracer::detachAll() {
+    if(mLaunched) {
+        for(const auto & element : mTasks) {
+            kill(element.first, SIGKILL);
+        }
+    } else {
+        for(auto it = mTasks.begin(); it != mTasks.end();) {
+            if(it->second.held) {
+                // already stopped: no further stop would be reported
+                ptrace(PTRACE_DETACH, it->first, nullptr, nullptr);
+                it = mTasks.erase(it);
+                continue;
+            }
+            ptrace(PTRACE_INTERRUPT, it->first, nullptr, nullptr);
+            ++it;
+        }
+    }
+    while(!mTasks.empty()) {
+        int   status = 0;
+        pid_t tid    = waitpid(-1, &status, __WALL);
+        if(tid < 0) {
+            if(errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+        if(WIFSTOPPED(status) && !mLaunched) {
+            // pass on a signal that was about to be delivered
+            int signal = WSTOPSIG(status);
+            bool pending = (status >> 16) == 0 && signal != SIGTRAP && signal != (SIGTRAP | 0x80);
+            ptrace(PTRACE_DETACH, tid, nullptr, reinterpret_cast<void *>(static_cast<long>(pending ? signal : 0)));
+        } else if(WIFSTOPPED(status)) {
+            continue;
+        }
+        mTasks.erase(tid);
+    }
+    mTasks.clear();
+}
+
+SYSCALL
+PtraceTracer::classify(
+    long    nr
+) {
+    static const auto table = [](){
+        std::array<SYSCALL, 1024> calls;
+        calls.fill(SYSCALL::UNKNOWN);
+        for(const auto & number : NUMBERS) {
+            if(number.nr >= 0 && static_cast<size_t>(number.nr) < calls.size()) {
+                calls[number.nr] = number.call;
+            }
+        }
+        return calls;
+    }();
+    return nr >= 0 && static_cast<size_t>(nr) < table.size() ? table[nr] : SYSCALL::UNKNOWN;
+}
+
+bool
+PtraceTracer::readMemory(
+    pid_t       tid,
+    uint64_t    address,
+    void *      buffer,
+    size_t      length
+) {
+    struct iovec local  = {buffer, length};
+    struct iovec remote = {reinterpret_cast<void *>(address), length};
+    return process_vm_readv(tid, &local, 1, &remote, 1, 0) == static_cast<ssize_t>(length);
+}
+
+std::string
+PtraceTracer::readPath(
+    pid_t       tid,
+    uint64_t    address
+) {
+    // page by page: the string may end just before an unmapped page
+    static const size_t PAGE = 4096;
+    std::string path;
+    char        buffer[PAGE];
+    while(address && path.size() < PATH_MAX) {
+        size_t length = PAGE - address % PAGE;
+        if(!readMemory(tid, address, buffer, length)) {
+            break;
+        }
+        const char * end = static_cast<const char *>(memchr(buffer, '\0', length));
+        if(end) {
+            path.append(buffer, static_cast<size_t>(end - buffer));
+            break;
+        }
+        path.append(buffer, length);
+        address += length;
+    }
+    return path;
+}
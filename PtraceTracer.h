@@ -0,0 +1,95 @@
+#ifndef _PTRACETRACER_H_
+#define _PTRACETRACER_H_
+
+#include <string>
+#include <vector>
+#include <atomic>
+#include <functional>
+#include <unordered_map>
+
+#include <pthread.h>
+#include <sys/types.h>
+
+#include "FdEvent.h"
+
+// Native tracer: follows a process and its forks and clones with ptrace and
+// hands every completed fd-table syscall to a sink as an FdCall, the same
+// record FdCall::fromLine() makes of an strace line. Nothing is formatted,
+// written or parsed on the way. Forks and clones reach the sink as
+// FORK/VFORK/CLONE calls returning the child, ahead of any of its calls.
+//
+// A launched command gets a seccomp filter that stops it only on the fd
+// syscalls of SyscallTable, so every other syscall runs at full speed. An
+// attached process can not be given a filter; it stops on every syscall
+// and the tracer skips the ones that do not matter.
+//
+// Arguments come from PTRACE_GET_SYSCALL_INFO (Linux 5.3), paths and fd
+// pairs from process_vm_readv. Times are local time of day in
+// microseconds, as strace -tt prints them.
+class PtraceTracer {
+public:
+    using Sink = std::function<void(FdCall &&)>;
+
+public:
+    PtraceTracer();
+    ~PtraceTracer();
+    PtraceTracer(const PtraceTracer &) = delete;
+    PtraceTracer& operator=(const PtraceTracer &) = delete;
+
+    // Starts `argv` (searched in PATH) traced; it runs once run() is called.
+    bool    launch(const std::vector<std::string> & argv);
+    // Seizes every thread of running process `pid`.
+    bool    attach(pid_t pid);
+
+    // Traces until every task is gone or stop() is called, calling `sink`
+    // on this thread in completion order. All ptrace requests come from
+    // the thread that called launch()/attach() and run().
+    void    run(const Sink & sink);
+    // Callable from any thread or a signal handler. An attached process is
+    // detached and keeps running; a launched one is killed, since its
+    // filter needs a tracer.
+    void    stop();
+
+    // exit status of a launched command, -1 until it exited
+    int     exitStatus() const {
+        return mExitStatus;
+    }
+    uint64_t    stops() const {
+        return mStops;
+    }
+    uint64_t    calls() const {
+        return mCalls;
+    }
+
+private:
+    struct Task {
+        bool        started = false;    // past its first stop
+        bool        inCall  = false;    // between entry and exit of an fd syscall
+        bool        known   = false;    // attached, launched or reported by its parent
+        bool        held    = false;    // first stop came before the parent's event
+        FdCall      call;
+    };
+
+    void    start(pid_t tid, Task & task);
+    void    onSpawn(pid_t tid, pid_t child, int event, const Sink & sink);
+    void    onSyscall(pid_t tid, Task & task, const Sink & sink);
+    void    resume(pid_t tid, const Task & task, int signal);
+    void    detachAll();
+
+    static SYSCALL  classify(long nr);
+    static bool     readMemory(pid_t tid, uint64_t address, void * buffer, size_t length);
+    static std::string  readPath(pid_t tid, uint64_t address);
+
+private:
+    std::unordered_map<pid_t, Task>     mTasks;
+    pid_t               mLeader;
+    bool                mLaunched;
+    bool                mSeccomp;       // tasks stop on fd syscalls only
+    pthread_t           mThread;        // the tracing thread, woken by stop()
+    std::atomic<bool>   mStop;
+    int                 mExitStatus;
+    uint64_t            mStops;
+    uint64_t            mCalls;
+};
+
+#endif
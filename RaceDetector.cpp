@@ -0,0 +1,222 @@
+#include "RaceDetector.h"
+#include "Checkpoint.h"
+
+/******************* public function ********************************/
+RaceDetector::RaceDetector(
+    size_t  keep
+) : mKeep(keep) {
+    mCounts.fill(0);
+}
+
+void
+RaceDetector::open(
+    uint32_t        table,
+    long            fd,
+    const FdEvent & event
+) {
+    bool inserted = false;
+    State & state = this->state(table, fd, inserted);
+    // dup2/dup3 onto a live fd closes it first
+    state.generation += state.open ? 2 : 1;
+    state.open = true;
+    state.last = stepOf(event);
+}
+
+void
+RaceDetector::close(
+    uint32_t        table,
+    pid_t           pid,
+    long            fd,
+    const FdEvent & event,
+    bool            report
+) {
+    bool inserted = false;
+    State & state = this->state(table, fd, inserted);
+    if(inserted) {
+        // opened before the trace, or inherited
+        state.generation = 1;
+        state.last = stepOf(event);
+        return ;
+    }
+    if(state.open) {
+        if(report && state.last.tid != event.pid) {
+            found(RACE::FOREIGNCLOSE, pid, fd, state, event);
+        }
+        ++state.generation;
+    } else {
+        // the kernel closed something: an open the trace does not show
+        state.generation += 2;
+    }
+    state.open = false;
+    state.last = stepOf(event);
+}
+
+void
+RaceDetector::badFd(
+    uint32_t        table,
+    pid_t           pid,
+    const FdEvent & event,
+    bool            report
+) {
+    auto it = mStates.find(key(table, event.fd));
+    // open: a close the trace missed; unknown: nothing to compare with
+    if(it == mStates.end() || it->second.open || !report) {
+        return ;
+    }
+    bool closing = event.call == SYSCALL::CLOSE || event.call == SYSCALL::CLOSE_RANGE;
+    found(closing ? RACE::DOUBLECLOSE : RACE::STALEUSE, pid, event.fd, it->second, event);
+}
+
+void
+RaceDetector::drop(
+    uint32_t    table
+) {
+    auto it = mFds.find(table);
+    if(it == mFds.end()) {
+        return ;
+    }
+    for(long fd : it->second) {
+        mStates.erase(key(table, fd));
+    }
+    mFds.erase(it);
+}
+
+void
+RaceDetector::clear() {
+    std::unordered_map<uint64_t, State>().swap(mStates);
+    std::unordered_map<uint32_t, std::vector<long>>().swap(mFds);
+    std::vector<Race>().swap(mRaces);
+    mCounts.fill(0);
+}
+
+void
+RaceDetector::put(
+    CheckpointWriter &  out
+) const {
+    out.putU64(mStates.size());
+    for(const auto & element : mStates) {
+        out.putU64(element.first);
+        out.putU32(element.second.generation);
+        out.putU8(element.second.open);
+        out.putI64(element.second.last.tid);
+        out.putU8(static_cast<uint8_t>(element.second.last.call));
+        out.putI64(element.second.last.usec);
+        out.putU64(element.second.last.offset);
+    }
+    out.putU64(mRaces.size());
+    for(const auto & race : mRaces) {
+        putRace(out, race);
+    }
+    for(size_t count : mCounts) {
+        out.putU64(count);
+    }
+}
+
+bool
+RaceDetector::get(
+    CheckpointReader &  in
+) {
+    clear();
+    for(uint64_t states = in.getU64(); in.ok() && states > 0; --states) {
+        uint64_t element = in.getU64();
+        bool inserted = false;
+        State & state = this->state(static_cast<uint32_t>(element >> 32), static_cast<int32_t>(element), inserted);
+        state.generation  = in.getU32();
+        state.open        = in.getU8();
+        state.last.tid    = static_cast<pid_t>(in.getI64());
+        state.last.call   = static_cast<SYSCALL>(in.getU8());
+        state.last.usec   = in.getI64();
+        state.last.offset = in.getU64();
+    }
+    for(uint64_t races = in.getU64(); in.ok() && races > 0; --races) {
+        mRaces.push_back(getRace(in));
+    }
+    for(size_t & count : mCounts) {
+        count = in.getU64();
+    }
+    return in.ok();
+}
+
+void
+RaceDetector::putRace(
+    CheckpointWriter &  out,
+    const Race &        race
+) {
+    out.putU8(static_cast<uint8_t>(race.kind));
+    out.putI64(race.pid);
+    out.putI64(race.fd);
+    out.putU32(race.generation);
+    for(const Step * step : {&race.first, &race.second}) {
+        out.putI64(step->tid);
+        out.putU8(static_cast<uint8_t>(step->call));
+        out.putI64(step->usec);
+        out.putU64(step->offset);
+    }
+}
+
+RaceDetector::Race
+RaceDetector::getRace(
+    CheckpointReader &  in
+) {
+    Race race;
+    race.kind       = static_cast<RACE>(in.getU8());
+    race.pid        = static_cast<pid_t>(in.getI64());
+    race.fd         = static_cast<long>(in.getI64());
+    race.generation = in.getU32();
+    for(Step * step : {&race.first, &race.second}) {
+        step->tid    = static_cast<pid_t>(in.getI64());
+        step->call   = static_cast<SYSCALL>(in.getU8());
+        step->usec   = in.getI64();
+        step->offset = in.getU64();
+    }
+    return race;
+}
+
+/******************* private function ********************************/
+RaceDetector::State &
+RaceDetector::state(
+    uint32_t    table,
+    long        fd,
+    bool &      inserted
+) {
+    auto element = mStates.try_emplace(key(table, fd));
+    inserted = element.second;
+    if(inserted) {
+        mFds[table].push_back(fd);
+    }
+    return element.first->second;
+}
+
+RaceDetector::Step
+RaceDetector::stepOf(
+    const FdEvent & event
+) {
+    Step step;
+    step.tid    = event.pid;
+    step.call   = event.call;
+    step.usec   = event.usec;
+    step.offset = event.offset;
+    return step;
+}
+
+void
+RaceDetector::found(
+    RACE            kind,
+    pid_t           pid,
+    long            fd,
+    const State &   state,
+    const FdEvent & event
+) {
+    ++mCounts[static_cast<size_t>(kind)];
+    if(mRaces.size() >= mKeep) {
+        return ;
+    }
+    Race race;
+    race.kind       = kind;
+    race.pid        = pid;
+    race.fd         = fd;
+    race.generation = state.generation;
+    race.first      = state.last;
+    race.second     = stepOf(event);
+    mRaces.push_back(race);
+}
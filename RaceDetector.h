@@ -0,0 +1,109 @@
+#ifndef _RACEDETECTOR_H_
+#define _RACEDETECTOR_H_
+
+#include <array>
+#include <vector>
+#include <cstdint>
+#include <unordered_map>
+
+#include <sys/types.h>
+
+#include "FdEvent.h"
+
+class CheckpointWriter;
+class CheckpointReader;
+
+enum class RACE : uint8_t {
+    DOUBLECLOSE     = 0,    // close of an fd the trace saw closed, nothing opened it since
+    FOREIGNCLOSE    = 1,    // close by another thread than the one that opened it
+    STALEUSE        = 2,    // EBADF of another call on an fd the trace saw closed
+    COUNT
+};
+
+// Streaming detector of fd misuse between threads, fed by the ordered apply
+// stage of DescriptorMatch. Every fd number of every fd table keeps a
+// generation, bumped on each open and close, and the last event that
+// changed it: its opener while open, its closer once closed. Each event is
+// one hash lookup; nothing is kept per event and there is no second pass.
+//
+// A finding carries both events: the one the fd's state came from and the
+// one that contradicts it. Numbers the trace never saw open or closed
+// (inherited, opened before the trace) tell nothing and are skipped.
+class RaceDetector {
+public:
+    struct Step {
+        pid_t       tid     = -1;
+        SYSCALL     call    = SYSCALL::UNKNOWN;
+        long long   usec    = -1;
+        uint64_t    offset  = 0;
+    };
+
+    struct Race {
+        RACE        kind        = RACE::DOUBLECLOSE;
+        pid_t       pid         = -1;   // task the fd table was made for
+        long        fd          = -1;
+        uint32_t    generation  = 0;    // of the fd when `second` happened
+        Step        first;              // last open or close before
+        Step        second;             // the contradicting call
+    };
+
+    using Counts = std::array<size_t, static_cast<size_t>(RACE::COUNT)>;
+
+public:
+    // Findings beyond `keep` are only counted.
+    explicit RaceDetector(size_t keep = RACELEN);
+
+    // fd `fd` of table `table` opened or closed by `event`; badFd() takes
+    // an EBADF of event.fd. `pid` is the task the table was made for, and
+    // `report` false updates the state without keeping findings.
+    void    open(uint32_t table, long fd, const FdEvent & event);
+    void    close(uint32_t table, pid_t pid, long fd, const FdEvent & event, bool report);
+    void    badFd(uint32_t table, pid_t pid, const FdEvent & event, bool report);
+
+    const std::vector<Race> &   races() const {
+        return mRaces;
+    }
+    const Counts &  counts() const {
+        return mCounts;
+    }
+
+    // Forgets every fd of a table that went away, before its id is reused.
+    void    drop(uint32_t table);
+    void    clear();
+
+    static const char * name(RACE kind) {
+        static const char * const NAMES[] = {"double close", "foreign close", "stale use"};
+        return kind < RACE::COUNT ? NAMES[static_cast<size_t>(kind)] : "unknown";
+    }
+
+    // Snapshot coding, shared by checkpoints and DaemonProtocol.
+    void        put(CheckpointWriter & out) const;
+    bool        get(CheckpointReader & in);
+    static void putRace(CheckpointWriter & out, const Race & race);
+    static Race getRace(CheckpointReader & in);
+
+private:
+    struct State {
+        uint32_t    generation  = 0;
+        bool        open        = false;
+        Step        last;
+    };
+
+    static uint64_t key(uint32_t table, long fd) {
+        return static_cast<uint64_t>(table) << 32 | static_cast<uint32_t>(fd);
+    }
+    static Step     stepOf(const FdEvent & event);
+    State & state(uint32_t table, long fd, bool & inserted);
+    void    found(RACE kind, pid_t pid, long fd, const State & state, const FdEvent & event);
+
+private:
+    static constexpr size_t RACELEN = 1024;
+
+    std::unordered_map<uint64_t, State> mStates;
+    std::unordered_map<uint32_t, std::vector<long>> mFds;  // fds with a state, per table
+    std::vector<Race>   mRaces;
+    Counts              mCounts;
+    size_t              mKeep;
+};
+
+#endif
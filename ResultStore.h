@@ -0,0 +1,50 @@
+#ifndef _RESULTSTORE_H_
+#define _RESULTSTORE_H_
+
+#include <memory>
+#include <vector>
+
+#include <sys/types.h>
+
+#include "util.h"
+#include "MemoryStats.h"
+
+// One recorded status of a bad fd.
+struct ResultRow {
+    long long   usec    = -1;       // time of day, -1 when untimed
+    pid_t       pid     = -1;
+    fd_t        fd      = -1;
+    FDSTATUS    status  = FDSTATUS::NONE;
+    long long   incident = -1;      // time of the EBADF the row leads up to
+};
+
+// Flat result table of the EBADF pass, rows grouped by ascending fd and then
+// by incident: every EBADF on the fd, in time order, is its PRINTLEN
+// preceding events followed by a BADFD row. Published once by the engine
+// and then only read, so views share it through ResultHandle instead of
+// copying it.
+class ResultStore {
+public:
+    std::vector<ResultRow>  rows;
+    size_t                  badFds = 0;
+    size_t                  incidents = 0;  // EBADF calls over all bad fds
+    bool                    partial = false;    // triage stopped at the first incidents
+    MemoryCharge            memory = MemoryCharge(MemoryStats::getInstance()->account("ResultStore.rows"));
+
+    size_t  size() const {
+        return rows.size();
+    }
+
+    const ResultRow &   operator[](size_t indx) const {
+        return rows[indx];
+    }
+
+    // Charges the rows to ResultStore.rows once they are filled in.
+    void    account() {
+        memory.set(rows.capacity() * sizeof(ResultRow));
+    }
+};
+
+using ResultHandle = std::shared_ptr<const ResultStore>;
+
+#endif
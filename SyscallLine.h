@@ -0,0 +1,367 @@
+#ifndef _SYSCALLLINE_H_
+#define _SYSCALLLINE_H_
+
+#include <cstdint>
+#include <climits>
+#include <ctime>
+#include <string_view>
+
+#include <sys/types.h>
+
+#include "SyscallTable.h"
+
+enum class PHASE : uint8_t {
+    WHOLE       = 0,    // name(args) = ret
+    UNFINISH    = 1,    // name(args <unfinished ...>
+    RESUME      = 2     // <... name resumed>args) = ret
+};
+
+// One strace line split into its fields, without copying.
+// All views point into the line passed to parse() and die with it.
+class SyscallLine {
+public:
+    pid_t               pid     = -1;
+    std::string_view    time;
+    std::string_view    name;
+    SYSCALL             call    = SYSCALL::UNKNOWN;
+    PHASE               phase   = PHASE::WHOLE;
+    std::string_view    args;
+    long                ret     = 0;
+    bool                hasRet  = false;
+    std::string_view    error;
+    long long           duration = -1;  // strace -T "<0.000123>", microseconds; -1 without
+
+public:
+    // Pulls only the syscall name out of `line` and looks it up.
+    static SYSCALL
+    extract(std::string_view line) {
+        SyscallLine sc;
+        size_t pos = sc.header(line);
+        if(pos == std::string_view::npos) {
+            return SYSCALL::UNKNOWN;
+        }
+        return SyscallTable::lookup(sc.name);
+    }
+
+    // Reads pid and time of a "+++ exited with N +++" or "+++ killed by
+    // SIG +++" notice into a call EXITED. False for every other line.
+    bool
+    parseExit(std::string_view line) {
+        std::string_view tail = trimRight(line);
+        if(tail.size() < 3 || tail.substr(tail.size() - 3) != "+++") {
+            return false;
+        }
+        *this = SyscallLine();
+        size_t pos = prefix(line);
+        std::string_view rest = pos == std::string_view::npos ? std::string_view() : line.substr(pos);
+        if(rest.substr(0, 16) != "+++ exited with " && rest.substr(0, 14) != "+++ killed by ") {
+            return false;
+        }
+        call = SYSCALL::EXITED;
+        name = SyscallTable::name(call);
+        return true;
+    }
+
+    // Splits `line` into every field. Returns false for lines that are no
+    // syscall at all (signals, exit notices, garbage).
+    bool
+    parse(std::string_view line) {
+        *this = SyscallLine();
+        size_t pos = header(line);
+        if(pos == std::string_view::npos) {
+            return false;
+        }
+        call = SyscallTable::lookup(name);
+
+        std::string_view rest = line.substr(pos);
+        std::string_view tail = trimRight(rest);
+        static constexpr std::string_view Unfinished("<unfinished ...>");
+        if(tail.size() >= Unfinished.size()
+           && tail.substr(tail.size() - Unfinished.size()) == Unfinished) {
+            phase = PHASE::UNFINISH;
+            args  = trimRight(tail.substr(0, tail.size() - Unfinished.size()));
+            return true;
+        }
+
+        size_t equal = rest.rfind(") = ");
+        if(equal == std::string_view::npos) {
+            args = rest;
+            return true;
+        }
+        args = rest.substr(0, equal);
+        parseReturn(rest.substr(equal + 4));
+        // -T puts the time spent in the call last; one byte compare without it
+        if(!tail.empty() && tail.back() == '>' && tail.size() > equal + 4) {
+            size_t open = tail.rfind('<');
+            if(open != std::string_view::npos && open > equal) {
+                duration = toMicros(tail.substr(open + 1, tail.size() - open - 2));
+            }
+        }
+        return true;
+    }
+
+    bool    failed() const {
+        return hasRet && ret < 0;
+    }
+
+    // The index-th top level argument, trimmed.
+    std::string_view
+    arg(size_t index) const {
+        int     depth = 0;
+        bool    quote = false;
+        size_t  begin = 0;
+        size_t  count = 0;
+        for(size_t pos = 0; pos <= args.size(); ++pos) {
+            char ch = pos < args.size() ? args[pos] : ',';
+            if(quote) {
+                if(ch == '\\') {
+                    ++pos;
+                } else if(ch == '"') {
+                    quote = false;
+                }
+                continue;
+            }
+            if(ch == '"') {
+                quote = true;
+            } else if(ch == '{' || ch == '[' || ch == '(') {
+                ++depth;
+            } else if(ch == '}' || ch == ']' || ch == ')') {
+                --depth;
+            } else if(ch == ',' && depth <= 0) {
+                if(count == index) {
+                    return trim(args.substr(begin, pos - begin));
+                }
+                ++count;
+                begin = pos + 1;
+            }
+        }
+        return std::string_view();
+    }
+
+    // Integer value of the index-th argument; `fallback` when it is symbolic.
+    long
+    intArg(size_t index, long fallback = -1) const {
+        return toLong(arg(index), fallback);
+    }
+
+    // Both fds of a "[3, 4]" array argument (pipe, pipe2, socketpair).
+    bool
+    fdPair(size_t index, long & first, long & second) const {
+        std::string_view value = arg(index);
+        if(value.size() < 2 || value.front() != '[') {
+            return false;
+        }
+        value = value.substr(1);
+        size_t comma = value.find(',');
+        if(comma == std::string_view::npos) {
+            return false;
+        }
+        first  = toLong(trim(value.substr(0, comma)), -1);
+        second = toLong(trim(value.substr(comma + 1)), -1);
+        return first >= 0 && second >= 0;
+    }
+
+    // "HH:MM:SS.uuuuuu" (-tt) or "seconds.uuuuuu" (-ttt) in microseconds, -1 if untimed.
+    static long long
+    toMicros(std::string_view text) {
+        long long   seconds = 0;
+        long long   field   = 0;
+        size_t      pos     = 0;
+        for(; pos < text.size() && text[pos] != '.'; ++pos) {
+            char ch = text[pos];
+            if(ch == ':') {
+                seconds = seconds * 60 + field;
+                field   = 0;
+            } else if(ch >= '0' && ch <= '9') {
+                field = field * 10 + (ch - '0');
+            } else {
+                return -1;
+            }
+        }
+        if(pos == 0) {
+            return -1;
+        }
+        seconds = seconds * 60 + field;
+
+        long long   usec  = 0;
+        int         scale = 0;
+        for(++pos; pos < text.size() && scale < 6; ++pos, ++scale) {
+            if(text[pos] < '0' || text[pos] > '9') {
+                break;
+            }
+            usec = usec * 10 + (text[pos] - '0');
+        }
+        for(; scale < 6; ++scale) {
+            usec *= 10;
+        }
+        return seconds * 1000000 + usec;
+    }
+
+    // The current local time of day in toMicros() units, for live sources.
+    static long long
+    nowMicros() {
+        // local midnight is looked up once a day, not on every call
+        static thread_local time_t midnight = -1;
+        struct timespec now;
+        clock_gettime(CLOCK_REALTIME, &now);
+        if(midnight < 0 || now.tv_sec < midnight || now.tv_sec - midnight >= 86400) {
+            struct tm local;
+            localtime_r(&now.tv_sec, &local);
+            midnight = now.tv_sec - (local.tm_hour * 3600 + local.tm_min * 60 + local.tm_sec);
+        }
+        return (now.tv_sec - midnight) * 1000000ll + now.tv_nsec / 1000;
+    }
+
+    static long
+    toLong(std::string_view text, long fallback) {
+        bool negative = false;
+        size_t pos = 0;
+        if(pos < text.size() && text[pos] == '-') {
+            negative = true;
+            ++pos;
+        }
+        if(pos >= text.size() || text[pos] < '0' || text[pos] > '9') {
+            return fallback;
+        }
+        long value = 0;
+        while(pos < text.size() && text[pos] >= '0' && text[pos] <= '9') {
+            if(value > (LONG_MAX - 9) / 10) {
+                return LONG_MAX;
+            }
+            value = value * 10 + (text[pos] - '0');
+            ++pos;
+        }
+        return negative ? -value : value;
+    }
+
+private:
+    static std::string_view
+    trimRight(std::string_view text) {
+        while(!text.empty() && (text.back() == ' ' || text.back() == '\r' || text.back() == '\t')) {
+            text.remove_suffix(1);
+        }
+        return text;
+    }
+
+    static std::string_view
+    trim(std::string_view text) {
+        while(!text.empty() && text.front() == ' ') {
+            text.remove_prefix(1);
+        }
+        return trimRight(text);
+    }
+
+    // Reads pid, time and name; returns the offset of the first argument
+    // byte, or npos when the line carries no syscall.
+    size_t
+    header(std::string_view line) {
+        size_t pos = prefix(line);
+        if(pos == std::string_view::npos) {
+            return pos;
+        }
+
+        static constexpr std::string_view Resumed("<... ");
+        if(line.substr(pos, Resumed.size()) == Resumed) {
+            pos += Resumed.size();
+            size_t end = line.find(' ', pos);
+            if(end == std::string_view::npos) {
+                return std::string_view::npos;
+            }
+            name  = line.substr(pos, end - pos);
+            phase = PHASE::RESUME;
+            size_t close = line.find('>', end);
+            return close == std::string_view::npos ? std::string_view::npos : close + 1;
+        }
+
+        size_t open = line.find('(', pos);
+        if(open == std::string_view::npos || open == pos) {
+            return std::string_view::npos;
+        }
+        name = line.substr(pos, open - pos);
+        if(name.find(' ') != std::string_view::npos) {
+            return std::string_view::npos;
+        }
+        return open + 1;
+    }
+
+    // Reads pid and time; returns the offset of what follows them, or npos
+    // for a time with nothing after it.
+    size_t
+    prefix(std::string_view line) {
+        size_t pos = 0;
+        if(line.substr(0, 4) == "[pid") {
+            pos = 4;
+        }
+        while(pos < line.size() && line[pos] == ' ') {
+            ++pos;
+        }
+
+        size_t digits = pos;
+        long   value  = 0;
+        while(digits < line.size() && line[digits] >= '0' && line[digits] <= '9') {
+            value = value * 10 + (line[digits] - '0');
+            ++digits;
+        }
+        if(digits > pos && digits < line.size() && (line[digits] == ' ' || line[digits] == ']')) {
+            pid = static_cast<pid_t>(value);
+            pos = digits;
+            if(line[pos] == ']') {
+                ++pos;
+            }
+            while(pos < line.size() && line[pos] == ' ') {
+                ++pos;
+            }
+        }
+
+        if(pos < line.size() && line[pos] >= '0' && line[pos] <= '9') {
+            size_t end = line.find(' ', pos);
+            if(end == std::string_view::npos) {
+                return std::string_view::npos;
+            }
+            time = line.substr(pos, end - pos);
+            pos  = end + 1;
+        }
+        return pos;
+    }
+
+    void
+    parseReturn(std::string_view text) {
+        size_t pos = 0;
+        if(text.substr(0, 2) == "0x") {
+            unsigned long value = 0;
+            for(pos = 2; pos < text.size(); ++pos) {
+                char ch = text[pos];
+                int  digit = (ch >= '0' && ch <= '9') ? ch - '0'
+                           : (ch >= 'a' && ch <= 'f') ? ch - 'a' + 10 : -1;
+                if(digit < 0) {
+                    break;
+                }
+                value = value * 16 + digit;
+            }
+            ret    = static_cast<long>(value);
+            hasRet = true;
+        } else if(!text.empty() && (text[0] == '-' || (text[0] >= '0' && text[0] <= '9'))) {
+            ret    = toLong(text, 0);
+            hasRet = true;
+            pos    = text[0] == '-' ? 1 : 0;
+            while(pos < text.size() && text[pos] >= '0' && text[pos] <= '9') {
+                ++pos;
+            }
+        } else {
+            return ;
+        }
+
+        while(pos < text.size() && text[pos] != ' ') {
+            ++pos;
+        }
+        while(pos < text.size() && text[pos] == ' ') {
+            ++pos;
+        }
+        if(pos < text.size() && text[pos] == 'E') {
+            size_t end = text.find(' ', pos);
+            error = text.substr(pos, end == std::string_view::npos ? std::string_view::npos : end - pos);
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,198 @@
+#ifndef _SYSCALLTABLE_H_
+#define _SYSCALLTABLE_H_
+
+#include <array>
+#include <cstdint>
+#include <cstddef>
+#include <string_view>
+
+// Syscalls that create, duplicate or release file descriptors, and the
+// ones that create tasks and so decide which fd table a task uses.
+// EXITED is no syscall but the "+++ exited with N +++" notice of a task
+// that is gone, set by SyscallLine::parseExit and never looked up by name.
+// Everything else in a trace maps to UNKNOWN.
+enum class SYSCALL : uint8_t {
+    UNKNOWN = 0,
+    OPEN,
+    OPENAT,
+    OPENAT2,
+    CREAT,
+    CLOSE,
+    CLOSE_RANGE,
+    DUP,
+    DUP2,
+    DUP3,
+    FCNTL,
+    SOCKET,
+    SOCKETPAIR,
+    ACCEPT,
+    ACCEPT4,
+    PIPE,
+    PIPE2,
+    EVENTFD,
+    EVENTFD2,
+    EPOLL_CREATE,
+    EPOLL_CREATE1,
+    MEMFD_CREATE,
+    TIMERFD_CREATE,
+    SIGNALFD,
+    SIGNALFD4,
+    INOTIFY_INIT,
+    INOTIFY_INIT1,
+    CLONE,
+    CLONE3,
+    FORK,
+    VFORK,
+    EXITED,
+    COUNT
+};
+
+namespace syscall_table {
+
+struct Entry {
+    std::string_view    name;
+    SYSCALL             call;
+};
+
+constexpr Entry Names[] = {
+    {"open",            SYSCALL::OPEN},
+    {"openat",          SYSCALL::OPENAT},
+    {"openat2",         SYSCALL::OPENAT2},
+    {"creat",           SYSCALL::CREAT},
+    {"close",           SYSCALL::CLOSE},
+    {"close_range",     SYSCALL::CLOSE_RANGE},
+    {"dup",             SYSCALL::DUP},
+    {"dup2",            SYSCALL::DUP2},
+    {"dup3",            SYSCALL::DUP3},
+    {"fcntl",           SYSCALL::FCNTL},
+    {"socket",          SYSCALL::SOCKET},
+    {"socketpair",      SYSCALL::SOCKETPAIR},
+    {"accept",          SYSCALL::ACCEPT},
+    {"accept4",         SYSCALL::ACCEPT4},
+    {"pipe",            SYSCALL::PIPE},
+    {"pipe2",           SYSCALL::PIPE2},
+    {"eventfd",         SYSCALL::EVENTFD},
+    {"eventfd2",        SYSCALL::EVENTFD2},
+    {"epoll_create",    SYSCALL::EPOLL_CREATE},
+    {"epoll_create1",   SYSCALL::EPOLL_CREATE1},
+    {"memfd_create",    SYSCALL::MEMFD_CREATE},
+    {"timerfd_create",  SYSCALL::TIMERFD_CREATE},
+    {"signalfd",        SYSCALL::SIGNALFD},
+    {"signalfd4",       SYSCALL::SIGNALFD4},
+    {"inotify_init",    SYSCALL::INOTIFY_INIT},
+    {"inotify_init1",   SYSCALL::INOTIFY_INIT1},
+    {"clone",           SYSCALL::CLONE},
+    {"clone3",          SYSCALL::CLONE3},
+    {"fork",            SYSCALL::FORK},
+    {"vfork",           SYSCALL::VFORK},
+};
+
+constexpr size_t    NameCount = sizeof(Names) / sizeof(Names[0]);
+constexpr size_t    Slots     = 128;
+
+// UNKNOWN and EXITED are not looked up: no call line can map to them
+static_assert(NameCount + 2 == static_cast<size_t>(SYSCALL::COUNT), "every SYSCALL needs a name");
+static_assert(NameCount < 255, "slot index is stored in a byte");
+
+// FNV-1a with a seeded offset basis.
+constexpr uint32_t
+hash(std::string_view name, uint32_t seed) {
+    uint32_t value = 2166136261u ^ seed;
+    for(char ch : name) {
+        value ^= static_cast<uint8_t>(ch);
+        value *= 16777619u;
+    }
+    return value;
+}
+
+constexpr bool
+collisionFree(uint32_t seed) {
+    bool used[Slots] = {};
+    for(const auto & entry : Names) {
+        size_t slot = hash(entry.name, seed) & (Slots - 1);
+        if(used[slot]) {
+            return false;
+        }
+        used[slot] = true;
+    }
+    return true;
+}
+
+constexpr uint32_t
+findSeed() {
+    uint32_t seed = 0;
+    while(!collisionFree(seed)) {
+        ++seed;
+    }
+    return seed;
+}
+
+constexpr uint32_t  Seed = findSeed();
+
+// slot -> index into Names + 1, 0 means empty
+constexpr std::array<uint8_t, Slots>
+buildSlots() {
+    std::array<uint8_t, Slots> slots{};
+    for(size_t indx = 0; indx < NameCount; ++indx) {
+        slots[hash(Names[indx].name, Seed) & (Slots - 1)] = static_cast<uint8_t>(indx + 1);
+    }
+    return slots;
+}
+
+constexpr std::array<uint8_t, Slots>    Table = buildSlots();
+
+} // namespace syscall_table
+
+class SyscallTable {
+public:
+    // One hash, one table probe and one compare; no collisions by construction.
+    static constexpr SYSCALL
+    lookup(std::string_view name) {
+        uint8_t slot = syscall_table::Table[syscall_table::hash(name, syscall_table::Seed)
+                                            & (syscall_table::Slots - 1)];
+        if(slot != 0 && syscall_table::Names[slot - 1].name == name) {
+            return syscall_table::Names[slot - 1].call;
+        }
+        return SYSCALL::UNKNOWN;
+    }
+
+    static constexpr std::string_view
+    name(SYSCALL call) {
+        if(call == SYSCALL::EXITED) {
+            return "exited";
+        }
+        for(const auto & entry : syscall_table::Names) {
+            if(entry.call == call) {
+                return entry.name;
+            }
+        }
+        return "unknown";
+    }
+
+    // clone, clone3, fork and vfork: the return value is a task, not an fd.
+    static constexpr bool
+    spawns(SYSCALL call) {
+        return call == SYSCALL::CLONE || call == SYSCALL::CLONE3
+               || call == SYSCALL::FORK || call == SYSCALL::VFORK;
+    }
+
+    // Calls whose first argument is an fd they work on: close, dup*,
+    // fcntl, accept*, close_range (the first of the range).
+    static constexpr bool
+    takesFd(SYSCALL call) {
+        return call == SYSCALL::CLOSE || call == SYSCALL::CLOSE_RANGE || call == SYSCALL::DUP
+               || call == SYSCALL::DUP2 || call == SYSCALL::DUP3 || call == SYSCALL::FCNTL
+               || call == SYSCALL::ACCEPT || call == SYSCALL::ACCEPT4;
+    }
+
+private:
+    SyscallTable() = delete;
+};
+
+static_assert(SyscallTable::lookup("openat") == SYSCALL::OPENAT, "perfect hash lookup");
+static_assert(SyscallTable::lookup("close_range") == SYSCALL::CLOSE_RANGE, "perfect hash lookup");
+static_assert(SyscallTable::lookup("vfork") == SYSCALL::VFORK, "perfect hash lookup");
+static_assert(SyscallTable::lookup("fclose") == SYSCALL::UNKNOWN, "perfect hash lookup");
+static_assert(SyscallTable::lookup("exited") == SYSCALL::UNKNOWN, "exit notices are no call lines");
+
+#endif
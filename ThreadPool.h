@@ -2,20 +2,53 @@
 #define _THREADPOOL_H_
 
 #include <queue>
+#include <deque>
 #include <vector>
-#include <unordered_set>
 #include <iostream>
+#include <fstream>
+#include <sstream>
 #include <thread>
 #include <mutex>
+#include <chrono>
+#include <algorithm>
+#include <iterator>
+#include <numeric>
 #include <functional>
 #include <condition_variable>
 #include <future>
 
+#include <sched.h>
+
 #include "util.h"
+#include "MemoryStats.h"
 
 class ThreadPool {
 private:
-    using Task = std::function<void()>;
+    using Task  = std::function<void()>;
+    using Clock = std::chrono::steady_clock;
+
+    struct Queued {
+        Task                task;
+        Clock::time_point   queued;
+        const void          *owner;     // purge(owner) drops it
+        size_t              bytes;      // in the ThreadPool.queue account
+    };
+
+public:
+    // Bounds and triggers of the autoscaler. A tick with more than
+    // `depthPerWorker` queued tasks per worker, or a head task waiting
+    // longer than `waitUsec`, is behind; `behindTicks` of them in a row add
+    // half the workers again, at least one. A worker idle for `idleUsec`
+    // retires, down to `minThreads`.
+    struct ScalePolicy {
+        unsigned    minThreads      = 1;
+        unsigned    maxThreads      = 0;        // 0: cpuLimit()
+        size_t      depthPerWorker  = 4;
+        long long   waitUsec        = 5000;
+        unsigned    behindTicks     = 3;
+        long long   idleUsec        = 10000000;
+        long long   tickUsec        = 10000;
+    };
 
 public:
     static ThreadPool* getInstance(const unsigned int nthreads) {
@@ -23,6 +56,9 @@ public:
         return &instance;
     }
 
+    // Sets the worker count. Never waits for running tasks: surplus workers
+    // leave once they are between tasks. While autoscaling, only raises the
+    // count, within the policy's bounds.
     bool    adjust(const unsigned int threads) {
         auto maxThreads = std::thread::hardware_concurrency();
         if(threads > maxThreads) {
@@ -30,21 +66,137 @@ public:
             return false;
         }
 
-        unsigned nowThreads = mWorkers.size();
-        if(nowThreads > threads)  {
-            subtract(nowThreads - threads);
-        } else if(nowThreads < threads) {
-            append(threads - nowThreads);
+        reap();
+        unsigned nowThreads = size();
+        unsigned target     = threads;
+        {
+            std::lock_guard<std::mutex> lock(mTaskLock);
+            if(mScaling) {
+                target = std::max(std::min(threads, mPolicy.maxThreads), mPolicy.minThreads);
+                target = std::max(target, nowThreads);
+            }
+        }
+        if(nowThreads > target)  {
+            subtract(nowThreads - target);
+        } else if(nowThreads < target) {
+            append(target - nowThreads);
         }
 
-        DEG_LOG("thread num: %d", mWorkers.size());
+        DEG_LOG("thread num: %d", size());
 
         return true;
     }
 
+    // Starts the autoscaler, or gives a running one a new policy.
+    void    autoscale(ScalePolicy policy) {
+        unsigned limit = cpuLimit();
+        policy.maxThreads = policy.maxThreads == 0 ? limit : std::min(policy.maxThreads, limit);
+        policy.minThreads = std::min(std::max(policy.minThreads, 1u), policy.maxThreads);
+        bool start = false;
+        {
+            std::lock_guard<std::mutex> lock(mTaskLock);
+            mPolicy  = policy;
+            start    = !mScaling;
+            mScaling = true;
+            // idle workers switch to timed waits
+            mTaskCond.notify_all();
+        }
+        if(start) {
+            if(mScaler.joinable()) {
+                mScaler.join();
+            }
+            mScaler = std::thread(&ThreadPool::scaler, this);
+        }
+        DEG_LOG("autoscale %u..%u threads", policy.minThreads, policy.maxThreads);
+    }
+
+    // Leaves the worker count where the autoscaler left it.
+    void    stopAutoscale() {
+        {
+            std::lock_guard<std::mutex> lock(mTaskLock);
+            mScaling = false;
+            mScaleCond.notify_all();
+        }
+        if(mScaler.joinable()) {
+            mScaler.join();
+        }
+    }
+
+    bool    autoscaling() {
+        std::lock_guard<std::mutex> lock(mTaskLock);
+        return mScaling;
+    }
+
+    // Workers that are not leaving.
+    unsigned    size() {
+        std::lock_guard<std::mutex> lock(mTaskLock);
+        return mLive;
+    }
+
+    // CPUs this process may use: the affinity mask and the cgroup (v2 or
+    // v1) CPU quota, rounded up, whichever is lower.
+    static unsigned cpuLimit() {
+        unsigned limit = std::max(1u, std::thread::hardware_concurrency());
+        cpu_set_t set;
+        if(sched_getaffinity(0, sizeof(set), &set) == 0 && CPU_COUNT(&set) > 0) {
+            limit = std::min(limit, static_cast<unsigned>(CPU_COUNT(&set)));
+        }
+
+        long long quota = -1, period = 0;
+        std::ifstream cgroups("/proc/self/cgroup");
+        std::string line;
+        while(quota < 0 && std::getline(cgroups, line)) {
+            // "0::/path" for v2, "4:cpu,cpuacct:/path" for v1
+            size_t first  = line.find(':');
+            size_t second = first == std::string::npos ? first : line.find(':', first + 1);
+            if(second == std::string::npos) {
+                continue;
+            }
+            std::string controllers = "," + line.substr(first + 1, second - first - 1) + ",";
+            std::string path = line.substr(second + 1);
+            if(controllers == ",,") {
+                for(const std::string & dir : {"/sys/fs/cgroup" + path, std::string("/sys/fs/cgroup")}) {
+                    std::ifstream max(dir + "/cpu.max");
+                    std::string text;
+                    if(max >> text >> period) {
+                        quota = text == "max" ? 0 : std::atoll(text.c_str());
+                        break;
+                    }
+                }
+            } else if(controllers.find(",cpu,") != std::string::npos) {
+                for(const char * mount : {"/sys/fs/cgroup/cpu", "/sys/fs/cgroup/cpu,cpuacct"}) {
+                    for(const std::string & dir : {mount + path, std::string(mount)}) {
+                        std::ifstream quotaFile(dir + "/cpu.cfs_quota_us");
+                        std::ifstream periodFile(dir + "/cpu.cfs_period_us");
+                        if(quotaFile >> quota && periodFile >> period) {
+                            break;
+                        }
+                        quota = -1;
+                    }
+                    if(quota >= 0) {
+                        break;
+                    }
+                }
+            }
+        }
+        if(quota > 0 && period > 0) {
+            limit = std::min(limit, static_cast<unsigned>(std::max(1ll, (quota + period - 1) / period)));
+        }
+        return limit;
+    }
+
     template<typename F, typename... Args>
     auto    enqueue(F && f, Args &&... args) -> std::shared_future<decltype(f(args...))> {
+        return enqueueFor(nullptr, std::forward<F>(f), std::forward<Args>(args)...);
+    }
+
+    // enqueue() on behalf of `owner`, whose queued tasks purge(owner) drops
+    // without touching those of other runs on the pool.
+    template<typename F, typename... Args>
+    auto    enqueueFor(const void * owner, F && f, Args &&... args) -> std::shared_future<decltype(f(args...))> {
         using RType = decltype(f(args...));
+        // measured before the arguments move into the binding
+        size_t held[] = {sizeof(Queued) + sizeof(std::packaged_task<RType()>), heldBytes(args)...};
         std::function<RType()> func = std::bind(std::forward<F>(f), std::forward<Args>(args)...);
 
         auto task_ptr = std::make_shared<std::packaged_task<RType()>>(func);
@@ -53,61 +205,102 @@ public:
             return ;
         };
 
-        submit(threadFunc);
+        submit(threadFunc, owner, std::accumulate(std::begin(held), std::end(held), size_t(0)));
 
 
         return task_ptr->get_future();
     }
 
+    // Drops every task that has not started yet and returns how many. Their
+    // futures report std::future_errc::broken_promise; running tasks finish.
+    size_t  purge() {
+        std::deque<Queued> dropped;
+        {
+            std::lock_guard<std::mutex> lock(mTaskLock);
+            std::swap(dropped, mTaskQueue);
+        }
+        for(const auto & queued : dropped) {
+            queueAccount().sub(queued.bytes);
+        }
+        DEG_LOG("purge %zu tasks", dropped.size());
+        return dropped.size();
+    }
+
+    // purge() of the tasks enqueued for `owner` only.
+    size_t  purge(const void * owner) {
+        std::deque<Queued> dropped;
+        {
+            std::lock_guard<std::mutex> lock(mTaskLock);
+            auto keep = std::stable_partition(mTaskQueue.begin(), mTaskQueue.end(),
+                                              [owner](const Queued & queued){ return queued.owner != owner; });
+            std::move(keep, mTaskQueue.end(), std::back_inserter(dropped));
+            mTaskQueue.erase(keep, mTaskQueue.end());
+        }
+        for(const auto & queued : dropped) {
+            queueAccount().sub(queued.bytes);
+        }
+        DEG_LOG("purge %zu tasks", dropped.size());
+        return dropped.size();
+    }
+
     ~ThreadPool() {
+        stopAutoscale();
         {
             std::lock_guard<std::mutex> lock(mTaskLock);
             mFinish = true;
             mTaskCond.notify_all();
         }
 
+        std::lock_guard<std::mutex> lock(mWorkerLock);
         for(auto & element : mWorkers) {
             if(element.joinable()) {
                 element.join();
             }
         }
         DEG_LOG("Thread Service exit ...");
-        
+
     }
 
 private:
-    ThreadPool(const unsigned int nthreads): mFinish(false), mAdjust(false) {
+    ThreadPool(const unsigned int nthreads): mFinish(false), mLive(0), mRetire(0), mScaling(false) {
         int nThreads = nthreads > std::thread::hardware_concurrency() ? std::thread::hardware_concurrency() : nthreads;
         //int nThreads = static_cast<int>(std::thread::hardware_concurrency() / 64.0 * 60);
-        for(int pos = 0; pos < nThreads; ++pos) {
-            mWorkers.push_back(std::thread(&ThreadPool::worker, this ));
-        }
+        append(nThreads);
     }
 
     void    append(const  int threads) {
+        std::lock_guard<std::mutex> workers(mWorkerLock);
         for(int indx = 0; indx < threads; ++indx) {
             mWorkers.push_back(std::thread(&ThreadPool::worker, this));
         }
+        std::lock_guard<std::mutex> lock(mTaskLock);
+        mLive += threads;
     }
 
+    // Asks `threads` workers to leave after their current task; reap()
+    // joins them later.
     void    subtract(const  int threads) {
-        {
-            std::lock_guard<std::mutex> lock(mTaskLock);
-            mModifyThreads = threads;
-            mAdjust        = true;
-            mTaskCond.notify_all();
-        }
+        std::lock_guard<std::mutex> lock(mTaskLock);
+        unsigned count = std::min(static_cast<unsigned>(threads), mLive);
+        mRetire += count;
+        mLive   -= count;
+        mTaskCond.notify_all();
+    }
 
+    // Joins the workers that have left.
+    void    reap() {
+        std::vector<std::thread::id> exited;
         {
-            std::unique_lock<std::mutex> lock(mTaskLock);
-            mModifyCond.wait(lock, [&](){return mModifyThreads == 0;});
+            std::lock_guard<std::mutex> lock(mTaskLock);
+            exited.swap(mExited);
         }
-
-        for(const auto & element : mRecycleThreads) {
-            DEG_LOG("Ready to remove: %d", element);
+        if(exited.empty()) {
+            return ;
         }
+        std::lock_guard<std::mutex> lock(mWorkerLock);
         for(auto it = mWorkers.begin(); it != mWorkers.end();) {
-            if(mRecycleThreads.count(it->get_id()) > 0) {
+            if(std::find(exited.begin(), exited.end(), it->get_id()) != exited.end()) {
+                DEG_LOG("remove thread: %ld", it->get_id());
                 if(it->joinable()) {
                     it->join();
                 }
@@ -116,68 +309,126 @@ private:
                 ++it;
             }
         }
-
-        mRecycleThreads.clear();
-        {
-            std::lock_guard<std::mutex> lock(mTaskLock);
-            mAdjust = false;
-        }
     }
 
-
     void    worker() {
         while(true) {
             Task task;
             {
                 std::unique_lock<std::mutex> lock(mTaskLock);
-                mTaskCond.wait(lock, [&](){return !mTaskQueue.empty() || mFinish || mAdjust;});
-                if(mAdjust) {
-                    if(mModifyThreads > 0) {
-                        --mModifyThreads;
-                        DEG_LOG("remove thread: %ld", std::this_thread::get_id());
-                        mRecycleThreads.insert(std::this_thread::get_id());
-                        if(mModifyThreads == 0) {
-                            mModifyCond.notify_one();
-                        }
-                        return ;
-                    } else {
+                auto idleSince = Clock::now();
+                while(mTaskQueue.empty() && !mFinish && mRetire == 0) {
+                    // at the floor nothing can retire: a timed wait would
+                    // only time out again and again
+                    if(!mScaling || mLive <= mPolicy.minThreads) {
+                        mTaskCond.wait(lock);
+                        idleSince = Clock::now();
                         continue;
                     }
+                    // parked; retires after a whole idle timeout above the floor
+                    auto deadline = idleSince + std::chrono::microseconds(mPolicy.idleUsec);
+                    if(mTaskCond.wait_until(lock, deadline) == std::cv_status::timeout) {
+                        if(mTaskQueue.empty() && mScaling && mLive > mPolicy.minThreads) {
+                            --mLive;
+                            mExited.push_back(std::this_thread::get_id());
+                            return ;
+                        }
+                        idleSince = Clock::now();
+                    }
+                }
+                if(mRetire > 0) {
+                    --mRetire;
+                    mExited.push_back(std::this_thread::get_id());
+                    return ;
                 }
 
                 if(mTaskQueue.empty() /*&& mFinish*/) {
                     return ;
                 }
 
-                task = mTaskQueue.front();
-                mTaskQueue.pop();
-            }          
+                task = std::move(mTaskQueue.front().task);
+                queueAccount().sub(mTaskQueue.front().bytes);
+                mTaskQueue.pop_front();
+            }
 
             task();
 
         }
     }
 
-    void    submit(const Task & task) {
+    void    scaler() {
+        unsigned behind = 0;
+        while(true) {
+            unsigned grow = 0;
+            {
+                std::unique_lock<std::mutex> lock(mTaskLock);
+                mScaleCond.wait_for(lock, std::chrono::microseconds(mPolicy.tickUsec), [&](){return !mScaling;});
+                if(!mScaling) {
+                    break;
+                }
+                size_t    depth = mTaskQueue.size();
+                long long wait  = depth == 0 ? 0
+                                : std::chrono::duration_cast<std::chrono::microseconds>(
+                                      Clock::now() - mTaskQueue.front().queued).count();
+                behind = depth > mLive * mPolicy.depthPerWorker || wait > mPolicy.waitUsec ? behind + 1 : 0;
+                if(mLive < mPolicy.minThreads) {
+                    grow = mPolicy.minThreads - mLive;
+                } else if(behind >= mPolicy.behindTicks && mLive < mPolicy.maxThreads) {
+                    grow   = std::min(mPolicy.maxThreads - mLive, std::max(1u, mLive / 2));
+                    behind = 0;
+                }
+            }
+            if(grow > 0) {
+                append(static_cast<int>(grow));
+                DEG_LOG("autoscale up %u: %u threads", grow, size());
+            }
+            reap();
+        }
+    }
+
+    // Bytes a queued task keeps alive for its bound arguments: the lines
+    // of the EBADF passes are most of them.
+    template<typename T>
+    static size_t   heldBytes(const T & value) {
+        return sizeof(value);
+    }
+    static size_t   heldBytes(const std::string & value) {
+        const char * inside = reinterpret_cast<const char *>(&value);
+        bool local = value.data() >= inside && value.data() < inside + sizeof(value);
+        return sizeof(value) + (local ? 0 : value.capacity() + 1);
+    }
+
+    static MemoryAccount &  queueAccount() {
+        static MemoryAccount & account = MemoryStats::getInstance()->account("ThreadPool.queue");
+        return account;
+    }
+
+    void    submit(const Task & task, const void * owner, size_t bytes) {
+        queueAccount().add(bytes);
         std::lock_guard<std::mutex> lock(mTaskLock);
-        mTaskQueue.push(task);
+        mTaskQueue.push_back(Queued{task, Clock::now(), owner, bytes});
         mTaskCond.notify_one();
     }
     ThreadPool(const ThreadPool &) = delete;
     ThreadPool& operator=(const ThreadPool &) = delete;
 
 private:
-    std::vector<std::thread> mWorkers;
-    std::queue<Task>        mTaskQueue;
+    std::mutex                  mWorkerLock;    // mWorkers; taken before mTaskLock
+    std::vector<std::thread>    mWorkers;
+    std::deque<Queued>          mTaskQueue;
 
     bool                    mFinish;
     std::mutex              mTaskLock;
     std::condition_variable mTaskCond;
 
-    int                                 mModifyThreads;
-    bool                                mAdjust;
-    std::condition_variable             mModifyCond;
-    std::unordered_set<std::thread::id> mRecycleThreads;
+    unsigned                        mLive;      // workers not asked to leave
+    unsigned                        mRetire;    // leaves asked for, not taken yet
+    std::vector<std::thread::id>    mExited;    // left, not joined yet
+
+    bool                    mScaling;
+    ScalePolicy             mPolicy;
+    std::condition_variable mScaleCond;
+    std::thread             mScaler;
 };
 
 #endif
@@ -0,0 +1,223 @@
+#include <chrono>
+#include <thread>
+#include <cstdio>
+#include <cstdlib>
+#include <algorithm>
+
+#include "TraceDiff.h"
+
+using Clock = std::chrono::steady_clock;
+
+static double
+since(Clock::time_point begin) {
+    return std::chrono::duration<double>(Clock::now() - begin).count();
+}
+
+/******************* public function ********************************/
+TraceDiff::Result
+TraceDiff::run(
+    const Side &    before,
+    const Side &    after,
+    unsigned        threads
+) {
+    Result result;
+    mBefore.initResources(before.pid, before.path, threads);
+    mAfter.initResources(after.pid, after.path, threads);
+    mBefore.setTimelineBucket(mOptions.bucketUsec);
+    mAfter.setTimelineBucket(mOptions.bucketUsec);
+    DEG_LOG("trace diff %s -> %s, threads %u", before.path.c_str(), after.path.c_str(), threads);
+
+    // the after trace on a thread of its own, the before one on ours: two
+    // readers and two apply threads, one pool for the parsing
+    auto begin = Clock::now();
+    std::thread second([this, &result, begin](){
+        mAfter.process();
+        result.afterSeconds = since(begin);
+    });
+    mBefore.process();
+    result.beforeSeconds = since(begin);
+    second.join();
+    result.seconds = since(begin);
+
+    result.cancelled = mBefore.cancelled() || mAfter.cancelled();
+    if(result.cancelled) {
+        DEG_LOG("trace diff cancelled");
+        return result;
+    }
+    result.before  = mBefore.getResult();
+    result.after   = mAfter.getResult();
+    result.changes = compare(result.before, result.after, mOptions);
+    DEG_LOG("trace diff: %zu changes in %.3fs", result.changes.size(), result.seconds);
+    return result;
+}
+
+void
+TraceDiff::cancel() {
+    mBefore.cancel();
+    mAfter.cancel();
+}
+
+double
+TraceDiff::progress() {
+    return std::min(mBefore.progress(), mAfter.progress());
+}
+
+std::vector<TraceDiff::Change>
+TraceDiff::compare(
+    const DescriptorMatch::MatchResult &    before,
+    const DescriptorMatch::MatchResult &    after,
+    const Options &                         options
+) {
+    std::vector<Change> changes;
+    // a key of one trace only skips the ratio, never the count
+    auto keep = [&](DIFFKIND kind, const std::string & key, long long was, long long now, bool oneSide) {
+        if(oneSide ? std::llabs(now - was) >= static_cast<long long>(options.minCount)
+                   : significant(was, now, options)) {
+            changes.push_back(Change{kind, key, was, now});
+        }
+    };
+
+    keep(DIFFKIND::SUMMARY, "leaks", static_cast<long long>(before.leaks.size()),
+         static_cast<long long>(after.leaks.size()), false);
+    keep(DIFFKIND::SUMMARY, "ebadf", static_cast<long long>(before.badFds),
+         static_cast<long long>(after.badFds), false);
+    keep(DIFFKIND::SUMMARY, "unknown closes", static_cast<long long>(before.unknownCloses),
+         static_cast<long long>(after.unknownCloses), false);
+    for(size_t indx = 0; indx < before.raceCounts.size(); ++indx) {
+        keep(DIFFKIND::SUMMARY, RaceDetector::name(static_cast<RACE>(indx)),
+             static_cast<long long>(before.raceCounts[indx]), static_cast<long long>(after.raceCounts[indx]), false);
+    }
+
+    for(size_t indx = 0; indx < before.calls.size(); ++indx) {
+        keep(DIFFKIND::SYSCALL, std::string(SyscallTable::name(static_cast<SYSCALL>(indx))),
+             static_cast<long long>(before.calls[indx]), static_cast<long long>(after.calls[indx]), false);
+    }
+
+    // open minus close per fd number
+    auto net = [](const DescriptorMatch::FdBalance & balance) {
+        return static_cast<long long>(balance.opens) - static_cast<long long>(balance.closes);
+    };
+    std::map<long, Pair> balances;
+    for(const auto & element : before.balance) {
+        balances[element.first].set(0, net(element.second));
+    }
+    for(const auto & element : after.balance) {
+        balances[element.first].set(1, net(element.second));
+    }
+    for(const auto & element : balances) {
+        keep(DIFFKIND::BALANCE, "fd " + std::to_string(element.first), element.second.value[0],
+             element.second.value[1], element.second.oneSide());
+    }
+
+    std::map<DescriptorMatch::BadFdKey, Pair> badFds;
+    for(const auto & element : before.ebadf) {
+        badFds[element.first].set(0, static_cast<long long>(element.second));
+    }
+    for(const auto & element : after.ebadf) {
+        badFds[element.first].set(1, static_cast<long long>(element.second));
+    }
+    for(const auto & element : badFds) {
+        std::string key = std::string(SyscallTable::name(element.first.first)) + " fd "
+                        + std::to_string(element.first.second);
+        keep(DIFFKIND::BADFD, key, element.second.value[0], element.second.value[1], element.second.oneSide());
+    }
+
+    std::vector<long long> was = openFds(before, options.bucketUsec);
+    std::vector<long long> now = openFds(after, options.bucketUsec);
+    long long wasPeak = was.empty() ? 0 : *std::max_element(was.begin(), was.end());
+    long long nowPeak = now.empty() ? 0 : *std::max_element(now.begin(), now.end());
+    keep(DIFFKIND::TIMELINE, "peak open fds", wasPeak, nowPeak, false);
+    keep(DIFFKIND::TIMELINE, "open fds at end", was.empty() ? 0 : was.back(), now.empty() ? 0 : now.back(), false);
+    // where the two curves part, in seconds from each trace's first event
+    for(size_t indx = 0; indx < std::min(was.size(), now.size()); ++indx) {
+        if(was[indx] != now[indx] && significant(was[indx], now[indx], options)) {
+            char key[64];
+            std::snprintf(key, sizeof(key), "open fds from +%.3fs", indx * options.bucketUsec / 1e6);
+            changes.push_back(Change{DIFFKIND::TIMELINE, key, was[indx], now[indx]});
+            break;
+        }
+    }
+
+    std::stable_sort(changes.begin(), changes.end(), [](const Change & lhs, const Change & rhs) {
+        if(lhs.kind != rhs.kind) {
+            return lhs.kind < rhs.kind;
+        }
+        return std::llabs(lhs.after - lhs.before) > std::llabs(rhs.after - rhs.before);
+    });
+    return changes;
+}
+
+std::string
+TraceDiff::format(
+    const Change &  change
+) {
+    char line[256];
+    std::snprintf(line, sizeof(line), "  %-9s %-32s %10lld -> %-10lld (%+lld)", name(change.kind), change.key.c_str(),
+                  change.before, change.after, change.after - change.before);
+    return line;
+}
+
+const char *
+TraceDiff::name(
+    DIFFKIND    kind
+) {
+    switch(kind) {
+        case DIFFKIND::SUMMARY:     return "summary";
+        case DIFFKIND::SYSCALL:     return "syscall";
+        case DIFFKIND::BALANCE:     return "balance";
+        case DIFFKIND::BADFD:       return "ebadf";
+        case DIFFKIND::TIMELINE:    return "timeline";
+    }
+    return "unknown";
+}
+
+/******************* private function ********************************/
+std::vector<long long>
+TraceDiff::openFds(
+    const DescriptorMatch::MatchResult &    result,
+    long long                               bucketUsec
+) {
+    long long first = -1;
+    long long last  = -1;
+    for(const auto & element : result.usage) {
+        if(element.second.empty()) {
+            continue;
+        }
+        if(first < 0 || element.second.front().usec < first) {
+            first = element.second.front().usec;
+        }
+        last = std::max(last, element.second.back().usec);
+    }
+    std::vector<long long> total;
+    if(first < 0) {
+        return total;
+    }
+    total.resize(static_cast<size_t>((last - first) / bucketUsec) + 1, 0);
+    for(const auto & element : result.usage) {
+        const FdTimeline::Series & series = element.second;
+        if(series.empty()) {
+            continue;
+        }
+        // a task's count holds after its last bucket
+        size_t from = static_cast<size_t>((series.front().usec - first) / bucketUsec);
+        for(size_t indx = from; indx < total.size(); ++indx) {
+            size_t point = std::min(indx - from, series.size() - 1);
+            total[indx] += series[point].openFds;
+        }
+    }
+    return total;
+}
+
+bool
+TraceDiff::significant(
+    long long       before,
+    long long       after,
+    const Options & options
+) {
+    long long delta = std::llabs(after - before);
+    if(delta == 0) {
+        return false;
+    }
+    return delta >= static_cast<long long>(options.minCount)
+           && delta >= options.minRatio * std::max<long long>(std::llabs(before), 1);
+}
@@ -0,0 +1,98 @@
+#ifndef _TRACEDIFF_H_
+#define _TRACEDIFF_H_
+
+#include <string>
+#include <vector>
+
+#include <sys/types.h>
+
+#include "DescriptorMatch.h"
+
+enum class DIFFKIND : uint8_t {
+    SUMMARY     = 0,    // leaks, EBADF, unknown closes, races
+    SYSCALL     = 1,    // complete calls of one syscall
+    BALANCE     = 2,    // opens minus closes of one fd number
+    BADFD       = 3,    // EBADF calls of one syscall on one fd number
+    TIMELINE    = 4,    // open-fd count over time
+};
+
+// Differential match of two traces, a good and a bad build of the same
+// program: both are matched at once, each on its own apply thread, with
+// their parse chunks on the shared ThreadPool, so the run takes about as
+// long as the larger trace alone. Only the changes past both thresholds
+// of the Options are kept; a key seen in one trace only (an fd number or
+// EBADF that is new or gone) needs only the minCount one.
+class TraceDiff {
+public:
+    struct Options {
+        size_t      minCount    = 5;        // smallest absolute change
+        double      minRatio    = 0.25;     // smallest change relative to before
+        long long   bucketUsec  = 1000000;  // open-fd count buckets
+    };
+
+    struct Side {
+        std::string path;
+        pid_t       pid         = -1;       // -1: every task of the trace
+    };
+
+    struct Change {
+        DIFFKIND    kind        = DIFFKIND::SUMMARY;
+        std::string key;
+        long long   before      = 0;
+        long long   after       = 0;
+    };
+
+    struct Result {
+        std::vector<Change> changes;        // by kind, largest change first
+        DescriptorMatch::MatchResult    before;
+        DescriptorMatch::MatchResult    after;
+        double      beforeSeconds   = 0;
+        double      afterSeconds    = 0;
+        double      seconds         = 0;    // wall time of the whole diff
+        bool        cancelled       = false;
+    };
+
+public:
+    TraceDiff(): mOptions() {}
+    explicit TraceDiff(const Options & options): mOptions(options) {}
+    TraceDiff(const TraceDiff &) = delete;
+    TraceDiff& operator=(const TraceDiff &) = delete;
+
+    Result  run(const Side & before, const Side & after, unsigned threads);
+    // Stops both matches of a running run(); callable from any thread.
+    void    cancel();
+    double  progress();
+
+    // The changes between two match results, without running anything.
+    static std::vector<Change>  compare(const DescriptorMatch::MatchResult & before,
+                                        const DescriptorMatch::MatchResult & after, const Options & options);
+    // "  kind  key  before -> after (+delta)"
+    static std::string  format(const Change & change);
+    static const char * name(DIFFKIND kind);
+
+private:
+    // Values of one key in the before [0] and after [1] results.
+    struct Pair {
+        long long   value[2]    = {0, 0};
+        bool        seen[2]     = {false, false};
+
+        void    set(int side, long long count) {
+            value[side] = count;
+            seen[side]  = true;
+        }
+        bool    oneSide() const {
+            return seen[0] != seen[1];
+        }
+    };
+
+    // Open fds of every task summed per bucket, bucket 0 at the first event.
+    static std::vector<long long>   openFds(const DescriptorMatch::MatchResult & result, long long bucketUsec);
+    static bool significant(long long before, long long after, const Options & options);
+
+private:
+    Options         mOptions;
+    DescriptorMatch mBefore;
+    DescriptorMatch mAfter;
+};
+
+#endif
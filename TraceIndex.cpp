@@ -0,0 +1,250 @@
+#include <cstring>
+#include <algorithm>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "TraceIndex.h"
+
+static inline void
+putVarint(std::vector<uint8_t> & out, uint64_t value) {
+    while(value >= 0x80) {
+        out.push_back(static_cast<uint8_t>(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<uint8_t>(value));
+}
+
+static inline uint64_t
+getVarint(const uint8_t *& data) {
+    uint64_t value = 0;
+    int      shift = 0;
+    while(*data & 0x80) {
+        value |= static_cast<uint64_t>(*data++ & 0x7f) << shift;
+        shift += 7;
+    }
+    return value | (static_cast<uint64_t>(*data++) << shift);
+}
+
+static inline uint64_t
+zigzag(long long value) {
+    return (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63);
+}
+
+static inline long long
+unzigzag(uint64_t value) {
+    return static_cast<long long>(value >> 1) ^ -static_cast<long long>(value & 1);
+}
+
+/******************* PostingList ********************************/
+void
+TraceIndex::PostingList::append(
+    const FdEvent & event,
+    long            other
+) {
+    if(blocks.empty() || blocks.back().count == BLOCKLEN) {
+        Block block;
+        block.offset  = event.offset;
+        block.usec    = event.usec;
+        block.minUsec = event.usec;
+        block.maxUsec = event.usec;
+        block.pos     = data.size();
+        block.count   = 0;
+        blocks.push_back(block);
+        lastOffset = event.offset;
+        lastUsec   = event.usec;
+    }
+    Block & block = blocks.back();
+    block.minUsec = std::min(block.minUsec, event.usec);
+    block.maxUsec = std::max(block.maxUsec, event.usec);
+    ++block.count;
+
+    putVarint(data, event.offset - lastOffset);
+    putVarint(data, zigzag(event.usec - lastUsec));
+    putVarint(data, zigzag(other));
+    data.push_back(static_cast<uint8_t>(event.call));
+    data.push_back(static_cast<uint8_t>(event.kind));
+    lastOffset = event.offset;
+    lastUsec   = event.usec;
+}
+
+template<typename Visit>
+void
+TraceIndex::PostingList::scan(
+    long long   fromUsec,
+    long long   toUsec,
+    Visit       visit
+) const {
+    for(const Block & block : blocks) {
+        if((fromUsec >= 0 && block.maxUsec < fromUsec) || (toUsec >= 0 && block.minUsec > toUsec)) {
+            continue;
+        }
+        const uint8_t * cursor = data.data() + block.pos;
+        uint64_t    offset = block.offset;
+        long long   usec   = block.usec;
+        for(uint32_t indx = 0; indx < block.count; ++indx) {
+            offset += getVarint(cursor);
+            usec   += unzigzag(getVarint(cursor));
+            long    other = static_cast<long>(unzigzag(getVarint(cursor)));
+            SYSCALL call  = static_cast<SYSCALL>(*cursor++);
+            FDEVENT kind  = static_cast<FDEVENT>(*cursor++);
+            if((fromUsec >= 0 && usec < fromUsec) || (toUsec >= 0 && usec > toUsec)) {
+                continue;
+            }
+            visit(offset, usec, other, call, kind);
+        }
+    }
+}
+
+/******************* public function ********************************/
+TraceIndex::TraceIndex(
+) : mFd(-1)
+  , mEvents(0) {
+}
+
+TraceIndex::~TraceIndex() {
+    if(mFd >= 0) {
+        ::close(mFd);
+    }
+}
+
+void
+TraceIndex::reset(
+    const std::string & path
+) {
+    if(mFd >= 0) {
+        ::close(mFd);
+        mFd = -1;
+    }
+    mPath = path;
+    struct stat info;
+    if(stat(path.c_str(), &info) == 0 && S_ISREG(info.st_mode)) {
+        mFd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    }
+    mEvents = 0;
+    std::unordered_map<long, PostingList>().swap(mByFd);
+    std::unordered_map<pid_t, PostingList>().swap(mByTid);
+}
+
+void
+TraceIndex::add(
+    const FdEvent & event
+) {
+    if(event.fd < 0) {
+        return ;
+    }
+    mByFd[event.fd].append(event, event.pid);
+    mByTid[event.pid].append(event, event.fd);
+    ++mEvents;
+}
+
+std::vector<TraceIndex::Hit>
+TraceIndex::find(
+    const Query &   query
+) const {
+    std::vector<Hit> hits;
+    auto keep = [&](uint64_t offset, long long usec, pid_t tid, long fd, SYSCALL call, FDEVENT kind) {
+        if((query.call != SYSCALL::UNKNOWN && call != query.call)
+           || (query.tid >= 0 && tid != query.tid) || (query.fd >= 0 && fd != query.fd)) {
+            return ;
+        }
+        Hit hit;
+        hit.offset = offset;
+        hit.usec   = usec;
+        hit.tid    = tid;
+        hit.fd     = fd;
+        hit.call   = call;
+        hit.kind   = kind;
+        hits.push_back(hit);
+    };
+
+    if(query.fd >= 0) {
+        auto it = mByFd.find(query.fd);
+        if(it != mByFd.end()) {
+            it->second.scan(query.fromUsec, query.toUsec,
+                            [&](uint64_t offset, long long usec, long other, SYSCALL call, FDEVENT kind){
+                keep(offset, usec, static_cast<pid_t>(other), query.fd, call, kind);
+            });
+        }
+        return hits;
+    }
+
+    auto scanTid = [&](pid_t tid, const PostingList & list) {
+        list.scan(query.fromUsec, query.toUsec,
+                  [&](uint64_t offset, long long usec, long other, SYSCALL call, FDEVENT kind){
+            keep(offset, usec, tid, other, call, kind);
+        });
+    };
+    if(query.tid >= 0) {
+        auto it = mByTid.find(query.tid);
+        if(it != mByTid.end()) {
+            scanTid(query.tid, it->second);
+        }
+        return hits;
+    }
+
+    // neither key: every tid list, merged back into trace order
+    for(const auto & element : mByTid) {
+        scanTid(element.first, element.second);
+    }
+    std::sort(hits.begin(), hits.end(), [](const Hit & lhs, const Hit & rhs){
+        return lhs.offset != rhs.offset ? lhs.offset < rhs.offset : lhs.fd < rhs.fd;
+    });
+    return hits;
+}
+
+std::vector<pid_t>
+TraceIndex::tids(
+    long    fd
+) const {
+    std::vector<pid_t> result;
+    auto it = mByFd.find(fd);
+    if(it == mByFd.end()) {
+        return result;
+    }
+    it->second.scan(-1, -1, [&](uint64_t, long long, long other, SYSCALL, FDEVENT){
+        result.push_back(static_cast<pid_t>(other));
+    });
+    std::sort(result.begin(), result.end());
+    result.erase(std::unique(result.begin(), result.end()), result.end());
+    return result;
+}
+
+bool
+TraceIndex::line(
+    const Hit &     hit,
+    std::string &   text
+) const {
+    text.clear();
+    if(mFd < 0) {
+        return false;
+    }
+    char        buffer[512];
+    uint64_t    offset = hit.offset;
+    for(;;) {
+        ssize_t bytes = ::pread(mFd, buffer, sizeof(buffer), static_cast<off_t>(offset));
+        if(bytes <= 0) {
+            return !text.empty();
+        }
+        const char * end = static_cast<const char *>(memchr(buffer, '\n', static_cast<size_t>(bytes)));
+        if(end) {
+            text.append(buffer, static_cast<size_t>(end - buffer));
+            return true;
+        }
+        text.append(buffer, static_cast<size_t>(bytes));
+        offset += static_cast<uint64_t>(bytes);
+    }
+}
+
+size_t
+TraceIndex::bytes() const {
+    size_t total = 0;
+    for(const auto & element : mByFd) {
+        total += element.second.data.size() + element.second.blocks.size() * sizeof(Block);
+    }
+    for(const auto & element : mByTid) {
+        total += element.second.data.size() + element.second.blocks.size() * sizeof(Block);
+    }
+    return total;
+}
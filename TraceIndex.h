@@ -0,0 +1,106 @@
+#ifndef _TRACEINDEX_H_
+#define _TRACEINDEX_H_
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <unordered_map>
+
+#include <sys/types.h>
+
+#include "FdEvent.h"
+
+// Posting lists of fd events, per fd number and per tid, built while
+// DescriptorMatch applies the trace; follow-up questions are then answered
+// from the lists without another pass.
+//
+// A posting is the byte offset of the event line plus its time, call, kind
+// and the other key (the tid in fd lists, the fd in tid lists):
+//
+//   varint  offset delta     zigzag  usec delta     zigzag  other key
+//   u8      call             u8      kind
+//
+// Deltas restart every BLOCKLEN postings; each block keeps its first offset
+// and time and its time range, so a time filter skips whole blocks.
+// Usually 5-8 bytes per posting, two postings per event.
+//
+// Only fd table events are indexed (what FdEventBuilder emits); reads and
+// writes on an fd are not. A close_range is filed under its first fd.
+class TraceIndex {
+public:
+    struct Query {
+        long        fd       = -1;      // -1: any
+        pid_t       tid      = -1;
+        long long   fromUsec = -1;      // inclusive bounds, -1: open
+        long long   toUsec   = -1;
+        SYSCALL     call     = SYSCALL::UNKNOWN;
+    };
+
+    struct Hit {
+        uint64_t    offset  = 0;        // of the line in the trace file
+        long long   usec    = -1;
+        pid_t       tid     = -1;
+        long        fd      = -1;
+        SYSCALL     call    = SYSCALL::UNKNOWN;
+        FDEVENT     kind    = FDEVENT::OPEN;
+    };
+
+public:
+    TraceIndex();
+    ~TraceIndex();
+    TraceIndex(const TraceIndex &) = delete;
+    TraceIndex& operator=(const TraceIndex &) = delete;
+
+    // Empties the index; `path` is the trace the lines are read back from.
+    void    reset(const std::string & path);
+    // Called in trace order, from one thread.
+    void    add(const FdEvent & event);
+
+    // Matching events in trace order. Queries may run concurrently once
+    // the run that fills the index is over.
+    std::vector<Hit>    find(const Query & query) const;
+    // Tids with events on `fd`, ascending.
+    std::vector<pid_t>  tids(long fd) const;
+
+    // Reads the trace line of `hit` from disk. strace -ff input has no
+    // single file to read from; false then.
+    bool    line(const Hit & hit, std::string & text) const;
+
+    size_t  events() const {
+        return mEvents;
+    }
+    // Encoded bytes over all lists, block tables included.
+    size_t  bytes() const;
+
+private:
+    struct Block {
+        uint64_t    offset;         // first posting, absolute
+        long long   usec;
+        long long   minUsec;
+        long long   maxUsec;
+        uint64_t    pos;            // into PostingList::data
+        uint32_t    count;
+    };
+
+    struct PostingList {
+        std::vector<uint8_t>    data;
+        std::vector<Block>      blocks;
+        uint64_t    lastOffset = 0;
+        long long   lastUsec   = 0;
+
+        void    append(const FdEvent & event, long other);
+
+        template<typename Visit>
+        void    scan(long long fromUsec, long long toUsec, Visit visit) const;
+    };
+
+    static const uint32_t   BLOCKLEN = 128;
+
+    std::string     mPath;
+    int             mFd;            // trace file, for line()
+    size_t          mEvents;
+    std::unordered_map<long, PostingList>   mByFd;
+    std::unordered_map<pid_t, PostingList>  mByTid;
+};
+
+#endif
@@ -0,0 +1,439 @@
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <algorithm>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+
+#include "TraceInput.h"
+#include "threadlog.h"
+
+static std::atomic<IOBACKEND>   sDefaultBackend(IOBACKEND::AUTO);
+
+static ssize_t
+readAt(int fd, char * buffer, size_t bytes, uint64_t offset) {
+    size_t done = 0;
+    while(done < bytes) {
+        ssize_t count = ::pread(fd, buffer + done, bytes - done, static_cast<off_t>(offset + done));
+        if(count < 0 && errno == EINTR) {
+            continue;
+        }
+        if(count < 0) {
+            return done > 0 ? static_cast<ssize_t>(done) : -1;
+        }
+        if(count == 0) {
+            break;
+        }
+        done += static_cast<size_t>(count);
+    }
+    return static_cast<ssize_t>(done);
+}
+
+/******************* TraceInput ********************************/
+TraceInput::~TraceInput() {
+    if(mFd >= 0) {
+        ::close(mFd);
+    }
+}
+
+std::unique_ptr<TraceInput>
+TraceInput::open(
+    const std::string & path,
+    IOBACKEND           backend
+) {
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if(fd < 0) {
+        return nullptr;
+    }
+    struct stat info;
+    if(fstat(fd, &info) != 0) {
+        ::close(fd);
+        return nullptr;
+    }
+    uint64_t size = static_cast<uint64_t>(info.st_size);
+
+    if(backend == IOBACKEND::AUTO) {
+        backend = getDefault();
+    }
+    // each input owns the fd once made, a failed one closes it: dup for the fallback
+    if(backend == IOBACKEND::AUTO || backend == IOBACKEND::MMAP) {
+        std::unique_ptr<MmapInput> input(new MmapInput(::dup(fd), size));
+        if(input->isMapped()) {
+            ::close(fd);
+            return input;
+        }
+        DEG_LOG("mmap of %s failed, pread instead", path.c_str());
+    } else if(backend == IOBACKEND::URING) {
+        std::unique_ptr<UringInput> input(new UringInput(::dup(fd), size));
+        if(input->isReady()) {
+            ::close(fd);
+            return input;
+        }
+        DEG_LOG("io_uring for %s failed, pread instead", path.c_str());
+    }
+    return std::unique_ptr<TraceInput>(new PreadInput(fd, size));
+}
+
+void
+TraceInput::setDefault(
+    IOBACKEND   backend
+) {
+    sDefaultBackend = backend;
+}
+
+IOBACKEND
+TraceInput::getDefault() {
+    return sDefaultBackend;
+}
+
+IOBACKEND
+TraceInput::backendOf(
+    const std::string & name
+) {
+    for(IOBACKEND backend : {IOBACKEND::MMAP, IOBACKEND::URING, IOBACKEND::PREAD}) {
+        if(name == TraceInput::name(backend)) {
+            return backend;
+        }
+    }
+    return IOBACKEND::AUTO;
+}
+
+const char *
+TraceInput::name(
+    IOBACKEND   backend
+) {
+    static const char * names[] = {"auto", "mmap", "uring", "pread"};
+    size_t indx = static_cast<size_t>(backend);
+    return indx < sizeof(names) / sizeof(names[0]) ? names[indx] : "auto";
+}
+
+/******************* MmapInput ********************************/
+MmapInput::MmapInput(
+    int         fd,
+    uint64_t    size
+) : mpBase(nullptr)
+  , mPosition(0)
+  , mReleased(0) {
+    mFd      = fd;
+    mSize    = size;
+    mBackend = IOBACKEND::MMAP;
+    if(fd < 0 || size == 0) {
+        return ;
+    }
+    void *base = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if(base == MAP_FAILED) {
+        return ;
+    }
+    // read ahead aggressively, release() drops behind; huge pages only
+    // where the file system supports them for the page cache, a hint otherwise
+    madvise(base, size, MADV_SEQUENTIAL);
+#ifdef MADV_HUGEPAGE
+    madvise(base, size, MADV_HUGEPAGE);
+#endif
+    mpBase = static_cast<const char *>(base);
+}
+
+MmapInput::~MmapInput() {
+    if(mpBase) {
+        munmap(const_cast<char *>(mpBase), mSize);
+    }
+}
+
+std::string_view
+MmapInput::next() {
+    if(!mpBase || mPosition >= mSize) {
+        return std::string_view();
+    }
+    std::string_view block(mpBase + mPosition, mSize - mPosition);
+    mPosition = mSize;
+    return block;
+}
+
+bool
+MmapInput::seek(
+    uint64_t    offset
+) {
+    if(offset > mSize) {
+        return false;
+    }
+    mPosition = offset;
+    return true;
+}
+
+void
+MmapInput::release(
+    uint64_t    offset
+) {
+    // MADV_SEQUENTIAL keeps read pages mapped: resident memory would grow
+    // with the trace. A page touched again is read back from the file.
+    uint64_t end = std::min(offset, mSize) / RELEASEBYTES * RELEASEBYTES;
+    if(!mpBase || end <= mReleased) {
+        return ;
+    }
+    madvise(const_cast<char *>(mpBase) + mReleased, end - mReleased, MADV_DONTNEED);
+    mReleased = end;
+}
+
+/******************* PreadInput ********************************/
+PreadInput::PreadInput(
+    int         fd,
+    uint64_t    size
+) : mBuffer(new char[BLOCKBYTES])
+  , mPosition(0) {
+    mFd      = fd;
+    mSize    = size;
+    mBackend = IOBACKEND::PREAD;
+}
+
+PreadInput::~PreadInput() {
+}
+
+std::string_view
+PreadInput::next() {
+    ssize_t count = readAt(mFd, mBuffer.get(), BLOCKBYTES, mPosition);
+    if(count < 0) {
+        std::cerr<<"trace read failed: "<<std::strerror(errno)<<std::endl;
+        return std::string_view();
+    }
+    mPosition += static_cast<uint64_t>(count);
+    return std::string_view(mBuffer.get(), static_cast<size_t>(count));
+}
+
+bool
+PreadInput::seek(
+    uint64_t    offset
+) {
+    if(offset > mSize) {
+        return false;
+    }
+    mPosition = offset;
+    return true;
+}
+
+/******************* UringInput ********************************/
+UringInput::UringInput(
+    int         fd,
+    uint64_t    size
+) : mRingFd(-1)
+  , mpRing(MAP_FAILED)
+  , mRingBytes(0)
+  , mpEntries(MAP_FAILED)
+  , mEntryBytes(0)
+  , mpSqTail(nullptr), mpSqMask(nullptr), mpSqArray(nullptr)
+  , mpCqHead(nullptr), mpCqTail(nullptr), mpCqMask(nullptr)
+  , mpCqes(nullptr)
+  , mSlots(QUEUEDEPTH)
+  , mNextRead(0)
+  , mCurrent(0)
+  , mHanded(false) {
+    mFd      = fd;
+    mSize    = size;
+    mBackend = IOBACKEND::URING;
+    for(auto & slot : mSlots) {
+        slot.buffer.reset(new char[BLOCKBYTES]);
+    }
+    if(fd < 0 || !setup()) {
+        if(mRingFd >= 0) {
+            ::close(mRingFd);
+        }
+        mRingFd = -1;
+        return ;
+    }
+    seek(0);
+}
+
+UringInput::~UringInput() {
+    if(mRingFd >= 0) {
+        drain();
+    }
+    if(mpEntries != MAP_FAILED) {
+        munmap(mpEntries, mEntryBytes);
+    }
+    if(mpRing != MAP_FAILED) {
+        munmap(mpRing, mRingBytes);
+    }
+    if(mRingFd >= 0) {
+        ::close(mRingFd);
+    }
+}
+
+std::string_view
+UringInput::next() {
+    if(mRingFd < 0) {
+        return std::string_view();
+    }
+    if(mHanded) {
+        // the block handed out last is parsed: its buffer reads ahead again
+        mHanded = false;
+        if(mNextRead < mSize) {
+            // a block that cannot be read fails in its turn below
+            submit(mCurrent);
+        }
+        mCurrent = (mCurrent + 1) % mSlots.size();
+    }
+    Slot & slot = mSlots[mCurrent];
+    if(!slot.queued || !reap(mCurrent)) {
+        return std::string_view();
+    }
+    slot.queued = false;
+    if(slot.result < 0) {
+        std::cerr<<"trace read failed: "<<std::strerror(static_cast<int>(-slot.result))<<std::endl;
+        return std::string_view();
+    }
+    size_t wanted = static_cast<size_t>(std::min<uint64_t>(BLOCKBYTES, mSize - slot.offset));
+    if(static_cast<size_t>(slot.result) < wanted) {
+        // short read: the rest synchronously, the order of blocks depends on it
+        ssize_t more = readAt(mFd, slot.buffer.get() + slot.result, wanted - slot.result,
+                              slot.offset + slot.result);
+        slot.result += more > 0 ? more : 0;
+    }
+    mHanded = true;
+    return std::string_view(slot.buffer.get(), static_cast<size_t>(slot.result));
+}
+
+bool
+UringInput::seek(
+    uint64_t    offset
+) {
+    if(mRingFd < 0 || offset > mSize) {
+        return false;
+    }
+    drain();
+    for(auto & slot : mSlots) {
+        slot.queued = false;
+    }
+    mNextRead = offset;
+    mCurrent  = 0;
+    mHanded   = false;
+    for(size_t indx = 0; indx < mSlots.size() && mNextRead < mSize; ++indx) {
+        if(!submit(indx)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/******************* UringInput private ********************************/
+bool
+UringInput::setup() {
+    struct io_uring_params params;
+    std::memset(&params, 0, sizeof(params));
+    long ring = syscall(__NR_io_uring_setup, static_cast<unsigned>(QUEUEDEPTH), &params);
+    if(ring < 0) {
+        return false;
+    }
+    mRingFd = static_cast<int>(ring);
+    // one mapping for both rings since 5.4; older kernels take pread
+    if(!(params.features & IORING_FEAT_SINGLE_MMAP)) {
+        return false;
+    }
+    mRingBytes = std::max<size_t>(params.sq_off.array + params.sq_entries * sizeof(unsigned),
+                                  params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe));
+    mpRing = mmap(nullptr, mRingBytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                  mRingFd, IORING_OFF_SQ_RING);
+    if(mpRing == MAP_FAILED) {
+        return false;
+    }
+    mEntryBytes = params.sq_entries * sizeof(struct io_uring_sqe);
+    mpEntries = mmap(nullptr, mEntryBytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                     mRingFd, IORING_OFF_SQES);
+    if(mpEntries == MAP_FAILED) {
+        return false;
+    }
+
+    char *base = static_cast<char *>(mpRing);
+    mpSqTail  = reinterpret_cast<unsigned *>(base + params.sq_off.tail);
+    mpSqMask  = reinterpret_cast<unsigned *>(base + params.sq_off.ring_mask);
+    mpSqArray = reinterpret_cast<unsigned *>(base + params.sq_off.array);
+    mpCqHead  = reinterpret_cast<unsigned *>(base + params.cq_off.head);
+    mpCqTail  = reinterpret_cast<unsigned *>(base + params.cq_off.tail);
+    mpCqMask  = reinterpret_cast<unsigned *>(base + params.cq_off.ring_mask);
+    mpCqes    = base + params.cq_off.cqes;
+    return true;
+}
+
+bool
+UringInput::submit(
+    size_t  indx
+) {
+    Slot & slot = mSlots[indx];
+    slot.offset = mNextRead;
+    slot.vector.iov_base = slot.buffer.get();
+    slot.vector.iov_len  = static_cast<size_t>(std::min<uint64_t>(BLOCKBYTES, mSize - mNextRead));
+    mNextRead += slot.vector.iov_len;
+
+    // the only submitter: the tail is ours, the kernel moves the head
+    unsigned tail  = *mpSqTail;
+    unsigned entry = tail & *mpSqMask;
+    struct io_uring_sqe * sqe = static_cast<struct io_uring_sqe *>(mpEntries) + entry;
+    std::memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode    = IORING_OP_READV;   // 5.1; IORING_OP_READ needs 5.6
+    sqe->fd        = mFd;
+    sqe->addr      = reinterpret_cast<uint64_t>(&slot.vector);
+    sqe->len       = 1;
+    sqe->off       = slot.offset;
+    sqe->user_data = indx;
+    mpSqArray[entry] = entry;
+    __atomic_store_n(mpSqTail, tail + 1, __ATOMIC_RELEASE);
+
+    long submitted;
+    do {
+        submitted = syscall(__NR_io_uring_enter, mRingFd, 1u, 0u, 0u, nullptr, 0);
+    } while(submitted < 0 && errno == EINTR);
+    slot.queued = true;
+    if(submitted < 0) {
+        // nothing was consumed: take the entry back and read the block
+        // synchronously, a gap here would look like the end of the trace
+        DEG_LOG("io_uring submit failed: %s, pread instead", std::strerror(errno));
+        __atomic_store_n(mpSqTail, tail, __ATOMIC_RELEASE);
+        ssize_t count = readAt(mFd, slot.buffer.get(), slot.vector.iov_len, slot.offset);
+        slot.result = count < 0 ? -errno : count;
+        slot.busy   = false;
+        return count >= 0;
+    }
+    slot.busy   = true;
+    return true;
+}
+
+bool
+UringInput::reap(
+    size_t  indx
+) {
+    // completions of other slots are recorded on the way
+    while(mSlots[indx].busy) {
+        unsigned head = *mpCqHead;
+        unsigned tail = __atomic_load_n(mpCqTail, __ATOMIC_ACQUIRE);
+        if(head == tail) {
+            long waited = syscall(__NR_io_uring_enter, mRingFd, 0u, 1u, IORING_ENTER_GETEVENTS, nullptr, 0);
+            if(waited < 0 && errno != EINTR) {
+                std::cerr<<"io_uring wait failed: "<<std::strerror(errno)<<std::endl;
+                return false;
+            }
+            continue;
+        }
+        const struct io_uring_cqe & cqe = static_cast<const struct io_uring_cqe *>(mpCqes)[head & *mpCqMask];
+        if(cqe.user_data < mSlots.size()) {
+            Slot & done  = mSlots[cqe.user_data];
+            done.result  = cqe.res;
+            done.busy    = false;
+        }
+        __atomic_store_n(mpCqHead, head + 1, __ATOMIC_RELEASE);
+    }
+    return true;
+}
+
+void
+UringInput::drain() {
+    // buffers still being read must not be reused or freed
+    for(size_t indx = 0; indx < mSlots.size(); ++indx) {
+        if(!reap(indx)) {
+            return ;
+        }
+    }
+}
@@ -0,0 +1,159 @@
+#ifndef _TRACEINPUT_H_
+#define _TRACEINPUT_H_
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <string_view>
+
+#include <sys/uio.h>
+
+enum class IOBACKEND : uint8_t {
+    AUTO,       // mmap, pread where mapping fails
+    MMAP,
+    URING,
+    PREAD
+};
+
+// Bytes of one trace file, read front to back in blocks.
+//
+//   MMAP   the whole file mapped once, MADV_SEQUENTIAL and MADV_HUGEPAGE;
+//          a block is the rest of the mapping and stays valid until
+//          release() passes it, so lines can be parsed in place
+//   URING  io_uring with QUEUEDEPTH reads of BLOCKBYTES in flight ahead
+//          of the block being parsed
+//   PREAD  one BLOCKBYTES pread at a time
+//
+// A backend that can not start (no io_uring in the kernel or the seccomp
+// profile, a file that can not be mapped) falls back to PREAD.
+class TraceInput {
+public:
+    virtual ~TraceInput();
+
+    // Next block from the current position, empty at the end or on a read
+    // error. Valid until the next call of next() or seek(), except for
+    // stable() inputs.
+    virtual std::string_view    next() = 0;
+    // Continues at byte `offset`; false past the end.
+    virtual bool    seek(uint64_t offset) = 0;
+    // Blocks live as long as the input, up to release().
+    virtual bool    stable() const {
+        return false;
+    }
+    // Nothing before byte `offset` is read again: a stable input gives
+    // the memory of those bytes back. Blocks of other inputs die anyway.
+    virtual void    release(uint64_t offset) {
+        (void)offset;
+    }
+
+    uint64_t    size() const {
+        return mSize;
+    }
+    IOBACKEND   backend() const {
+        return mBackend;
+    }
+
+    // nullptr when `path` can not be opened.
+    static std::unique_ptr<TraceInput>  open(const std::string & path, IOBACKEND backend = IOBACKEND::AUTO);
+
+    // Backend of every open() with AUTO, for all engines; AUTO by default.
+    static void         setDefault(IOBACKEND backend);
+    static IOBACKEND    getDefault();
+    // "auto", "mmap", "uring", "pread"; AUTO for an unknown name.
+    static IOBACKEND    backendOf(const std::string & name);
+    static const char * name(IOBACKEND backend);
+
+protected:
+    static constexpr size_t BLOCKBYTES  = 1u << 20;
+    static constexpr size_t QUEUEDEPTH  = 4;
+
+    int         mFd = -1;
+    uint64_t    mSize = 0;
+    IOBACKEND   mBackend = IOBACKEND::PREAD;
+};
+
+class MmapInput : public TraceInput {
+public:
+    MmapInput(int fd, uint64_t size);
+    ~MmapInput();
+
+    bool    isMapped() const {
+        return mSize == 0 || mpBase != nullptr;
+    }
+
+    std::string_view    next() override;
+    bool    seek(uint64_t offset) override;
+    bool    stable() const override {
+        return true;
+    }
+    void    release(uint64_t offset) override;
+
+private:
+    static constexpr uint64_t   RELEASEBYTES = 8ull << 20;  // unmapped at once, page aligned
+
+    const char  *mpBase;
+    uint64_t    mPosition;
+    uint64_t    mReleased;          // bytes before it are unmapped
+};
+
+class PreadInput : public TraceInput {
+public:
+    PreadInput(int fd, uint64_t size);
+    ~PreadInput();
+
+    std::string_view    next() override;
+    bool    seek(uint64_t offset) override;
+
+private:
+    std::unique_ptr<char[]> mBuffer;
+    uint64_t    mPosition;
+};
+
+// Raw io_uring syscalls, no liburing. Blocks complete in any order and are
+// handed out in file order; each one handed out is read again, QUEUEDEPTH
+// blocks further on, at the next call.
+class UringInput : public TraceInput {
+public:
+    UringInput(int fd, uint64_t size);
+    ~UringInput();
+
+    bool    isReady() const {
+        return mRingFd >= 0;
+    }
+
+    std::string_view    next() override;
+    bool    seek(uint64_t offset) override;
+
+private:
+    struct Slot {
+        std::unique_ptr<char[]> buffer;
+        struct iovec    vector;     // read by the kernel until the completion
+        uint64_t    offset = 0;
+        long        result = 0;     // bytes read, -errno
+        bool        queued = false; // holds a block not handed out yet
+        bool        busy = false;   // submitted, not reaped
+    };
+
+    bool    setup();
+    bool    submit(size_t slot);
+    bool    reap(size_t slot);
+    void    drain();
+
+private:
+    int         mRingFd;
+    void        *mpRing;            // SQ and CQ rings, one mapping
+    size_t      mRingBytes;
+    void        *mpEntries;         // SQEs
+    size_t      mEntryBytes;
+    unsigned    *mpSqTail, *mpSqMask, *mpSqArray;
+    unsigned    *mpCqHead, *mpCqTail, *mpCqMask;
+    void        *mpCqes;
+
+    std::vector<Slot>   mSlots;
+    uint64_t    mNextRead;          // offset of the next block to submit
+    size_t      mCurrent;           // slot handed out by next(), resubmitted later
+    bool        mHanded;
+};
+
+#endif
@@ -0,0 +1,288 @@
+#include <algorithm>
+#include <iostream>
+
+#include <dirent.h>
+#include <sys/stat.h>
+
+#include "TraceReader.h"
+#include "SyscallLine.h"
+
+/******************* TraceReader ********************************/
+std::unique_ptr<TraceReader>
+TraceReader::open(
+    const std::string & path,
+    ThreadPool *        pool
+) {
+    struct stat info;
+    if(stat(path.c_str(), &info) == 0 && S_ISREG(info.st_mode)) {
+        std::unique_ptr<FileReader> reader(new FileReader(path));
+        if(!reader->isOpen()) {
+            return nullptr;
+        }
+        return reader;
+    }
+
+    auto sources = TraceMerger::discover(path);
+    if(sources.empty()) {
+        return nullptr;
+    }
+    DEG_LOG("merge %zu strace -ff files of %s", sources.size(), path.c_str());
+    return std::unique_ptr<TraceReader>(new TraceMerger(std::move(sources), pool));
+}
+
+/******************* FileReader ********************************/
+FileReader::FileReader(
+    const std::string & path,
+    IOBACKEND           backend
+) : mpInput(TraceInput::open(path, backend)) {
+    mSize = mpInput ? mpInput->size() : 0;
+}
+
+bool
+FileReader::next(
+    std::string &   line
+) {
+    std::string_view view;
+    if(!next(view)) {
+        return false;
+    }
+    line.assign(view.data(), view.size());
+    // a copy: the mapping behind it is not needed any more
+    mpInput->release(mConsumed);
+    return true;
+}
+
+bool
+FileReader::next(
+    std::string_view &  line
+) {
+    if(!mpInput) {
+        return false;
+    }
+    if(mCarried) {
+        mCarry.clear();
+        mCarried = false;
+    }
+    for(;;) {
+        size_t end = mBlock.find('\n');
+        if(end != std::string_view::npos) {
+            if(mCarry.empty()) {
+                line = mBlock.substr(0, end);
+            } else {
+                mCarry.append(mBlock.data(), end);
+                line = mCarry;
+                mCarried = true;
+            }
+            mBlock.remove_prefix(end + 1);
+            break;
+        }
+        mCarry.append(mBlock.data(), mBlock.size());
+        mBlock = mpInput->next();
+        if(mBlock.empty()) {
+            // last line without a newline
+            if(mCarry.empty()) {
+                return false;
+            }
+            line = mCarry;
+            mCarried = true;
+            break;
+        }
+    }
+    mConsumed += line.size() + 1;
+    return true;
+}
+
+bool
+FileReader::seek(
+    uint64_t    offset
+) {
+    if(!mpInput || !mpInput->seek(offset)) {
+        return false;
+    }
+    mBlock    = std::string_view();
+    mCarried  = false;
+    mCarry.clear();
+    mConsumed = offset;
+    return true;
+}
+
+/******************* TraceMerger ********************************/
+TraceMerger::TraceMerger(
+    std::vector<Source> sources,
+    ThreadPool *        pool
+) : mpThreadPool(pool) {
+    // double buffered: one batch being merged and one being read per file
+    uint64_t share = MERGEBUDGET / (2 * std::max<size_t>(sources.size(), 1));
+    mBatchBytes = std::min(MAXBATCH, std::max(MINBATCH, share));
+
+    for(auto & source : sources) {
+        mSize += source.size;
+        std::unique_ptr<Stream> stream(new Stream());
+        stream->source = std::move(source);
+        mStreams.push_back(std::move(stream));
+    }
+
+    for(size_t indx = 0; indx < mStreams.size(); ++indx) {
+        prefetch(indx);
+    }
+    for(size_t indx = 0; indx < mStreams.size(); ++indx) {
+        if(advance(indx)) {
+            mHeap.push(Head{mStreams[indx]->batch.front().usec, indx});
+        }
+    }
+}
+
+TraceMerger::~TraceMerger() {
+    // batches still being read point into the streams
+    for(auto & stream : mStreams) {
+        if(stream->pending.valid()) {
+            stream->pending.wait();
+        }
+    }
+}
+
+bool
+TraceMerger::next(
+    std::string &   line
+) {
+    if(mHeap.empty()) {
+        return false;
+    }
+    size_t   indx   = mHeap.top().stream;
+    Stream & stream = *mStreams[indx];
+    mHeap.pop();
+
+    Line & head = stream.batch[stream.pos];
+    line.swap(head.text);
+    mConsumed += head.bytes;
+
+    if(++stream.pos < stream.batch.size() || advance(indx)) {
+        mHeap.push(Head{stream.batch[stream.pos].usec, indx});
+    }
+    return true;
+}
+
+std::vector<TraceMerger::Source>
+TraceMerger::discover(
+    const std::string & path
+) {
+    // a directory takes every <name>.<pid> file in it, a prefix only its own
+    std::string directory = path;
+    std::string prefix;
+    struct stat info;
+    if(stat(path.c_str(), &info) != 0 || !S_ISDIR(info.st_mode)) {
+        size_t slash = path.rfind('/');
+        directory = slash == std::string::npos ? "." : path.substr(0, slash);
+        prefix    = slash == std::string::npos ? path : path.substr(slash + 1);
+    }
+
+    std::vector<Source> sources;
+    DIR *dir = opendir(directory.c_str());
+    if(!dir) {
+        return sources;
+    }
+    while(struct dirent *entry = readdir(dir)) {
+        std::string name = entry->d_name;
+        size_t dot = name.rfind('.');
+        if(dot == std::string::npos || dot + 1 == name.size()) {
+            continue;
+        }
+        if(!prefix.empty() && name.compare(0, dot, prefix) != 0) {
+            continue;
+        }
+        if(!std::all_of(name.begin() + dot + 1, name.end(), [](char ch){ return ch >= '0' && ch <= '9'; })) {
+            continue;
+        }
+
+        Source source;
+        source.path = directory + "/" + name;
+        if(stat(source.path.c_str(), &info) != 0 || !S_ISREG(info.st_mode)) {
+            continue;
+        }
+        source.pid  = static_cast<pid_t>(std::stol(name.substr(dot + 1)));
+        source.size = static_cast<uint64_t>(info.st_size);
+        sources.push_back(std::move(source));
+    }
+    closedir(dir);
+
+    std::sort(sources.begin(), sources.end(),
+              [](const Source & lhs, const Source & rhs){ return lhs.pid < rhs.pid; });
+    return sources;
+}
+
+TraceMerger::BatchPtr
+TraceMerger::readBatch(
+    Stream *    stream,
+    uint64_t    bytes
+) {
+    auto batch = std::make_shared<Batch>();
+    FileReader in(stream->source.path);
+    if(!in.isOpen() || !in.seek(stream->position)) {
+        std::cerr<<stream->source.path<<" does not exist!"<<std::endl;
+        stream->eof = true;
+        return batch;
+    }
+
+    std::string pid = std::to_string(stream->source.pid);
+    std::string_view line;
+    uint64_t    read = 0;
+    bool        more = true;
+    while(read < bytes && (more = in.next(line))) {
+        Line entry;
+        entry.bytes = line.size() + 1;
+        size_t space = line.find(' ');
+        long long usec = SyscallLine::toMicros(line.substr(0, space));
+        if(usec >= 0) {
+            stream->lastUsec = usec;
+        }
+        entry.usec = stream->lastUsec;
+        entry.text.reserve(pid.size() + 1 + line.size());
+        entry.text.append(pid).append(" ").append(line);
+
+        read += entry.bytes;
+        batch->push_back(std::move(entry));
+    }
+    stream->position += read;
+    if(!more || stream->position >= in.size()) {
+        stream->eof = true;
+    }
+    return batch;
+}
+
+void
+TraceMerger::prefetch(
+    size_t  indx
+) {
+    Stream * stream = mStreams[indx].get();
+    if(stream->eof) {
+        stream->pending = std::shared_future<BatchPtr>();
+        return ;
+    }
+    stream->pending = mpThreadPool->enqueue(readBatch, stream, mBatchBytes);
+}
+
+bool
+TraceMerger::advance(
+    size_t  indx
+) {
+    // swap in the batch read ahead and start reading the one after it
+    Stream & stream = *mStreams[indx];
+    while(stream.pending.valid()) {
+        BatchPtr batch;
+        try {
+            batch = stream.pending.get();
+        } catch(const std::future_error &) {
+            // purged by a cancel, the file ends here
+            stream.eof = true;
+        }
+        prefetch(indx);
+        if(batch && !batch->empty()) {
+            stream.batch.swap(*batch);
+            stream.pos = 0;
+            return true;
+        }
+    }
+    stream.batch.clear();
+    stream.pos = 0;
+    return false;
+}
@@ -0,0 +1,174 @@
+#ifndef _TRACEREADER_H_
+#define _TRACEREADER_H_
+
+#include <string>
+#include <vector>
+#include <queue>
+#include <memory>
+#include <future>
+#include <string_view>
+
+#include <sys/types.h>
+
+#include "ThreadPool.h"
+#include "TraceInput.h"
+
+// Line source of the analysis engines.
+//
+// Every line comes out in the `strace -f` form, pid first, whatever the
+// files on disk look like, so the parsers need not care.
+class TraceReader {
+public:
+    virtual ~TraceReader() = default;
+
+    virtual bool    next(std::string & line) = 0;
+    // The line in place where the reader can, copied otherwise; valid
+    // until the next call, or as long as the reader when stable().
+    virtual bool    next(std::string_view & line) {
+        if(!next(mLine)) {
+            return false;
+        }
+        line = mLine;
+        return true;
+    }
+    // Lines of next(std::string_view &) outlive the call and follow each
+    // other in memory, '\n' between them, as in the file.
+    virtual bool    stable() const {
+        return false;
+    }
+
+    // Continues at byte `offset` of the input, a line start; false when
+    // the reader can not seek (merged strace -ff input).
+    virtual bool    seek(uint64_t offset) {
+        (void)offset;
+        return false;
+    }
+    // Stable lines before byte `offset` are not used any more; callable
+    // from another thread than next(). Lines copied out need no call.
+    virtual void    release(uint64_t offset) {
+        (void)offset;
+    }
+
+    // Bytes on disk in total and consumed so far, for progress.
+    uint64_t    size() const {
+        return mSize;
+    }
+    uint64_t    consumed() const {
+        return mConsumed;
+    }
+
+    // `path` is a trace file, or the -o prefix / directory of an
+    // `strace -ff` run holding one <prefix>.<pid> file per task.
+    // Returns nullptr when nothing matches.
+    static std::unique_ptr<TraceReader> open(const std::string & path, ThreadPool * pool);
+
+protected:
+    uint64_t    mSize = 0;
+    uint64_t    mConsumed = 0;
+
+private:
+    std::string mLine;
+};
+
+// Single `strace -f` output file, split into lines from the blocks of a
+// TraceInput. Lines lie in place in the block, only one split between two
+// blocks is copied; over mmap every line is in place and stable.
+class FileReader : public TraceReader {
+public:
+    explicit FileReader(const std::string & path, IOBACKEND backend = IOBACKEND::AUTO);
+
+    using TraceReader::next;
+    bool    next(std::string & line) override;
+    bool    next(std::string_view & line) override;
+    bool    seek(uint64_t offset) override;
+    bool    stable() const override {
+        return mpInput && mpInput->stable();
+    }
+    void    release(uint64_t offset) override {
+        if(mpInput) {
+            mpInput->release(offset);
+        }
+    }
+    bool    isOpen() const {
+        return mpInput != nullptr;
+    }
+    IOBACKEND   backend() const {
+        return mpInput ? mpInput->backend() : IOBACKEND::AUTO;
+    }
+
+private:
+    std::unique_ptr<TraceInput> mpInput;
+    std::string_view    mBlock;         // rest of the current block
+    std::string         mCarry;         // a line split between two blocks
+    bool                mCarried = false;
+};
+
+// `strace -ff` output: one file per task and no pid column.
+//
+// Each file is read in batches on the ThreadPool, one batch in flight per
+// file, each line prefixed with the pid taken from the file name. The
+// batches are merged by timestamp through a min-heap holding the head line
+// of every file, ties going to the file listed first.
+class TraceMerger : public TraceReader {
+public:
+    struct Source {
+        std::string path;
+        pid_t       pid = -1;
+        uint64_t    size = 0;
+    };
+
+public:
+    TraceMerger(std::vector<Source> sources, ThreadPool * pool);
+    ~TraceMerger();
+
+    using TraceReader::next;
+    bool    next(std::string & line) override;
+
+    // <prefix>.<pid> files of `path`, sorted by pid; empty when none.
+    static std::vector<Source>  discover(const std::string & path);
+
+private:
+    struct Line {
+        long long   usec;           // untimed lines inherit the previous time
+        std::string text;
+        uint64_t    bytes;          // length on disk, newline included
+    };
+    using Batch = std::vector<Line>;
+    using BatchPtr = std::shared_ptr<Batch>;
+
+    struct Stream {
+        Source      source;
+        uint64_t    position = 0;   // next byte to read; files stay closed between batches
+        long long   lastUsec = -1;
+        bool        eof = false;
+        Batch       batch;
+        size_t      pos = 0;
+        std::shared_future<BatchPtr>    pending;
+    };
+
+    struct Head {
+        long long   usec;
+        size_t      stream;
+
+        friend bool operator>(const Head & lhs, const Head & rhs) {
+            return lhs.usec != rhs.usec ? lhs.usec > rhs.usec : lhs.stream > rhs.stream;
+        }
+    };
+
+    static BatchPtr readBatch(Stream * stream, uint64_t bytes);
+
+    void    prefetch(size_t indx);
+    bool    advance(size_t indx);
+
+private:
+    static constexpr uint64_t   MERGEBUDGET = 64ull << 20;  // buffered bytes over all files
+    static constexpr uint64_t   MINBATCH    = 16ull << 10;
+    static constexpr uint64_t   MAXBATCH    = 1ull << 20;
+
+    ThreadPool          *mpThreadPool;
+    uint64_t            mBatchBytes;
+    std::vector<std::unique_ptr<Stream>>    mStreams;
+    std::priority_queue<Head, std::vector<Head>, std::greater<Head>> mHeap;
+};
+
+#endif
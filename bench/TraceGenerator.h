@@ -0,0 +1,258 @@
+#ifndef _TRACEGENERATOR_H_
+#define _TRACEGENERATOR_H_
+
+#include <cstdio>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <random>
+#include <ostream>
+
+#include <sys/types.h>
+
+// Deterministic generator of `strace -f -tt -o` style output.
+// The same Options (seed included) always produce the same trace.
+class TraceGenerator {
+public:
+    struct Options {
+        size_t      lines       = 1000000;  // lines to emit
+        unsigned    threads     = 4;        // tids writing into the trace
+        double      churn       = 0.30;     // share of lines that open/dup/close fds
+        double      unfinished  = 0.05;     // share of syscalls split into unfinished/resumed
+        double      ebadf       = 0.001;    // share of close/dup that hit EBADF
+        bool        durations   = false;    // strace -T: "<0.000012>" after every result
+        unsigned    payloadMin  = 16;       // read/write payload length range
+        unsigned    payloadMax  = 128;
+        uint64_t    seed        = 2038;
+        pid_t       pid         = 2038;     // tid of the first thread, others follow
+    };
+
+public:
+    explicit TraceGenerator(const Options & options)
+        : mOptions(options)
+        , mRandom(options.seed)
+        , mUsec(10LL * 3600 * 1000000)
+        , mOpenFd(MAXFD, false) {
+        if(mOptions.threads == 0) {
+            mOptions.threads = 1;
+        }
+        if(mOptions.payloadMax < mOptions.payloadMin) {
+            mOptions.payloadMax = mOptions.payloadMin;
+        }
+        mPending.resize(mOptions.threads);
+        for(fd_type fd = 0; fd < 3; ++fd) {
+            mOpenFd[fd] = true;
+        }
+    }
+
+    // Writes the whole trace to `out`, returns the number of bytes written.
+    size_t  generate(std::ostream & out) {
+        size_t bytes = 0;
+        std::string line;
+        for(size_t nline = 0; nline < mOptions.lines; ++nline) {
+            next(line);
+            out << line << '\n';
+            bytes += line.size() + 1;
+        }
+        return bytes;
+    }
+
+    // Produces the next line of the trace (without the trailing newline).
+    void    next(std::string & line) {
+        mUsec += 1 + uniform(0, 40);
+        unsigned   slot = mOptions.threads > 1 ? uniform(0, mOptions.threads - 1) : 0;
+        pid_t      tid  = mOptions.pid + static_cast<pid_t>(slot);
+        std::string prefix = std::to_string(tid) + "  " + stamp() + " ";
+
+        Pending & pending = mPending[slot];
+        if(pending.active) {
+            pending.active = false;
+            line = prefix + "<... " + pending.name + " resumed> ) = " + pending.result + took();
+            return ;
+        }
+
+        std::string head, tail;
+        std::string name;
+        double roll = real();
+        if(roll < mOptions.churn) {
+            syscall(name, head, tail);
+        } else {
+            noise(name, head, tail);
+        }
+
+        if(mOptions.threads > 1 && real() < mOptions.unfinished) {
+            pending.active = true;
+            pending.name   = name;
+            pending.result = tail;
+            line = prefix + head + " <unfinished ...>";
+        } else {
+            line = prefix + head + ") = " + tail + took();
+        }
+    }
+
+private:
+    using fd_type = int;
+    static const fd_type    MAXFD = 1024;
+
+    struct Pending {
+        bool        active = false;
+        std::string name;
+        std::string result;
+    };
+
+    unsigned    uniform(unsigned lo, unsigned hi) {
+        return std::uniform_int_distribution<unsigned>(lo, hi)(mRandom);
+    }
+
+    double      real() {
+        return std::uniform_real_distribution<double>(0.0, 1.0)(mRandom);
+    }
+
+    std::string stamp() const {
+        long long sec  = mUsec / 1000000;
+        long long usec = mUsec % 1000000;
+        char buffer[32];
+        snprintf(buffer, sizeof(buffer), "%02lld:%02lld:%02lld.%06lld",
+                 (sec / 3600) % 24, (sec / 60) % 60, sec % 60, usec);
+        return buffer;
+    }
+
+    fd_type     lowestFree() const {
+        for(fd_type fd = 3; fd < MAXFD; ++fd) {
+            if(!mOpenFd[fd]) {
+                return fd;
+            }
+        }
+        return -1;
+    }
+
+    fd_type     randomOpen() {
+        std::vector<fd_type> open;
+        for(fd_type fd = 3; fd < MAXFD; ++fd) {
+            if(mOpenFd[fd]) {
+                open.push_back(fd);
+            }
+        }
+        if(open.empty()) {
+            return -1;
+        }
+        return open[uniform(0, open.size() - 1)];
+    }
+
+    fd_type     randomClosed() {
+        for(int attempt = 0; attempt < 16; ++attempt) {
+            fd_type fd = uniform(3, 64);
+            if(!mOpenFd[fd]) {
+                return fd;
+            }
+        }
+        return MAXFD - 1;
+    }
+
+    // " <seconds>" of -T: a few microseconds, one call in a thousand
+    // blocked for up to 100ms (close on NFS, SO_LINGER); nothing without
+    std::string took() {
+        if(!mOptions.durations) {
+            return std::string();
+        }
+        unsigned usec = real() < 0.001 ? uniform(1000, 100000) : uniform(1, 40);
+        char buffer[32];
+        snprintf(buffer, sizeof(buffer), " <%u.%06u>", usec / 1000000, usec % 1000000);
+        return buffer;
+    }
+
+    std::string payload() {
+        static const char alphabet[] = "abcdefghijklmnopqrstuvwxyz0123456789";
+        unsigned len = uniform(mOptions.payloadMin, mOptions.payloadMax);
+        std::string text(len, 'a');
+        for(auto & ch : text) {
+            ch = alphabet[uniform(0, sizeof(alphabet) - 2)];
+        }
+        return text;
+    }
+
+    // fd state changing syscalls: openat, dup, close (with optional EBADF)
+    void    syscall(std::string & name, std::string & head, std::string & tail) {
+        unsigned kind = uniform(0, 9);
+        bool     bad  = real() < mOptions.ebadf;
+
+        if(kind < 4 && !bad) {
+            fd_type fd = lowestFree();
+            name = "openat";
+            head = "openat(AT_FDCWD, \"/var/lib/service/" + std::to_string(uniform(0, 9999))
+                 + ".dat\", O_RDONLY|O_CLOEXEC";
+            if(fd < 0) {
+                tail = "-1 EMFILE (Too many open files)";
+            } else {
+                mOpenFd[fd] = true;
+                tail = std::to_string(fd);
+            }
+        } else if(kind < 5) {
+            fd_type fd = bad ? randomClosed() : randomOpen();
+            if(fd < 0) {
+                fd  = randomClosed();
+                bad = true;
+            }
+            fd_type nfd = bad ? -1 : lowestFree();
+            name = "dup";
+            head = "dup(" + std::to_string(fd);
+            if(bad) {
+                tail = "-1 EBADF (Bad file descriptor)";
+            } else if(nfd < 0) {
+                // a valid fd and a full table: the kernel says EMFILE
+                tail = "-1 EMFILE (Too many open files)";
+            } else {
+                mOpenFd[nfd] = true;
+                tail = std::to_string(nfd);
+            }
+        } else {
+            fd_type fd = bad ? randomClosed() : randomOpen();
+            name = "close";
+            if(fd < 0) {
+                fd  = randomClosed();
+                bad = true;
+            }
+            head = "close(" + std::to_string(fd);
+            if(bad) {
+                tail = "-1 EBADF (Bad file descriptor)";
+            } else {
+                mOpenFd[fd] = false;
+                tail = "0";
+            }
+        }
+    }
+
+    // syscalls that do not touch the fd table
+    void    noise(std::string & name, std::string & head, std::string & tail) {
+        unsigned kind = uniform(0, 3);
+        if(kind == 0) {
+            std::string data = payload();
+            fd_type fd = randomOpen();
+            name = "read";
+            head = "read(" + std::to_string(fd < 0 ? 0 : fd) + ", \"" + data + "\"..., 4096";
+            tail = std::to_string(data.size());
+        } else if(kind == 1) {
+            std::string data = payload();
+            name = "write";
+            head = "write(1, \"" + data + "\", " + std::to_string(data.size());
+            tail = std::to_string(data.size());
+        } else if(kind == 2) {
+            name = "futex";
+            head = "futex(0x7f3a5c0008e0, FUTEX_WAKE_PRIVATE, 1";
+            tail = "0";
+        } else {
+            name = "mmap";
+            head = "mmap(NULL, 8192, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS, -1, 0";
+            tail = "0x7f3a5d2b4000";
+        }
+    }
+
+private:
+    Options                 mOptions;
+    std::mt19937_64         mRandom;
+    long long               mUsec;
+    std::vector<bool>       mOpenFd;
+    std::vector<Pending>    mPending;
+};
+
+#endif
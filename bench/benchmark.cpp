@@ -0,0 +1,591 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+#include <ctime>
+#include <atomic>
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "FileDescriptor.h"
+#include "DescriptorMatch.h"
+#include "Exporter.h"
+#include "TraceIndex.h"
+#include "TraceDiff.h"
+#include "LatencyStats.h"
+#include "TraceInput.h"
+#include "TraceReader.h"
+#include "HandlerThread.h"
+#include "ThreadPool.h"
+#include "MemoryStats.h"
+#include "TraceGenerator.h"
+
+// Every measurement is printed as one JSON object per line on stdout:
+// {"bench":"process","threads":4,"items":...,"seconds":...,"rate":...,"unit":"lines/s","peak_rss_kb":...}
+
+using Clock = std::chrono::steady_clock;
+
+static double
+elapsed(Clock::time_point begin) {
+    return std::chrono::duration<double>(Clock::now() - begin).count();
+}
+
+// Resets VmHWM so that every benchmark reports its own peak (Linux >= 4.0).
+static void
+resetPeakRss() {
+    std::ofstream refs("/proc/self/clear_refs");
+    if(refs.is_open()) {
+        refs << "5";
+    }
+    MemoryStats::getInstance()->resetPeaks();
+}
+
+static long
+peakRssKb() {
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    while(std::getline(status, line)) {
+        if(line.compare(0, 6, "VmHWM:") == 0) {
+            return std::strtol(line.c_str() + 6, nullptr, 10);
+        }
+    }
+    return -1;
+}
+
+static void
+report(const char * bench, unsigned threads, double items, double seconds, const char * unit,
+       const std::string & extra = std::string()) {
+    std::printf("{\"bench\":\"%s\",\"threads\":%u,\"items\":%.0f,\"seconds\":%.6f,"
+                "\"rate\":%.1f,\"unit\":\"%s\",\"peak_rss_kb\":%ld%s,\"memory\":%s}\n",
+                bench, threads, items, seconds, seconds > 0 ? items / seconds : 0.0,
+                unit, peakRssKb(), extra.c_str(), MemoryStats::json(MemoryStats::getInstance()->usage()).c_str());
+    std::fflush(stdout);
+}
+
+// `budget` bytes of fd history in memory, the rest spills to disk; with
+// `triage`, only up to the first that many incidents.
+static void
+benchProcess(const std::string & path, pid_t pid, unsigned threads, size_t bytes,
+             size_t budget = 256u << 20, size_t triage = 0) {
+    FileDescriptor * instance = FileDescriptor::getInstance();
+    instance->initResources(pid, path, threads);
+    instance->setMemoryBudget(budget);
+    instance->setTriage(triage);
+
+    resetPeakRss();
+    auto begin = Clock::now();
+    instance->process();
+    auto result = instance->getResult();
+    double seconds = elapsed(begin);
+    instance->setTriage(0);
+
+    char extra[224];
+    std::snprintf(extra, sizeof(extra), ",\"bytes\":%zu,\"mb_per_sec\":%.2f,\"bad_fds\":%zu,\"incidents\":%zu,\"budget\":%zu,\"triage\":%zu",
+                  bytes, seconds > 0 ? bytes / seconds / 1e6 : 0.0, result->badFds, result->incidents, budget, triage);
+    report(triage ? "process.triage" : "process", threads, static_cast<double>(bytes), seconds, "bytes/s", extra);
+}
+
+// Drops the clean page cache pages of `path`: the next read comes from disk.
+static void
+dropCache(const std::string & path) {
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if(fd >= 0) {
+        fdatasync(fd);
+        posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+        ::close(fd);
+    }
+}
+
+// Lines of the trace through one I/O backend, nothing parsed.
+static void
+benchRead(const std::string & path, IOBACKEND backend, bool cold, size_t bytes) {
+    if(cold) {
+        dropCache(path);
+    }
+    resetPeakRss();
+    auto begin = Clock::now();
+    FileReader reader(path, backend);
+    std::string_view line;
+    size_t lines = 0;
+    size_t sum   = 0;
+    while(reader.next(line)) {
+        ++lines;
+        sum += line.size();
+    }
+    double seconds = elapsed(begin);
+
+    char extra[192];
+    std::snprintf(extra, sizeof(extra), ",\"io\":\"%s\",\"cache\":\"%s\",\"lines\":%zu,\"mb_per_sec\":%.2f",
+                  TraceInput::name(reader.backend()), cold ? "cold" : "warm", lines,
+                  seconds > 0 ? bytes / seconds / 1e6 : 0.0);
+    report("read", 1, static_cast<double>(sum + lines), seconds, "bytes/s", extra);
+}
+
+static void
+benchMatch(const std::string & path, pid_t pid, unsigned threads, size_t bytes) {
+    DescriptorMatch match;
+    match.initResources(pid, path, threads);
+
+    resetPeakRss();
+    auto begin = Clock::now();
+    match.process();
+    auto result = match.getResult();
+    double seconds = elapsed(begin);
+
+    char extra[192];
+    std::snprintf(extra, sizeof(extra), ",\"bytes\":%zu,\"mb_per_sec\":%.2f,\"leaks\":%zu,\"opens\":%zu,\"io\":\"%s\"",
+                  bytes, seconds > 0 ? bytes / seconds / 1e6 : 0.0, result.leaks.size(), result.opens,
+                  TraceInput::name(TraceInput::getDefault()));
+    report("DescriptorMatch", threads, static_cast<double>(bytes), seconds, "bytes/s", extra);
+}
+
+// Trace against itself through TraceDiff: both matches at once on the
+// pool, to set against benchMatch of one trace.
+static void
+benchDiff(const std::string & path, pid_t pid, unsigned threads, size_t bytes) {
+    TraceDiff diff;
+    TraceDiff::Side side;
+    side.path = path;
+    side.pid  = pid;
+
+    resetPeakRss();
+    auto begin = Clock::now();
+    auto result = diff.run(side, side, threads);
+    double seconds = elapsed(begin);
+
+    char extra[160];
+    std::snprintf(extra, sizeof(extra), ",\"bytes\":%zu,\"changes\":%zu,\"before_seconds\":%.6f,\"after_seconds\":%.6f",
+                  2 * bytes, result.changes.size(), result.beforeSeconds, result.afterSeconds);
+    report("TraceDiff", threads, static_cast<double>(2 * bytes), seconds, "bytes/s", extra);
+}
+
+// Match pass streaming every event and lifetime into `path`; the
+// difference to benchMatch is the cost of the export.
+static void
+benchExport(const std::string & trace, const std::string & path, EXPORTFORMAT format, size_t bytes) {
+    static const char * names[] = {"jsonl", "csv", "binary"};
+    DescriptorMatch match;
+    match.initResources(-1, trace, 1);
+
+    resetPeakRss();
+    auto begin = Clock::now();
+    uint64_t written = 0;
+    {
+        Exporter exporter(path, format);
+        match.setExporter(&exporter, true);
+        match.process();
+        exporter.flush();
+        written = exporter.written();
+    }
+    double seconds = elapsed(begin);
+    std::remove(path.c_str());
+
+    char extra[160];
+    std::snprintf(extra, sizeof(extra), ",\"format\":\"%s\",\"bytes\":%zu,\"written\":%llu,\"out_mb_per_sec\":%.2f",
+                  names[static_cast<int>(format)], bytes, static_cast<unsigned long long>(written),
+                  seconds > 0 ? written / seconds / 1e6 : 0.0);
+    report("export", 1, static_cast<double>(bytes), seconds, "bytes/s", extra);
+}
+
+// Match pass that also builds the posting lists, then follow-up queries
+// against them; reports the build cost and the latency of each query.
+static void
+benchIndex(const std::string & trace, size_t bytes) {
+    TraceIndex index;
+    DescriptorMatch match;
+    match.initResources(-1, trace, 1);
+    match.setIndex(&index);
+
+    resetPeakRss();
+    auto begin = Clock::now();
+    match.process();
+    double seconds = elapsed(begin);
+    match.setIndex(nullptr);
+
+    char extra[192];
+    std::snprintf(extra, sizeof(extra), ",\"bytes\":%zu,\"events\":%zu,\"index_bytes\":%zu,\"bytes_per_event\":%.2f",
+                  bytes, index.events(), index.bytes(),
+                  index.events() ? 1.0 * index.bytes() / index.events() : 0.0);
+    report("index_build", 1, static_cast<double>(bytes), seconds, "bytes/s", extra);
+
+    // the busiest fd and tid of the trace, and a slice of its time span
+    auto all = index.find(TraceIndex::Query());
+    if(all.empty()) {
+        return ;
+    }
+    std::unordered_map<long, size_t>  fds;
+    std::unordered_map<pid_t, size_t> tids;
+    for(const auto & hit : all) {
+        ++fds[hit.fd];
+        ++tids[hit.tid];
+    }
+    auto busiest = [](const auto & counts) {
+        return std::max_element(counts.begin(), counts.end(),
+                                [](const auto & lhs, const auto & rhs){ return lhs.second < rhs.second; })->first;
+    };
+    long long first = all.front().usec;
+    long long last  = all.back().usec;
+
+    TraceIndex::Query byFd;
+    byFd.fd = busiest(fds);
+    TraceIndex::Query bySlice = byFd;
+    bySlice.fromUsec = first + (last - first) / 2;
+    bySlice.toUsec   = bySlice.fromUsec + 1000000;
+    TraceIndex::Query byTid;
+    byTid.tid  = busiest(tids);
+    byTid.call = SYSCALL::CLOSE;
+
+    const std::pair<const char *, TraceIndex::Query> queries[] = {
+        {"fd", byFd}, {"fd_1s", bySlice}, {"tid_close", byTid}
+    };
+    for(const auto & query : queries) {
+        begin = Clock::now();
+        auto hits = index.find(query.second);
+        std::string line;
+        for(size_t indx = 0; indx < hits.size() && indx < 10; ++indx) {
+            index.line(hits[indx], line);
+        }
+        seconds = elapsed(begin);
+        std::snprintf(extra, sizeof(extra), ",\"query\":\"%s\",\"hits\":%zu,\"usec\":%.1f",
+                      query.first, hits.size(), seconds * 1e6);
+        report("index_query", 1, static_cast<double>(hits.size()), seconds, "hits/s", extra);
+    }
+    begin = Clock::now();
+    size_t threads = index.tids(byFd.fd).size();
+    seconds = elapsed(begin);
+    std::snprintf(extra, sizeof(extra), ",\"query\":\"tids_of_fd\",\"hits\":%zu,\"usec\":%.1f",
+                  threads, seconds * 1e6);
+    report("index_query", 1, static_cast<double>(threads), seconds, "hits/s", extra);
+}
+
+static void
+benchRegex(const std::vector<std::string> & lines) {
+    resetPeakRss();
+    size_t matched = 0;
+    auto begin = Clock::now();
+    for(const auto & line : lines) {
+        if(std::get<0>(FileDescriptor::regexProcess(FilePattern::Close_BadFile, line)) != -1) {
+            ++matched;
+        }
+        if(std::get<0>(FileDescriptor::regexProcess(FilePattern::Open_Whole, line)) != -1) {
+            ++matched;
+        }
+    }
+    double seconds = elapsed(begin);
+    report("regexProcess", 1, static_cast<double>(lines.size()), seconds, "lines/s",
+           ",\"matched\":" + std::to_string(matched));
+}
+
+// FdCall::fromLine on the sampled lines as they are and with a -T
+// duration appended, and LatencyStats::add on the timed calls: what -T
+// costs per line.
+static void
+benchLatency(const std::vector<std::string> & lines) {
+    std::vector<std::string> timed;
+    for(const auto & line : lines) {
+        timed.push_back(line + " <0.000012>");
+    }
+    const size_t rounds = 20;
+    FdCall call;
+    size_t parsed = 0;
+    const std::vector<std::string> * samples[] = {&lines, &timed};
+    for(const auto * sample : samples) {
+        // one pass untimed: the first sample would otherwise pay for cold caches
+        for(size_t indx = 0; indx < sample->size(); ++indx) {
+            parsed += FdCall::fromLine((*sample)[indx], indx, call);
+        }
+        resetPeakRss();
+        auto begin = Clock::now();
+        for(size_t round = 0; round < rounds; ++round) {
+            for(size_t indx = 0; indx < sample->size(); ++indx) {
+                parsed += FdCall::fromLine((*sample)[indx], indx, call);
+            }
+        }
+        double seconds = elapsed(begin);
+        double items   = static_cast<double>(sample->size() * rounds);
+        char extra[96];
+        std::snprintf(extra, sizeof(extra), ",\"durations\":%s,\"ns_per_line\":%.1f",
+                      sample == &timed ? "true" : "false", items > 0 ? seconds * 1e9 / items : 0.0);
+        report("FdCall.fromLine", 1, items, seconds, "lines/s", extra);
+    }
+
+    std::vector<FdCall> calls;
+    for(const auto & line : timed) {
+        if(FdCall::fromLine(line, calls.size(), call)) {
+            calls.push_back(call);
+        }
+    }
+    LatencyStats stats;
+    resetPeakRss();
+    auto begin = Clock::now();
+    for(size_t round = 0; round < rounds; ++round) {
+        for(const auto & element : calls) {
+            stats.add(element);
+        }
+    }
+    double seconds = elapsed(begin);
+    double items   = static_cast<double>(calls.size() * rounds);
+    char extra[96];
+    std::snprintf(extra, sizeof(extra), ",\"ns_per_call\":%.1f,\"parsed\":%zu",
+                  items > 0 ? seconds * 1e9 / items : 0.0, parsed);
+    report("LatencyStats.add", 1, items, seconds, "calls/s", extra);
+}
+
+static void
+benchPoolEnqueue(unsigned threads, size_t tasks) {
+    ThreadPool * pool = ThreadPool::getInstance(threads);
+    if(!pool->adjust(threads)) {
+        return ;
+    }
+
+    resetPeakRss();
+    std::atomic<size_t> done(0);
+    auto begin = Clock::now();
+    for(size_t indx = 0; indx < tasks; ++indx) {
+        pool->enqueue([&done](){ done.fetch_add(1, std::memory_order_relaxed); });
+    }
+    double submit = elapsed(begin);
+    while(done.load(std::memory_order_acquire) < tasks) {
+        std::this_thread::yield();
+    }
+    double seconds = elapsed(begin);
+
+    char extra[64];
+    std::snprintf(extra, sizeof(extra), ",\"submit_seconds\":%.6f", submit);
+    report("ThreadPool.enqueue", threads, static_cast<double>(tasks), seconds, "tasks/s", extra);
+}
+
+// Bursts of short tasks with idle gaps under the autoscaler: how far the
+// pool grows, what it shrinks back to, and how long submitters wait.
+static void
+benchAutoscale(unsigned threads, size_t tasks) {
+    ThreadPool * pool = ThreadPool::getInstance(threads);
+    ThreadPool::ScalePolicy policy;
+    policy.minThreads = 1;
+    policy.idleUsec   = 50000;
+    pool->autoscale(policy);
+    pool->adjust(1);
+
+    resetPeakRss();
+    const size_t bursts = 4;
+    std::atomic<size_t> done(0);
+    unsigned peak = 0, parked = 0;
+    double submit = 0.0;
+    auto begin = Clock::now();
+    for(size_t burst = 0; burst < bursts; ++burst) {
+        size_t target = (burst + 1) * tasks;
+        auto queued = Clock::now();
+        for(size_t indx = burst * tasks; indx < target; ++indx) {
+            pool->enqueue([&done](){
+                // a few microseconds of parsing
+                volatile unsigned spin = 0;
+                for(unsigned round = 0; round < 2000; ++round) {
+                    spin = spin + round;
+                }
+                done.fetch_add(1, std::memory_order_relaxed);
+            });
+        }
+        submit += elapsed(queued);
+        while(done.load(std::memory_order_acquire) < target) {
+            peak = std::max(peak, pool->size());
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        // idle gap, longer than the idle timeout
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        parked = pool->size();
+    }
+    double seconds = elapsed(begin);
+
+    // parked at the floor the pool must sleep, not poll: CPU time over a
+    // quiet window several idle timeouts long, the scaler's ticks included
+    const double quiet = 0.5;
+    std::clock_t cpu = std::clock();
+    std::this_thread::sleep_for(std::chrono::duration<double>(quiet));
+    double idleCpu = static_cast<double>(std::clock() - cpu) / CLOCKS_PER_SEC / quiet;
+    pool->stopAutoscale();
+    pool->adjust(threads);
+
+    char extra[192];
+    std::snprintf(extra, sizeof(extra), ",\"submit_seconds\":%.6f,\"peak_threads\":%u,\"idle_threads\":%u,"
+                  "\"idle_cpu_share\":%.4f,\"cpu_limit\":%u", submit, peak, parked, idleCpu, ThreadPool::cpuLimit());
+    report("ThreadPool.autoscale", threads, static_cast<double>(bursts * tasks), seconds, "tasks/s", extra);
+}
+
+static void
+benchHandlerLatency(unsigned submitters, size_t tasks) {
+    resetPeakRss();
+    std::vector<long long> latency(submitters * tasks, 0);
+    auto begin = Clock::now();
+    {
+        HandlerThread handler;
+        std::vector<std::thread> producers;
+        for(unsigned owner = 0; owner < submitters; ++owner) {
+            producers.emplace_back([&, owner](){
+                for(size_t indx = 0; indx < tasks; ++indx) {
+                    auto queued = Clock::now();
+                    long long * slot = &latency[owner * tasks + indx];
+                    handler.enqueue([slot, queued](){
+                        *slot = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                    Clock::now() - queued).count();
+                    });
+                }
+            });
+        }
+        for(auto & producer : producers) {
+            producer.join();
+        }
+        handler.quit();
+    }
+    double seconds = elapsed(begin);
+
+    std::sort(latency.begin(), latency.end());
+    auto percentile = [&](double p) {
+        return latency[static_cast<size_t>(p * (latency.size() - 1))];
+    };
+    char extra[128];
+    std::snprintf(extra, sizeof(extra), ",\"p50_ns\":%lld,\"p99_ns\":%lld,\"max_ns\":%lld",
+                  percentile(0.50), percentile(0.99), latency.back());
+    report("HandlerThread.latency", submitters, static_cast<double>(latency.size()), seconds,
+           "tasks/s", extra);
+}
+
+static std::vector<unsigned>
+parseThreads(const char * value) {
+    std::vector<unsigned> threads;
+    while(value && *value) {
+        char * end = nullptr;
+        unsigned long count = std::strtoul(value, &end, 10);
+        if(count > 0) {
+            threads.push_back(count);
+        }
+        value = (*end == ',') ? end + 1 : nullptr;
+    }
+    return threads;
+}
+
+static void
+usage(const char * prog) {
+    std::cerr << "usage: " << prog << " [options]\n"
+              << "  --trace FILE     existing strace -f -tt output (default: generated)\n"
+              << "  --pid N          process id analysed in FILE (default 2038)\n"
+              << "  --lines N        generated trace size (default 1000000)\n"
+              << "  --threads LIST   thread counts, e.g. 1,2,4 (default 1..hardware, powers of two)\n"
+              << "  --tasks N        tasks for ThreadPool/HandlerThread benches (default 200000)\n"
+              << "  --io NAME        I/O backend of the engine benches: auto, mmap, uring, pread (default auto)\n";
+}
+
+int main(int argc, char *argv[]) {
+    TraceGenerator::Options options;
+    std::string trace;
+    std::vector<unsigned> threads;
+    size_t tasks = 200000;
+
+    for(int indx = 1; indx < argc; ++indx) {
+        std::string arg = argv[indx];
+        const char * value = indx + 1 < argc ? argv[indx + 1] : nullptr;
+        if(!value) {
+            usage(argv[0]);
+            return arg == "-h" || arg == "--help" ? 0 : 1;
+        }
+        ++indx;
+        if(arg == "--trace") {
+            trace = value;
+        } else if(arg == "--pid") {
+            options.pid = std::strtol(value, nullptr, 10);
+        } else if(arg == "--lines") {
+            options.lines = std::strtoull(value, nullptr, 10);
+        } else if(arg == "--threads") {
+            threads = parseThreads(value);
+        } else if(arg == "--tasks") {
+            tasks = std::strtoull(value, nullptr, 10);
+        } else if(arg == "--io") {
+            TraceInput::setDefault(TraceInput::backendOf(value));
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if(threads.empty()) {
+        for(unsigned count = 1; count <= std::thread::hardware_concurrency(); count *= 2) {
+            threads.push_back(count);
+        }
+    }
+
+    bool generated = trace.empty();
+    if(generated) {
+        trace = "/tmp/fd_bench_" + std::to_string(getpid()) + ".trace";
+        std::ofstream out(trace, std::ios::out | std::ios::trunc);
+        auto begin = Clock::now();
+        size_t bytes = TraceGenerator(options).generate(out);
+        report("generate", 1, static_cast<double>(bytes), elapsed(begin), "bytes/s");
+    }
+
+    std::vector<std::string> lines;
+    size_t bytes = 0;
+    {
+        std::ifstream in(trace);
+        if(!in.is_open()) {
+            std::cerr << trace << " does not exist!" << std::endl;
+            return 1;
+        }
+        std::string line;
+        while(std::getline(in, line)) {
+            bytes += line.size() + 1;
+            if(lines.size() < 20000) {
+                lines.push_back(line);
+            }
+        }
+    }
+
+    benchRegex(lines);
+    benchLatency(lines);
+    lines.clear();
+    lines.shrink_to_fit();
+
+    // cold: the page cache dropped first; warm: read right after that
+    IOBACKEND engines = TraceInput::getDefault();
+    for(auto backend : {IOBACKEND::MMAP, IOBACKEND::URING, IOBACKEND::PREAD}) {
+        benchRead(trace, backend, true, bytes);
+        benchRead(trace, backend, false, bytes);
+        TraceInput::setDefault(backend);
+        dropCache(trace);
+        benchMatch(trace, options.pid, threads.back(), bytes);
+    }
+    TraceInput::setDefault(engines);
+
+    for(auto count : threads) {
+        benchProcess(trace, options.pid, count, bytes);
+    }
+    // same pass with a tiny history budget: every few thousand events spill
+    benchProcess(trace, options.pid, threads.back(), bytes, 64u << 10);
+    // incident response: the first ten EBADF calls and their history
+    benchProcess(trace, options.pid, threads.back(), bytes, 256u << 20, 10);
+    for(auto count : threads) {
+        benchMatch(trace, options.pid, count, bytes);
+    }
+    benchDiff(trace, options.pid, threads.back(), bytes);
+    benchIndex(trace, bytes);
+    for(auto format : {EXPORTFORMAT::JSONL, EXPORTFORMAT::CSV, EXPORTFORMAT::BINARY}) {
+        benchExport(trace, trace + ".export", format, bytes);
+    }
+    for(auto count : threads) {
+        benchPoolEnqueue(count, tasks);
+    }
+    benchAutoscale(threads.back(), tasks / 4);
+    for(auto count : threads) {
+        benchHandlerLatency(count, tasks / count);
+    }
+
+    if(generated) {
+        std::remove(trace.c_str());
+    }
+    return 0;
+}
@@ -0,0 +1,100 @@
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <algorithm>
+
+#include <pthread.h>
+
+#include "TraceDiff.h"
+
+// fd behaviour that changed between two strace -f -tt traces, e.g. of a
+// good and a bad build. Both traces are matched at once.
+//
+//   fddiff BEFORE AFTER [--pid N] [--pid-after N] [--threads N] [--min-count N] [--min-ratio R]
+
+static void
+usage(const char * prog) {
+    std::cerr << "usage: " << prog << " BEFORE AFTER [options]\n"
+              << "  --pid N          task of both traces (default: every task)\n"
+              << "  --pid-after N    task of AFTER when it differs from --pid\n"
+              << "  --threads N      parse threads shared by both traces (default: all cpus)\n"
+              << "  --min-count N    smallest absolute change reported (default 5)\n"
+              << "  --min-ratio R    smallest change relative to BEFORE (default 0.25)\n"
+              << "  --bucket MS      open-fd count bucket (default 1000)\n";
+}
+
+int main(int argc, char *argv[]) {
+    TraceDiff::Options  options;
+    TraceDiff::Side     before;
+    TraceDiff::Side     after;
+    bool        afterPid = false;
+    unsigned    threads  = std::max(1u, std::thread::hardware_concurrency());
+    std::vector<std::string> paths;
+    for(int indx = 1; indx < argc; ++indx) {
+        std::string arg = argv[indx];
+        if(arg.compare(0, 2, "--") != 0) {
+            paths.push_back(arg);
+            continue;
+        }
+        const char * value = indx + 1 < argc ? argv[++indx] : nullptr;
+        if(!value) {
+            usage(argv[0]);
+            return 1;
+        }
+        if(arg == "--pid") {
+            before.pid = std::strtol(value, nullptr, 10);
+        } else if(arg == "--pid-after") {
+            after.pid = std::strtol(value, nullptr, 10);
+            afterPid  = true;
+        } else if(arg == "--threads") {
+            threads = std::max(1ul, std::strtoul(value, nullptr, 10));
+        } else if(arg == "--min-count") {
+            options.minCount = std::strtoull(value, nullptr, 10);
+        } else if(arg == "--min-ratio") {
+            options.minRatio = std::strtod(value, nullptr);
+        } else if(arg == "--bucket") {
+            options.bucketUsec = std::max(1ll, std::strtoll(value, nullptr, 10)) * 1000;
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if(paths.size() != 2) {
+        usage(argv[0]);
+        return 1;
+    }
+    before.path = paths[0];
+    after.path  = paths[1];
+    if(!afterPid) {
+        after.pid = before.pid;
+    }
+
+    TraceDiff diff(options);
+    // Ctrl-C is taken by a thread of its own: cancel() is not async-signal-safe
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+    std::thread([&diff, signals](){
+        int signal = 0;
+        sigwait(&signals, &signal);
+        diff.cancel();
+    }).detach();
+
+    auto result = diff.run(before, after, threads);
+    if(result.cancelled) {
+        std::cerr << "cancelled" << std::endl;
+        return 1;
+    }
+    for(const auto & change : result.changes) {
+        std::printf("%s\n", TraceDiff::format(change).c_str());
+    }
+    std::printf("%zu significant changes  (before %.3fs, after %.3fs, diff %.3fs)\n", result.changes.size(),
+                result.beforeSeconds, result.afterSeconds, result.seconds);
+    return result.changes.empty() ? 0 : 2;
+}
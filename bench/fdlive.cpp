@@ -0,0 +1,130 @@
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "DescriptorMatch.h"
+#include "Exporter.h"
+#include "PtraceTracer.h"
+#include "SyscallTable.h"
+#include "MemoryStats.h"
+
+// Leak matching on a live process, without strace or a trace file.
+//
+//   fdlive [--export FILE] --pid N         attach; Ctrl-C detaches and reports
+//   fdlive [--export FILE] -- cmd args...  run cmd traced until it exits
+
+static PtraceTracer * sTracer = nullptr;
+
+static void
+onSignal(int) {
+    if(sTracer) {
+        sTracer->stop();
+    }
+}
+
+static void
+usage(const char * prog) {
+    std::cerr << "usage: " << prog << " [options] (--pid N | -- command [args...])\n"
+              << "  --pid N          attach to a running process and its threads\n"
+              << "  --export FILE    stream events and lifetimes (.jsonl, .csv or binary)\n";
+}
+
+int main(int argc, char *argv[]) {
+    pid_t       pid = -1;
+    std::string exportPath;
+    std::vector<std::string> command;
+    for(int indx = 1; indx < argc; ++indx) {
+        std::string arg = argv[indx];
+        if(arg == "--") {
+            command.assign(argv + indx + 1, argv + argc);
+            break;
+        }
+        const char * value = indx + 1 < argc ? argv[++indx] : nullptr;
+        if(!value) {
+            usage(argv[0]);
+            return 1;
+        }
+        if(arg == "--pid") {
+            pid = std::strtol(value, nullptr, 10);
+        } else if(arg == "--export") {
+            exportPath = value;
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if((pid > 0) == !command.empty()) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    PtraceTracer tracer;
+    if(pid > 0 ? !tracer.attach(pid) : !tracer.launch(command)) {
+        return 1;
+    }
+    sTracer = &tracer;
+    struct sigaction action;
+    std::memset(&action, 0, sizeof(action));
+    action.sa_handler = onSignal;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGINT, &action, nullptr);
+    sigaction(SIGTERM, &action, nullptr);
+
+    std::unique_ptr<Exporter> exporter;
+    DescriptorMatch match;
+    match.initResources(-1, std::string(), 1);
+    if(!exportPath.empty()) {
+        exporter.reset(new Exporter(exportPath, Exporter::formatOf(exportPath)));
+        match.setExporter(exporter->isOpen() ? exporter.get() : nullptr, true);
+    }
+
+    auto begin = std::chrono::steady_clock::now();
+    match.beginLive();
+    tracer.run([&](FdCall && call){ match.feedLive(std::move(call)); });
+    match.endLive();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+    sTracer = nullptr;
+
+    auto result = match.getResult();
+    std::printf("traced %.3fs  stops %llu  fd calls %llu\n", seconds,
+                static_cast<unsigned long long>(tracer.stops()), static_cast<unsigned long long>(tracer.calls()));
+    std::printf("opens %zu  closes %zu  unknown closes %zu  bad fds %zu  leaks %zu\n",
+                result.opens, result.closes, result.unknownCloses, result.badFds, result.leaks.size());
+    for(const auto & leak : result.leaks) {
+        std::printf("\t%d\t%ld\t%s\t%s\n", leak.pid, leak.fd,
+                    std::string(SyscallTable::name(leak.open.call)).c_str(), leak.open.detail.c_str());
+    }
+    const auto & races = result.raceCounts;
+    std::printf("double closes %zu  foreign closes %zu  stale uses %zu\n",
+                races[static_cast<size_t>(RACE::DOUBLECLOSE)], races[static_cast<size_t>(RACE::FOREIGNCLOSE)],
+                races[static_cast<size_t>(RACE::STALEUSE)]);
+    for(const auto & race : result.races) {
+        std::printf("\t%s\t%d\t%ld\tgen %u\t%d %s -> %d %s\n", RaceDetector::name(race.kind), race.pid, race.fd,
+                    race.generation, race.first.tid, std::string(SyscallTable::name(race.first.call)).c_str(),
+                    race.second.tid, std::string(SyscallTable::name(race.second.call)).c_str());
+    }
+    if(!result.latency.empty()) {
+        std::printf("timed calls %llu (us: count p50 p99 max)\n", static_cast<unsigned long long>(result.latency.calls()));
+        for(size_t indx = 1; indx < static_cast<size_t>(SYSCALL::COUNT); ++indx) {
+            const LatencyHistogram & histogram = result.latency.perCall()[indx];
+            if(histogram.count() > 0) {
+                std::printf("\t%s\t%llu\t%lld\t%lld\t%lld\n",
+                            std::string(SyscallTable::name(static_cast<SYSCALL>(indx))).c_str(),
+                            static_cast<unsigned long long>(histogram.count()), histogram.percentile(0.5),
+                            histogram.percentile(0.99), histogram.max());
+            }
+        }
+        for(const auto & slow : result.latency.slowest()) {
+            std::printf("\tslow\t%lldus\t%d\t%s\tfd %ld\n", slow.duration, slow.pid,
+                        std::string(SyscallTable::name(slow.call)).c_str(), slow.fd);
+        }
+    }
+    std::printf("memory (current, peak):\n%s", MemoryStats::format(MemoryStats::getInstance()->usage()).c_str());
+    return tracer.exitStatus() > 0 ? tracer.exitStatus() : 0;
+}
@@ -0,0 +1,104 @@
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <algorithm>
+
+#include <pthread.h>
+
+#include "DescriptorMatch.h"
+#include "Exporter.h"
+#include "FdSampler.h"
+
+// fd usage of live processes from /proc, without tracing them.
+//
+//   fdsample --pid N[,M...] [--interval MS] [--seconds S] [--export FILE]
+
+static void
+usage(const char * prog) {
+    std::cerr << "usage: " << prog << " --pid N[,M...] [options]\n"
+              << "  --interval MS    time between listings (default 100)\n"
+              << "  --seconds S      stop after S seconds (default: when the pids exit, or Ctrl-C)\n"
+              << "  --export FILE    stream events and lifetimes (.jsonl, .csv or binary)\n";
+}
+
+int main(int argc, char *argv[]) {
+    FdSampler   sampler;
+    bool        pids     = false;
+    double      seconds  = 0;
+    long long   interval = 100;
+    std::string exportPath;
+    for(int indx = 1; indx < argc; ++indx) {
+        std::string arg = argv[indx];
+        const char * value = indx + 1 < argc ? argv[++indx] : nullptr;
+        if(!value) {
+            usage(argv[0]);
+            return 1;
+        }
+        if(arg == "--pid") {
+            for(char * next = const_cast<char *>(value); *next;) {
+                sampler.addPid(std::strtol(next, &next, 10));
+                pids = true;
+                if(*next == ',') {
+                    ++next;
+                } else {
+                    break;
+                }
+            }
+        } else if(arg == "--interval") {
+            interval = std::strtoll(value, nullptr, 10);
+        } else if(arg == "--seconds") {
+            seconds = std::strtod(value, nullptr);
+        } else if(arg == "--export") {
+            exportPath = value;
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if(!pids) {
+        usage(argv[0]);
+        return 1;
+    }
+    sampler.setInterval(interval * 1000);
+
+    // Ctrl-C is taken by a thread of its own: stop() is not async-signal-safe
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+    std::thread([&sampler, signals](){
+        int signal = 0;
+        sigwait(&signals, &signal);
+        sampler.stop();
+    }).detach();
+
+    std::unique_ptr<Exporter> exporter;
+    DescriptorMatch match;
+    match.initResources(-1, std::string(), 1);
+    if(!exportPath.empty()) {
+        exporter.reset(new Exporter(exportPath, Exporter::formatOf(exportPath)));
+        match.setExporter(exporter->isOpen() ? exporter.get() : nullptr, true);
+    }
+
+    match.beginLive();
+    sampler.run([&](FdCall && call){ match.feedLive(std::move(call)); }, seconds);
+    match.endLive();
+
+    auto result = match.getResult();
+    std::printf("samples %llu  opens %zu  closes %zu  still open %zu\n",
+                static_cast<unsigned long long>(sampler.samples()), result.opens, result.closes, result.leaks.size());
+    for(const auto & element : result.usage) {
+        long long peak = 0;
+        for(const auto & point : element.second) {
+            peak = std::max(peak, point.openFds);
+        }
+        std::printf("\tpid %d  peak open fds %lld\n", element.first, peak);
+    }
+    return 0;
+}
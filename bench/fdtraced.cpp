@@ -0,0 +1,188 @@
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <chrono>
+#include <thread>
+#include <iostream>
+#include <string>
+
+#include "AnalysisDaemon.h"
+#include "DaemonClient.h"
+#include "SyscallTable.h"
+
+// Analysis daemon and its command line client.
+//
+//   fdtraced serve [--threads N] [--autoscale MIN:MAX] [--cache MB] [--shared]
+//   fdtraced match <trace> [--pid N]       leak summary
+//   fdtraced ebadf <trace> [--pid N] [--first N]  EBADF summary
+//   fdtraced stats | stop
+
+static AnalysisDaemon * sDaemon = nullptr;
+
+static void
+onSignal(int) {
+    if(sDaemon) {
+        sDaemon->stop();
+    }
+}
+
+static void
+usage(const char * prog) {
+    std::cerr << "usage: " << prog << " <command> [options]\n"
+              << "  serve              run the daemon in the foreground\n"
+              << "    --threads N      pool size (default: hardware threads)\n"
+              << "    --autoscale MIN:MAX  grow the pool with the backlog, retire idle workers;\n"
+              << "                     MAX 0 is the CPU quota (starts at MIN unless --threads)\n"
+              << "    --cache MB       result cache budget (default 512)\n"
+              << "    --shared         let the owner's group connect\n"
+              << "  match <trace>      fd leak summary of a trace\n"
+              << "  ebadf <trace>      EBADF summary of a trace\n"
+              << "    --first N        stop at the first N incidents (triage)\n"
+              << "    --pid N          only this pid (default: all)\n"
+              << "  stats              daemon cache counters\n"
+              << "  stop               shut the daemon down\n"
+              << "  --socket PATH      daemon socket (default " << DaemonProtocol::defaultSocket() << ")\n";
+}
+
+static double
+elapsed(std::chrono::steady_clock::time_point begin) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+}
+
+int main(int argc, char *argv[]) {
+    if(argc < 2) {
+        usage(argv[0]);
+        return 1;
+    }
+    std::string command = argv[1];
+    std::string socket  = DaemonProtocol::defaultSocket();
+    std::string trace;
+    pid_t       pid     = -1;
+    unsigned    threads = std::max(1u, std::thread::hardware_concurrency());
+    size_t      cacheMb = 512;
+    size_t      first   = 0;
+    bool        shared  = false;
+    bool        scaled  = false;
+    bool        sized   = false;
+    unsigned    minThreads = 1, maxThreads = 0;
+
+    for(int indx = 2; indx < argc; ++indx) {
+        std::string arg = argv[indx];
+        if(arg == "--shared") {
+            shared = true;
+            continue;
+        }
+        if(arg.compare(0, 2, "--") != 0) {
+            trace = arg;
+            continue;
+        }
+        const char * value = indx + 1 < argc ? argv[++indx] : nullptr;
+        if(!value) {
+            usage(argv[0]);
+            return 1;
+        }
+        if(arg == "--socket") {
+            socket = value;
+        } else if(arg == "--pid") {
+            pid = std::strtol(value, nullptr, 10);
+        } else if(arg == "--threads") {
+            threads = std::strtoul(value, nullptr, 10);
+            sized   = true;
+        } else if(arg == "--autoscale") {
+            char * end = nullptr;
+            minThreads = std::strtoul(value, &end, 10);
+            maxThreads = *end == ':' ? std::strtoul(end + 1, nullptr, 10) : 0;
+            scaled     = true;
+        } else if(arg == "--first") {
+            first = std::strtoull(value, nullptr, 10);
+        } else if(arg == "--cache") {
+            cacheMb = std::strtoull(value, nullptr, 10);
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if(command == "serve") {
+        if(scaled && !sized) {
+            threads = std::max(1u, minThreads);
+        }
+        AnalysisDaemon daemon(socket, threads, cacheMb << 20);
+        daemon.setShared(shared);
+        if(scaled) {
+            daemon.setAutoscale(minThreads, maxThreads);
+        }
+        sDaemon = &daemon;
+        std::signal(SIGINT, onSignal);
+        std::signal(SIGTERM, onSignal);
+        std::signal(SIGPIPE, SIG_IGN);
+        std::cout << "serving on " << socket << ", " << threads << " threads" << std::endl;
+        bool served = daemon.run();
+        sDaemon = nullptr;
+        return served ? 0 : 1;
+    }
+
+    DaemonClient client(socket);
+    auto begin = std::chrono::steady_clock::now();
+    if(command == "match" && !trace.empty()) {
+        DescriptorMatch::MatchResult result;
+        if(!client.match(trace, pid, result)) {
+            std::cerr << client.error() << std::endl;
+            return 1;
+        }
+        std::printf("leaks %zu  opens %zu  closes %zu  unknown closes %zu  bad fds %zu  pending %zu\n",
+                    result.leaks.size(), result.opens, result.closes, result.unknownCloses,
+                    result.badFds, result.pending);
+        const auto & races = result.raceCounts;
+        std::printf("double closes %zu  foreign closes %zu  stale uses %zu\n",
+                    races[static_cast<size_t>(RACE::DOUBLECLOSE)], races[static_cast<size_t>(RACE::FOREIGNCLOSE)],
+                    races[static_cast<size_t>(RACE::STALEUSE)]);
+        if(!result.latency.empty()) {
+            std::printf("timed calls %llu (us: count p50 p99 max)\n", static_cast<unsigned long long>(result.latency.calls()));
+            for(size_t indx = 1; indx < static_cast<size_t>(SYSCALL::COUNT); ++indx) {
+                const LatencyHistogram & histogram = result.latency.perCall()[indx];
+                if(histogram.count() > 0) {
+                    std::printf("\t%s\t%llu\t%lld\t%lld\t%lld\n",
+                                std::string(SyscallTable::name(static_cast<SYSCALL>(indx))).c_str(),
+                                static_cast<unsigned long long>(histogram.count()), histogram.percentile(0.5),
+                                histogram.percentile(0.99), histogram.max());
+                }
+            }
+            for(const auto & slow : result.latency.slowest()) {
+                std::printf("\tslow\t%lldus\t%d\t%s\tfd %ld\n", slow.duration, slow.pid,
+                            std::string(SyscallTable::name(slow.call)).c_str(), slow.fd);
+            }
+        }
+    } else if(command == "ebadf" && !trace.empty()) {
+        ResultHandle result;
+        if(!client.ebadf(trace, pid, result, first)) {
+            std::cerr << client.error() << std::endl;
+            return 1;
+        }
+        std::printf("bad fds %zu  incidents %zu  rows %zu%s\n", result->badFds, result->incidents, result->size(),
+                    result->partial ? "  (first incidents only)" : "");
+    } else if(command == "stats") {
+        DaemonProtocol::Stats stats;
+        if(!client.stats(stats)) {
+            std::cerr << client.error() << std::endl;
+            return 1;
+        }
+        std::printf("requests %llu  hits %llu  shared %llu  entries %llu  cached %.1f/%.0f MB  threads %u\n",
+                    static_cast<unsigned long long>(stats.requests), static_cast<unsigned long long>(stats.hits),
+                    static_cast<unsigned long long>(stats.shared), static_cast<unsigned long long>(stats.entries),
+                    stats.bytes / 1048576.0, stats.budget / 1048576.0, stats.threads);
+        std::printf("memory (current, peak):\n%s", MemoryStats::format(stats.memory).c_str());
+        return 0;
+    } else if(command == "stop") {
+        if(!client.shutdown()) {
+            std::cerr << client.error() << std::endl;
+            return 1;
+        }
+        return 0;
+    } else {
+        usage(argv[0]);
+        return 1;
+    }
+    std::printf("%s in %.3fs\n", client.cached() ? "cached" : "computed", elapsed(begin));
+    return 0;
+}
@@ -0,0 +1,125 @@
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+
+#include "TraceGenerator.h"
+
+static void
+usage(const char * prog) {
+    std::cerr << "usage: " << prog << " [options] -o <trace>\n"
+              << "  --lines N          lines to generate (default 1000000)\n"
+              << "  --threads N        traced threads (default 4)\n"
+              << "  --churn F          share of fd syscalls (default 0.30)\n"
+              << "  --unfinished F     share of unfinished/resumed pairs (default 0.05)\n"
+              << "  --ebadf F          share of EBADF close/dup (default 0.001)\n"
+              << "  --payload MIN:MAX  read/write payload length (default 16:128)\n"
+              << "  --pid N            first tid (default 2038)\n"
+              << "  --seed N           random seed (default 2038)\n"
+              << "  --ff               strace -ff layout: one <trace>.<pid> file per task, no pid column\n"
+              << "  --durations        strace -T: time spent in each call after its result\n";
+}
+
+// Same trace as the -f layout, written the way `strace -ff -o <prefix>` does.
+static int
+splitTasks(const TraceGenerator::Options & options, const std::string & prefix) {
+    TraceGenerator generator(options);
+    std::map<std::string, std::unique_ptr<std::ofstream>> files;
+    std::string line;
+    size_t      bytes = 0;
+    for(size_t indx = 0; indx < options.lines; ++indx) {
+        generator.next(line);
+        size_t end   = line.find(' ');
+        size_t begin = line.find_first_not_of(' ', end);
+        std::string pid = line.substr(0, end);
+
+        auto & out = files[pid];
+        if(!out) {
+            out.reset(new std::ofstream(prefix + "." + pid, std::ios::out | std::ios::trunc));
+            if(!out->is_open()) {
+                std::cerr << prefix << "." << pid << " can not be created!" << std::endl;
+                return 1;
+            }
+        }
+        out->write(line.data() + begin, line.size() - begin);
+        out->put('\n');
+        bytes += line.size() - begin + 1;
+    }
+    std::cout << prefix << ".*: " << files.size() << " files, " << options.lines << " lines, "
+              << bytes << " bytes" << std::endl;
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    TraceGenerator::Options options;
+    std::string output;
+    bool        perTask = false;
+
+    for(int indx = 1; indx < argc; ++indx) {
+        std::string arg = argv[indx];
+        const char * value = indx + 1 < argc ? argv[indx + 1] : nullptr;
+        if(arg == "-h" || arg == "--help") {
+            usage(argv[0]);
+            return 0;
+        }
+        if(arg == "--ff") {
+            perTask = true;
+            continue;
+        }
+        if(arg == "--durations") {
+            options.durations = true;
+            continue;
+        }
+        if(!value) {
+            usage(argv[0]);
+            return 1;
+        }
+        ++indx;
+        if(arg == "-o") {
+            output = value;
+        } else if(arg == "--lines") {
+            options.lines = std::strtoull(value, nullptr, 10);
+        } else if(arg == "--threads") {
+            options.threads = std::strtoul(value, nullptr, 10);
+        } else if(arg == "--churn") {
+            options.churn = std::strtod(value, nullptr);
+        } else if(arg == "--unfinished") {
+            options.unfinished = std::strtod(value, nullptr);
+        } else if(arg == "--ebadf") {
+            options.ebadf = std::strtod(value, nullptr);
+        } else if(arg == "--payload") {
+            const char * colon = std::strchr(value, ':');
+            options.payloadMin = std::strtoul(value, nullptr, 10);
+            options.payloadMax = colon ? std::strtoul(colon + 1, nullptr, 10) : options.payloadMin;
+        } else if(arg == "--pid") {
+            options.pid = std::strtol(value, nullptr, 10);
+        } else if(arg == "--seed") {
+            options.seed = std::strtoull(value, nullptr, 10);
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if(output.empty()) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    if(perTask) {
+        return splitTasks(options, output);
+    }
+
+    std::ofstream out(output, std::ios::out | std::ios::trunc);
+    if(!out.is_open()) {
+        std::cerr << output << " can not be created!" << std::endl;
+        return 1;
+    }
+
+    TraceGenerator generator(options);
+    size_t bytes = generator.generate(out);
+    std::cout << output << ": " << options.lines << " lines, " << bytes << " bytes" << std::endl;
+    return 0;
+}
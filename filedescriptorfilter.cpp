@@ -9,8 +9,7 @@ int main(int argc, char *argv[]) {
 
     FilterWidget *widget = new FilterWidget();
     window.setCentralWidget(widget);
-    window.setFixedSize(507,100);
-    //window.resize(900, 600);
+    window.resize(900, 600);
     window.show();
 
     std::cout<< window.width() << " " << window.height() <<std::endl;
@@ -1,16 +1,19 @@
 #include "filterwidget.h"
 #include "FilterThread.h"
 
-#include <fstream>
-
 #include <QtCharts/QChartView>
 #include <QtWidgets/QGridLayout>
 #include <QtWidgets/QFormLayout>
 #include <QtWidgets/QComboBox>
+#include <QtWidgets/QCheckBox>
 #include <QtWidgets/QLabel>
 #include <QtWidgets/QFileDialog>
+#include <QtWidgets/QHeaderView>
+#include <QtWidgets/QLineEdit>
+#include <QtWidgets/QTableView>
 
 #include "HandlerThread.h"
+#include "MemoryStats.h"
 
 FilterWidget::FilterWidget(QWidget *parent)
 : QWidget(parent)
@@ -18,11 +21,21 @@ FilterWidget::FilterWidget(QWidget *parent)
 , mThreadComboBox(createThreadBox())
 , mFilePathButton(createLogButton())
 , mProcessButton(createProcessButton())
+, mCancelButton(createCancelButton())
+, mExportButton(createExportButton())
+, mEventsCheckBox(createEventsBox())
 , mProcessBar(createProcessBar())
-, mpProcessHandler(new HandlerThread())
+, mTimelineView(new TimelineView())
+, mFilterEdit(createFilterEdit())
+, mResultView(createResultView())
+, mResultModel(new ResultTableModel(this))
 , mpBarThread(new QBarThread())
 , mpProcessThread(new QProcessThread())
+, mpMatchThread(new QMatchThread())
+, mpDaemonThread(new QDaemonThread())
 {
+    mResultView->setModel(mResultModel);
+    mResultView->setSortingEnabled(true);
     connectSignal();
 
     QGridLayout *pBaseLayout = new QGridLayout();
@@ -34,10 +47,19 @@ FilterWidget::FilterWidget(QWidget *parent)
     pSettingLayout->addWidget(new QLabel("log"));
     pSettingLayout->addWidget(mFilePathButton);
     pSettingLayout->addWidget(mProcessButton);
+    pSettingLayout->addWidget(mCancelButton);
+    pSettingLayout->addWidget(new QLabel("导出"));
+    pSettingLayout->addWidget(mExportButton);
+    pSettingLayout->addWidget(mEventsCheckBox);
     //pSettingLayout->addStretch();
 
     pBaseLayout->addLayout(pSettingLayout, 0, 0, 1, 3);
     pBaseLayout->addWidget(mProcessBar, 1, 0);
+    pBaseLayout->addWidget(mTimelineView, 2, 0, 1, 3);
+    pBaseLayout->addWidget(mFilterEdit, 3, 0, 1, 3);
+    pBaseLayout->addWidget(mResultView, 4, 0, 1, 3);
+    pBaseLayout->setRowStretch(2, 1);
+    pBaseLayout->setRowStretch(4, 1);
     setLayout(pBaseLayout);
 
     initUIResources();
@@ -65,9 +87,39 @@ FilterWidget::~FilterWidget(){
         mProcessButton = nullptr;
     }
 
-    if(mpProcessHandler) {
-        delete mpProcessHandler;
-        mpProcessHandler = nullptr;
+    if(mCancelButton) {
+        delete mCancelButton;
+        mCancelButton = nullptr;
+    }
+
+    if(mExportButton) {
+        delete mExportButton;
+        mExportButton = nullptr;
+    }
+
+    if(mEventsCheckBox) {
+        delete mEventsCheckBox;
+        mEventsCheckBox = nullptr;
+    }
+
+    if(mTimelineView) {
+        delete mTimelineView;
+        mTimelineView = nullptr;
+    }
+
+    if(mFilterEdit) {
+        delete mFilterEdit;
+        mFilterEdit = nullptr;
+    }
+
+    if(mResultView) {
+        delete mResultView;
+        mResultView = nullptr;
+    }
+
+    if(mResultModel) {
+        delete mResultModel;
+        mResultModel = nullptr;
     }
 
     if(mpBarThread) {
@@ -80,6 +132,16 @@ FilterWidget::~FilterWidget(){
         mpProcessThread = nullptr;
     }
 
+    if(mpMatchThread) {
+        delete mpMatchThread;
+        mpMatchThread = nullptr;
+    }
+
+    if(mpDaemonThread) {
+        delete mpDaemonThread;
+        mpDaemonThread = nullptr;
+    }
+
 }
 
 void
@@ -98,10 +160,22 @@ FilterWidget::connectSignal(){
             this, &FilterWidget::logFilePathChanged);
     connect(mProcessButton, static_cast<void (QPushButton::*)(bool)>(&QPushButton::clicked),
             this, &FilterWidget::processButtonClicked);
+    connect(mCancelButton, static_cast<void (QPushButton::*)(bool)>(&QPushButton::clicked),
+            this, &FilterWidget::cancelButtonClicked);
+    connect(mExportButton, static_cast<void (QPushButton::*)(bool)>(&QPushButton::clicked),
+            this, &FilterWidget::exportPathChanged);
     connect(mpBarThread, static_cast<void (QBarThread::*)(double)>(&QBarThread::notify),
             this, &FilterWidget::processBarChanged);
     connect(mpProcessThread, static_cast<void (QProcessThread::*)(ResultData)>(&QProcessThread::notify),
             this, &FilterWidget::processDescriptorChanged);
+    connect(mpMatchThread, static_cast<void (QMatchThread::*)(MatchData)>(&QMatchThread::notify),
+            this, &FilterWidget::processMatchChanged);
+    connect(mpDaemonThread, static_cast<void (QDaemonThread::*)(ResultData)>(&QDaemonThread::notifyResult),
+            this, &FilterWidget::processDescriptorChanged);
+    connect(mpDaemonThread, static_cast<void (QDaemonThread::*)(MatchData)>(&QDaemonThread::notifyMatch),
+            this, &FilterWidget::processMatchChanged);
+    connect(mFilterEdit, &QLineEdit::editingFinished,
+            this, &FilterWidget::resultFilterChanged);
     DEG_LOG("Connect Signal Success");
 }
 
@@ -138,6 +212,16 @@ FilterWidget::createProcessButton() const {
     return processButton;
 }
 
+QPushButton*
+FilterWidget::createCancelButton() const {
+    QPushButton *cancelButton = new QPushButton();
+    cancelButton->setText("cancel");
+    cancelButton->setDisabled(true);
+    DEG_LOG("Create CancelButton: %p, Success", cancelButton);
+    cancelButton->setFixedSize(80,23);
+    return cancelButton;
+}
+
 QProgressBar*
 FilterWidget::createProcessBar() const {
     QProgressBar *processBar = new QProgressBar();
@@ -159,23 +243,65 @@ FilterWidget::createLogButton() const {
     return logButton;
 }
 
+QPushButton*
+FilterWidget::createExportButton() const {
+    QPushButton *exportButton = new QPushButton();
+    exportButton->setText("none");
+    exportButton->setToolTip(".jsonl / .csv / .bin");
+    DEG_LOG("Create ExportButton: %p, Success", exportButton);
+    exportButton->setFixedSize(140, 23);
+    return exportButton;
+}
+
+QCheckBox*
+FilterWidget::createEventsBox() const {
+    QCheckBox *eventsBox = new QCheckBox("events");
+    eventsBox->setToolTip("also export every fd event (DescriptorMatch)");
+    DEG_LOG("Create EventsBox: %p, Success", eventsBox);
+    return eventsBox;
+}
+
+QLineEdit*
+FilterWidget::createFilterEdit() const {
+    QLineEdit *filterEdit = new QLineEdit();
+    filterEdit->setPlaceholderText("fd=3 pid=2038 from=10:00:00 to=10:05:00");
+    filterEdit->setClearButtonEnabled(true);
+    DEG_LOG("Create FilterEdit: %p, Success", filterEdit);
+    return filterEdit;
+}
+
+QTableView*
+FilterWidget::createResultView() const {
+    QTableView *resultView = new QTableView();
+    // fixed row height: the view never measures rows it does not paint
+    resultView->verticalHeader()->setSectionResizeMode(QHeaderView::Fixed);
+    resultView->verticalHeader()->setDefaultSectionSize(20);
+    resultView->verticalHeader()->hide();
+    resultView->horizontalHeader()->setStretchLastSection(true);
+    resultView->setSelectionBehavior(QAbstractItemView::SelectRows);
+    resultView->setWordWrap(false);
+    DEG_LOG("Create ResultView: %p, Success", resultView);
+    return resultView;
+}
+
 void
 FilterWidget::processBoxChanged(){
-    PROCESSMODE processMode = static_cast<PROCESSMODE>(mProcessComboBox->itemData(mProcessComboBox->currentIndex()).toInt());
-    switch(processMode) {
+    mProcessMode = mProcessComboBox->itemData(mProcessComboBox->currentIndex()).value<PROCESSMODE>();
+    switch(mProcessMode) {
     case PROCESSMODE::BADFILEDESCRIPTOR:
         mFileDescriptor = FileDescriptor::getInstance();
+        mpAnalyzer = mFileDescriptor;
         break;
     case PROCESSMODE::FILEDESCRIPTORMATCH:
-        //to do
-        mFileDescriptor = FileDescriptor::getInstance();
+        mDescriptorMatch = DescriptorMatch::getInstance();
+        mpAnalyzer = mDescriptorMatch;
         break;
     default:
-        //to do
         mFileDescriptor = FileDescriptor::getInstance();
+        mpAnalyzer = mFileDescriptor;
         break;
     }
-    DEG_LOG("Create Process Instance: %p", mFileDescriptor);
+    DEG_LOG("Create Process Instance: %p", mpAnalyzer);
 }
 
 void
@@ -187,22 +313,31 @@ FilterWidget::threadBoxChanged() {
 void
 FilterWidget::logFilePathChanged() {
         mFilePath = QFileDialog::getOpenFileName(this, "选择文件", "C:");
-        mFilePathButton->setText(mFilePath);
-
-        auto res = mpProcessHandler->enqueue([&](){
-            mProcessLine = 0;
-            std::ifstream in(mFilePath.toStdString());
-            if(in.is_open()) {
-                std::string line;
-                while(getline(in, line)) {
-                    ++mProcessLine;
-                }
+
+        // strace -ff 输出: 选中任一 <prefix>.<pid> 即合并同前缀的全部文件
+        bool merged = false;
+        int  dot = mFilePath.lastIndexOf('.');
+        if(dot > 0) {
+            QString prefix = mFilePath.left(dot);
+            if(TraceMerger::discover(prefix.toStdString()).size() > 1) {
+                mFilePath = prefix;
+                merged    = true;
             }
-        });
+        }
+        mFilePathButton->setText(merged ? mFilePath + ".*" : mFilePath);
 
         DEG_LOG("log file changed %s", mFilePath.toStdString().c_str());
 }
 
+void
+FilterWidget::exportPathChanged() {
+        // 取消选择即关闭导出
+        mExportPath = QFileDialog::getSaveFileName(this, "导出文件", QString(),
+                                                   "JSON Lines (*.jsonl);;CSV (*.csv);;Binary (*.bin)");
+        mExportButton->setText(mExportPath.isEmpty() ? QString("none") : mExportPath);
+        DEG_LOG("export file changed %s", mExportPath.toStdString().c_str());
+}
+
 void
 FilterWidget::processBarChanged(double val) {
     mProcessBar->setValue( val * 10);
@@ -214,47 +349,177 @@ void
 FilterWidget::processDescriptorChanged(ResultData data) {
     DEG_LOG("receive process end signal");
 
-    mProcessComboBox->setDisabled(false);
-    mThreadComboBox->setDisabled(false);
-    mFilePathButton->setDisabled(false);
-
-    for(auto it = data.begin(); it != data.end(); ++it) {
-        std::cout<<"Bad File Descriptor: "<< it.key()<<std::endl;
-
-        for( auto & element : it.value()) {
-            auto node = element.get();
-            FDSTATUS status = std::get<2>(node);
-            std::cout<<"\t"<<std::get<0>(node)<<"\t";
-            if(status == FDSTATUS::OPENING) {
-                std::cout<<"Opening\t";
-            } else if(status == FDSTATUS::DUMPING) {
-                std::cout<<"Dumping\t";
-            } else if(status == FDSTATUS::CLOSED) {
-                std::cout<<"CLOSED\t";
+    setRunning(false);
+    finishExport();
+    mpBarThread->requestInterruption();
+    if(mpAnalyzer->cancelled()) {
+        std::cout<<"Cancelled"<<std::endl;
+    } else {
+        processBarChanged(100);
+    }
+
+    std::cout<<"Bad File Descriptor: "<<(data ? data->badFds : 0)
+             <<"\tIncidents: "<<(data ? data->incidents : 0)
+             <<"\tHistory: "<<(data ? data->size() : 0)<<std::endl;
+    mResultModel->setStore(data);
+}
+
+void
+FilterWidget::resultFilterChanged() {
+    mResultModel->setFilter(ResultFilter::parse(mFilterEdit->text()));
+}
+
+void
+FilterWidget::processMatchChanged(MatchData data) {
+    DEG_LOG("receive match end signal");
+
+    setRunning(false);
+    finishExport();
+    mpBarThread->requestInterruption();
+    if(mpAnalyzer->cancelled()) {
+        std::cout<<"Cancelled"<<std::endl;
+    } else {
+        processBarChanged(100);
+    }
+
+    std::cout<<"Opened: "<<data.opens<<"\tClosed: "<<data.closes
+             <<"\tUnknown Close: "<<data.unknownCloses<<"\tBad File Descriptor: "<<data.badFds
+             <<"\tUnfinished: "<<data.pending<<std::endl;
+
+    std::cout<<"Leaked File Descriptor: "<<data.leaks.size()<<std::endl;
+    for(const auto & leak : data.leaks) {
+        std::cout<<"\t"<<leak.pid<<"\t"<<leak.fd<<"\t"<<formatMicros(leak.open.usec)
+                 <<"\t"<<SyscallTable::name(leak.open.call)<<"\t"<<leak.open.detail<<std::endl;
+    }
+
+    // 每条竞争记录两个线程的事件: 先前的 open/close 和与之矛盾的调用
+    std::cout<<"FD Race: "<<data.races.size()<<std::endl;
+    for(const auto & race : data.races) {
+        std::cout<<"\t"<<RaceDetector::name(race.kind)<<"\t"<<race.pid<<"\t"<<race.fd
+                 <<"\t"<<race.first.tid<<" "<<SyscallTable::name(race.first.call)<<" "<<formatMicros(race.first.usec)
+                 <<"\t"<<race.second.tid<<" "<<SyscallTable::name(race.second.call)<<" "<<formatMicros(race.second.usec)
+                 <<std::endl;
+    }
+
+    // strace -T 的耗时: 每个系统调用的分位数和最慢的调用
+    if(!data.latency.empty()) {
+        std::cout<<"Syscall Latency (us): "<<data.latency.calls()<<std::endl;
+        for(size_t indx = 1; indx < static_cast<size_t>(SYSCALL::COUNT); ++indx) {
+            const LatencyHistogram & histogram = data.latency.perCall()[indx];
+            if(histogram.count() > 0) {
+                std::cout<<"\t"<<SyscallTable::name(static_cast<SYSCALL>(indx))<<"\t"<<histogram.count()
+                         <<"\tp50 "<<histogram.percentile(0.5)<<"\tp99 "<<histogram.percentile(0.99)
+                         <<"\tmax "<<histogram.max()<<std::endl;
+            }
+        }
+        for(const auto & slow : data.latency.slowest()) {
+            std::cout<<"\tslow\t"<<slow.duration<<"\t"<<slow.pid<<"\t"<<SyscallTable::name(slow.call)
+                     <<"\t"<<slow.fd<<"\t"<<formatMicros(slow.usec)<<std::endl;
+        }
+    }
+
+    // 各引擎数据结构当前和峰值占用的内存
+    std::cout<<"Memory:"<<std::endl<<MemoryStats::format(MemoryStats::getInstance()->usage());
+
+    std::cout<<"Leak Timeline:"<<std::endl;
+    for(const auto & bucket : data.timeline) {
+        std::cout<<"\t"<<formatMicros(bucket.usec)<<"\t"<<bucket.opened<<"\t"<<bucket.cumulative<<std::endl;
+    }
+
+    // the traced pid, or the busiest one when it never shows up in the trace
+    auto usage = data.usage.find(mProcessId);
+    if(usage == data.usage.end()) {
+        long long peak = 0;
+        for(auto it = data.usage.begin(); it != data.usage.end(); ++it) {
+            for(const auto & point : it->second) {
+                if(usage == data.usage.end() || point.openFds > peak) {
+                    peak  = point.openFds;
+                    usage = it;
+                }
             }
-            std::cout<<std::get<1>(node)<<std::endl;
         }
     }
+    if(usage != data.usage.end()) {
+        mTimelineView->setTimeline(usage->second);
+    } else {
+        mTimelineView->clear();
+    }
 
+    std::cout<<"Longest Lived File Descriptor:"<<std::endl;
+    for(const auto & life : data.longest) {
+        std::cout<<"\t"<<life.pid<<"\t"<<life.fd<<"\t"<<formatMicros(life.open.usec)
+                 <<"\t"<<life.duration()<<"us"<<(life.leaked ? "\tLeaked" : "")<<std::endl;
+    }
 }
 
 void
 FilterWidget::processButtonClicked() {
     DEG_LOG("set ui disable begin xxx");
-    mProcessComboBox->setDisabled(true);
-    mThreadComboBox->setDisabled(true);
-    mFilePathButton->setDisabled(true);
+    setRunning(true);
     DEG_LOG("set ui disable end xxx");
 
     DEG_LOG("Button width: %d, height: %d", mProcessButton->width(), mProcessButton->height());
     
     // 数据处理（耗时任务）放到子线程，避免UI线程卡死
-    mFileDescriptor->initResources(2038, mFilePath.toStdString(), mThreadNum);
-    mpProcessThread->initResources(mFileDescriptor);
-    mpProcessThread->start();
+    mpAnalyzer->initResources(mProcessId, mFilePath.toStdString(), mThreadNum);
+    if(!mExportPath.isEmpty()) {
+        std::string path = mExportPath.toStdString();
+        mpExporter.reset(new Exporter(path, Exporter::formatOf(path)));
+        mpAnalyzer->setExporter(mpExporter->isOpen() ? mpExporter.get() : nullptr,
+                                mEventsCheckBox->isChecked());
+    }
+    // 有 fdtraced 守护进程时由它分析，同一文件的重复查询直接命中缓存；导出需要本地分析
+    mUseDaemon = mExportPath.isEmpty() && DaemonClient::available();
+    if(mUseDaemon) {
+        mpDaemonThread->initResources(mFilePath.toStdString(), mProcessId,
+                                      mProcessMode == PROCESSMODE::FILEDESCRIPTORMATCH);
+        mpDaemonThread->start();
+        return ;
+    }
+    if(mProcessMode == PROCESSMODE::FILEDESCRIPTORMATCH) {
+        // 中断后 (崩溃/关闭窗口) 再次处理同一文件时从检查点继续
+        mDescriptorMatch->setCheckpoint(mFilePath.toStdString() + ".fdckpt");
+        mpMatchThread->initResources(mDescriptorMatch);
+        mpMatchThread->start();
+    } else {
+        mpProcessThread->initResources(mFileDescriptor);
+        mpProcessThread->start();
+    }
 
     //获取数据处理进度，子线程
-    mpBarThread->initResources(mFileDescriptor, mProcessLine);
+    mpBarThread->initResources(mpAnalyzer);
     mpBarThread->start();
 
 }
+
+void
+FilterWidget::cancelButtonClicked() {
+    DEG_LOG("cancel analysis %p", mpAnalyzer);
+    mCancelButton->setDisabled(true);
+    // the worker thread stops, purges the pool and still emits an empty result
+    mpAnalyzer->cancel();
+    if(mUseDaemon) {
+        mpDaemonThread->abort();
+    }
+}
+
+void
+FilterWidget::setRunning(bool running) {
+    mProcessComboBox->setDisabled(running);
+    mThreadComboBox->setDisabled(running);
+    mFilePathButton->setDisabled(running);
+    mExportButton->setDisabled(running);
+    mEventsCheckBox->setDisabled(running);
+    mProcessButton->setDisabled(running);
+    mCancelButton->setDisabled(!running);
+}
+
+void
+FilterWidget::finishExport() {
+    // the worker has returned: nothing writes to the exporter any more
+    mpAnalyzer->setExporter(nullptr);
+    if(mpExporter) {
+        std::cout<<"Exported: "<<mpExporter->written()<<" bytes to "<<mExportPath.toStdString()<<std::endl;
+        mpExporter.reset();
+    }
+}
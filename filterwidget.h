@@ -8,13 +8,21 @@
 #include <QtCore/QThread>
 #include <QtCore/QMetaType>
 
+#include <memory>
+
 #include "FileDescriptor.h"
+#include "DescriptorMatch.h"
 #include "HandlerThread.h"
 #include "FilterThread.h"
+#include "timelineview.h"
+#include "resulttablemodel.h"
+#include "Exporter.h"
 
 QT_BEGIN_NAMESPACE
 class QComboBox;
 class QCheckBox;
+class QLineEdit;
+class QTableView;
 QT_END_NAMESPACE
 
 QT_CHARTS_BEGIN_NAMESPACE
@@ -45,19 +53,30 @@ private Q_SLOTS:
     void        processBoxChanged();
     void        threadBoxChanged();
     void        logFilePathChanged();
+    void        exportPathChanged();
     void        processButtonClicked();
+    void        cancelButtonClicked();
     void        processBarChanged(double val);
     void        processDescriptorChanged(ResultData);
+    void        processMatchChanged(MatchData);
+    void        resultFilterChanged();
 
 private:
     void            connectSignal();
     QComboBox*      createProcessBox() const;
     QComboBox*      createThreadBox() const;
     QPushButton*    createProcessButton() const;
+    QPushButton*    createCancelButton() const;
     QProgressBar*   createProcessBar() const;
     QPushButton*    createLogButton() const;
+    QPushButton*    createExportButton() const;
+    QCheckBox*      createEventsBox() const;
+    QLineEdit*      createFilterEdit() const;
+    QTableView*     createResultView() const;
 
     void            initUIResources();
+    void            setRunning(bool running);
+    void            finishExport();
 
 private:
     void            getProcessLine(const QString strFilePath);
@@ -67,16 +86,30 @@ private:
     QComboBox       *mThreadComboBox    = nullptr;
     QPushButton     *mFilePathButton    = nullptr;
     QPushButton     *mProcessButton     = nullptr;
+    QPushButton     *mCancelButton      = nullptr;
+    QPushButton     *mExportButton      = nullptr;
+    QCheckBox       *mEventsCheckBox    = nullptr;
     QProgressBar    *mProcessBar        = nullptr;
+    TimelineView    *mTimelineView      = nullptr;
+    QLineEdit       *mFilterEdit        = nullptr;
+    QTableView      *mResultView        = nullptr;
+    ResultTableModel    *mResultModel   = nullptr;
 
 private:
+    PROCESSMODE     mProcessMode = PROCESSMODE::FILEDESCRIPTORMATCH;
     FileDescriptor  *mFileDescriptor = nullptr;
-    HandlerThread   *mpProcessHandler = nullptr;
+    DescriptorMatch *mDescriptorMatch = nullptr;
+    Analyzer        *mpAnalyzer = nullptr;
     QBarThread      *mpBarThread = nullptr;
     QProcessThread  *mpProcessThread = nullptr;
+    QMatchThread    *mpMatchThread = nullptr;
+    QDaemonThread   *mpDaemonThread = nullptr;
+    bool            mUseDaemon = false;     // current run answered by fdtraced
+    pid_t           mProcessId = 2038;
     unsigned int    mThreadNum;
-    unsigned int    mProcessLine;
     QString         mFilePath;
+    QString         mExportPath;
+    std::unique_ptr<Exporter>   mpExporter;
 
 };
 
@@ -0,0 +1,280 @@
+#include "resulttablemodel.h"
+
+#include <algorithm>
+
+#include <QtCore/QStringList>
+
+#include "SyscallLine.h"
+#include "threadlog.h"
+
+/******************* ResultFilter ********************************/
+ResultFilter
+ResultFilter::parse(
+    const QString & text
+) {
+    ResultFilter filter;
+    for(const QString & token : text.split(' ', QString::SkipEmptyParts)) {
+        int pos = token.indexOf('=');
+        if(pos <= 0) {
+            continue;
+        }
+        QString     key   = token.left(pos).toLower();
+        std::string value = token.mid(pos + 1).toStdString();
+        bool        ok    = false;
+
+        if(key == "fd") {
+            long fd = token.mid(pos + 1).toLong(&ok);
+            filter.fd = ok ? fd : -1;
+        } else if(key == "pid") {
+            long long pid = token.mid(pos + 1).toLongLong(&ok);
+            filter.pid = ok ? pid : -1;
+        } else if(key == "from") {
+            filter.fromUsec = SyscallLine::toMicros(value);
+        } else if(key == "to") {
+            filter.toUsec = SyscallLine::toMicros(value);
+        }
+    }
+    return filter;
+}
+
+bool
+ResultFilter::accept(
+    const ResultRow &   row
+) const {
+    if(fd >= 0 && row.fd != fd) {
+        return false;
+    }
+    if(pid >= 0 && row.pid != pid) {
+        return false;
+    }
+    if(fromUsec >= 0 && row.usec < fromUsec) {
+        return false;
+    }
+    if(toUsec >= 0 && row.usec > toUsec) {
+        return false;
+    }
+    return true;
+}
+
+/******************* public function ********************************/
+ResultTableModel::ResultTableModel(QObject *parent)
+: QAbstractTableModel(parent)
+, mpIndexer(new HandlerThread())
+, mGeneration(0)
+{
+    qRegisterMetaType<ResultData>("ResultData");
+    qRegisterMetaType<ResultIndex>("ResultIndex");
+    connect(this, &ResultTableModel::indexed, this, &ResultTableModel::indexChanged, Qt::QueuedConnection);
+}
+
+ResultTableModel::~ResultTableModel() {
+    ++mGeneration;
+    if(mpIndexer) {
+        mpIndexer->quitSafely();
+        delete mpIndexer;
+        mpIndexer = nullptr;
+    }
+}
+
+void
+ResultTableModel::setStore(
+    ResultHandle    store
+) {
+    mStore = store;
+    reindex();
+}
+
+void
+ResultTableModel::setFilter(
+    const ResultFilter &    filter
+) {
+    mFilter = filter;
+    reindex();
+}
+
+int
+ResultTableModel::rowCount(
+    const QModelIndex & parent
+) const {
+    if(parent.isValid() || !mShownIndex) {
+        return 0;
+    }
+    return static_cast<int>(mShownIndex->size());
+}
+
+int
+ResultTableModel::columnCount(
+    const QModelIndex & parent
+) const {
+    return parent.isValid() ? 0 : COLUMNCOUNT;
+}
+
+QVariant
+ResultTableModel::data(
+    const QModelIndex & index,
+    int                 role
+) const {
+    if(!index.isValid() || !mShownIndex || index.row() >= static_cast<int>(mShownIndex->size())) {
+        return QVariant();
+    }
+
+    const ResultRow & row = (*mShownStore)[(*mShownIndex)[index.row()]];
+    if(role == Qt::TextAlignmentRole) {
+        return index.column() == STATUS ? int(Qt::AlignLeft | Qt::AlignVCenter)
+                                        : int(Qt::AlignRight | Qt::AlignVCenter);
+    }
+    if(role != Qt::DisplayRole) {
+        return QVariant();
+    }
+
+    switch(index.column()) {
+    case FD:
+        return static_cast<int>(row.fd);
+    case PID:
+        return static_cast<int>(row.pid);
+    case TIME:
+        return QString::fromStdString(formatMicros(row.usec));
+    case STATUS:
+        return statusName(row.status);
+    default:
+        return QVariant();
+    }
+}
+
+QVariant
+ResultTableModel::headerData(
+    int             section,
+    Qt::Orientation orientation,
+    int             role
+) const {
+    if(role != Qt::DisplayRole || orientation != Qt::Horizontal) {
+        return QVariant();
+    }
+    switch(section) {
+    case FD:
+        return QString("fd");
+    case PID:
+        return QString("pid");
+    case TIME:
+        return QString("time");
+    case STATUS:
+        return QString("status");
+    default:
+        return QVariant();
+    }
+}
+
+void
+ResultTableModel::sort(
+    int             column,
+    Qt::SortOrder   order
+) {
+    mSortColumn = column;
+    mSortOrder  = order;
+    reindex();
+}
+
+/******************* private function ********************************/
+void
+ResultTableModel::reindex() {
+    quint64 generation = ++mGeneration;
+    if(!mStore) {
+        emit indexed(generation, mStore, ResultIndex());
+        return ;
+    }
+
+    ResultHandle    store  = mStore;
+    ResultFilter    filter = mFilter;
+    int             column = mSortColumn;
+    Qt::SortOrder   order  = mSortOrder;
+    mpIndexer->enqueue([this, generation, store, filter, column, order](){
+        // a newer sort or filter already superseded this one
+        if(generation != mGeneration) {
+            return ;
+        }
+        ResultIndex index = buildIndex(*store, filter, column, order);
+        if(generation == mGeneration) {
+            emit indexed(generation, store, index);
+        }
+    });
+}
+
+void
+ResultTableModel::indexChanged(
+    quint64         generation,
+    ResultData      store,
+    ResultIndex     index
+) {
+    if(generation != mGeneration) {
+        return ;
+    }
+    beginResetModel();
+    mShownStore = store;
+    mShownIndex = index;
+    endResetModel();
+    DEG_LOG("result view: %d rows", rowCount());
+}
+
+ResultIndex
+ResultTableModel::buildIndex(
+    const ResultStore &     store,
+    const ResultFilter &    filter,
+    int                     column,
+    Qt::SortOrder           order
+) {
+    auto index = std::make_shared<std::vector<uint32_t>>();
+    index->reserve(store.size());
+    for(size_t indx = 0; indx < store.size(); ++indx) {
+        if(filter.accept(store[indx])) {
+            index->push_back(static_cast<uint32_t>(indx));
+        }
+    }
+    if(column < 0 || column >= COLUMNCOUNT) {
+        return index;
+    }
+
+    auto key = [&store, column](uint32_t indx) -> long long {
+        const ResultRow & row = store[indx];
+        switch(column) {
+        case FD:
+            return row.fd;
+        case PID:
+            return row.pid;
+        case TIME:
+            return row.usec;
+        default:
+            return static_cast<long long>(row.status);
+        }
+    };
+    // stable, so rows keep the store order (fd, incident, time) among equal keys
+    if(order == Qt::AscendingOrder) {
+        std::stable_sort(index->begin(), index->end(),
+                         [&](uint32_t lhs, uint32_t rhs){ return key(lhs) < key(rhs); });
+    } else {
+        std::stable_sort(index->begin(), index->end(),
+                         [&](uint32_t lhs, uint32_t rhs){ return key(lhs) > key(rhs); });
+    }
+    return index;
+}
+
+QString
+ResultTableModel::statusName(
+    FDSTATUS    status
+) {
+    switch(status) {
+    case FDSTATUS::OPENING:
+        return QString("Opening");
+    case FDSTATUS::DUMPING:
+        return QString("Dumping");
+    case FDSTATUS::CLOSING:
+        return QString("Closing");
+    case FDSTATUS::CLOSED:
+        return QString("CLOSED");
+    case FDSTATUS::NORMAL:
+        return QString("Normal");
+    case FDSTATUS::BADFD:
+        return QString("EBADF");
+    default:
+        return QString();
+    }
+}
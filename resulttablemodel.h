@@ -0,0 +1,89 @@
+#ifndef RESULTTABLEMODEL_H
+#define RESULTTABLEMODEL_H
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#include <QtCore/QAbstractTableModel>
+#include <QtCore/QMetaType>
+#include <QtCore/QString>
+
+#include "FilterThread.h"
+#include "HandlerThread.h"
+#include "ResultStore.h"
+
+// Row filter typed into the result view, e.g. "fd=3 pid=2038 from=10:00:01 to=10:00:02".
+// Unset fields match every row.
+struct ResultFilter {
+    long        fd       = -1;
+    long long   pid      = -1;
+    long long   fromUsec = -1;
+    long long   toUsec   = -1;
+
+    static ResultFilter parse(const QString & text);
+    bool    accept(const ResultRow & row) const;
+};
+
+// Visible rows as indexes into the ResultStore, in display order.
+using ResultIndex = std::shared_ptr<const std::vector<uint32_t>>;
+Q_DECLARE_METATYPE(ResultIndex);
+
+// Table model over the engine's ResultStore.
+//
+// The store is shared, never copied: data() formats only the rows the view
+// asks for. Sorting and filtering build a new index permutation on a
+// HandlerThread and swap it in when ready, newest request wins.
+class ResultTableModel : public QAbstractTableModel
+{
+    Q_OBJECT
+public:
+    enum COLUMN {
+        FD,
+        PID,
+        TIME,
+        STATUS,
+        COLUMNCOUNT
+    };
+
+public:
+    explicit ResultTableModel(QObject *parent = 0);
+    ~ResultTableModel();
+
+    void        setStore(ResultHandle store);
+    void        setFilter(const ResultFilter & filter);
+
+    int         rowCount(const QModelIndex & parent = QModelIndex()) const override;
+    int         columnCount(const QModelIndex & parent = QModelIndex()) const override;
+    QVariant    data(const QModelIndex & index, int role = Qt::DisplayRole) const override;
+    QVariant    headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const override;
+    void        sort(int column, Qt::SortOrder order = Qt::AscendingOrder) override;
+
+Q_SIGNALS:
+    void        indexed(quint64 generation, ResultData store, ResultIndex index);
+
+private Q_SLOTS:
+    void        indexChanged(quint64 generation, ResultData store, ResultIndex index);
+
+private:
+    void        reindex();
+    static ResultIndex  buildIndex(const ResultStore & store, const ResultFilter & filter,
+                                   int column, Qt::SortOrder order);
+    static QString      statusName(FDSTATUS status);
+
+private:
+    HandlerThread           *mpIndexer = nullptr;
+
+    // latest request, indexed in the background
+    ResultHandle            mStore;
+    ResultFilter            mFilter;
+    int                     mSortColumn = -1;
+    Qt::SortOrder           mSortOrder = Qt::AscendingOrder;
+    std::atomic<quint64>    mGeneration;
+
+    // what the view currently shows
+    ResultHandle            mShownStore;
+    ResultIndex             mShownIndex;
+};
+
+#endif // RESULTTABLEMODEL_H
@@ -13,6 +13,7 @@
 #include <windows.h>
 
 #else
+#include <pwd.h>
 #include <sys/syscall.h>
 #endif
 
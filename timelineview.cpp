@@ -0,0 +1,293 @@
+#include "timelineview.h"
+
+#include <algorithm>
+
+#include <QtCharts/QChart>
+#include <QtCharts/QLineSeries>
+#include <QtCharts/QValueAxis>
+#include <QtCore/QTimer>
+#include <QtGui/QKeyEvent>
+#include <QtGui/QMouseEvent>
+#include <QtGui/QResizeEvent>
+#include <QtGui/QWheelEvent>
+
+#include "threadlog.h"
+
+static QVector<QPointF>
+toPoints(const std::vector<LttbPoint> & points) {
+    QVector<QPointF> result;
+    result.reserve(static_cast<int>(points.size()));
+    for(const auto & point : points) {
+        result.append(QPointF(point.x, point.y));
+    }
+    return result;
+}
+
+TimelineView::TimelineView(QWidget *parent)
+: QChartView(new QChart(), parent)
+, mpSampler(new HandlerThread())
+, mResampleTimer(new QTimer(this))
+, mOpenSeries(new QLineSeries())
+, mOpenRateSeries(new QLineSeries())
+, mCloseRateSeries(new QLineSeries())
+, mAxisX(new QValueAxis())
+, mAxisCount(new QValueAxis())
+, mAxisRate(new QValueAxis())
+, mGeneration(0)
+{
+    qRegisterMetaType<TimelineSample>("TimelineSample");
+
+    QChart *pChart = chart();
+    pChart->legend()->setAlignment(Qt::AlignBottom);
+
+    mOpenSeries->setName("open fds");
+    mOpenRateSeries->setName("open/s");
+    mCloseRateSeries->setName("close/s");
+    for(QLineSeries *pSeries : {mOpenSeries, mOpenRateSeries, mCloseRateSeries}) {
+        pSeries->setUseOpenGL(true);
+        pChart->addSeries(pSeries);
+    }
+
+    mAxisX->setTitleText("time of day (s)");
+    mAxisX->setLabelFormat("%.3f");
+    mAxisCount->setTitleText("open fds");
+    mAxisCount->setLabelFormat("%d");
+    mAxisRate->setTitleText("calls/s");
+    mAxisRate->setLabelFormat("%.0f");
+    pChart->addAxis(mAxisX, Qt::AlignBottom);
+    pChart->addAxis(mAxisCount, Qt::AlignLeft);
+    pChart->addAxis(mAxisRate, Qt::AlignRight);
+
+    mOpenSeries->attachAxis(mAxisX);
+    mOpenSeries->attachAxis(mAxisCount);
+    mOpenRateSeries->attachAxis(mAxisX);
+    mOpenRateSeries->attachAxis(mAxisRate);
+    mCloseRateSeries->attachAxis(mAxisX);
+    mCloseRateSeries->attachAxis(mAxisRate);
+
+    setRubberBand(QChartView::HorizontalRubberBand);
+    setFocusPolicy(Qt::StrongFocus);
+
+    // coalesce bursts of range changes (wheel, drag) into one resample
+    mResampleTimer->setSingleShot(true);
+    mResampleTimer->setInterval(40);
+
+    connect(mResampleTimer, &QTimer::timeout, this, &TimelineView::resample);
+    connect(mAxisX, &QValueAxis::rangeChanged, this, &TimelineView::rangeChanged);
+    connect(this, &TimelineView::sampled, this, &TimelineView::sampleChanged, Qt::QueuedConnection);
+    DEG_LOG("Create TimelineView: %p, Success", this);
+}
+
+TimelineView::~TimelineView() {
+    ++mGeneration;
+    if(mpSampler) {
+        mpSampler->quitSafely();
+        delete mpSampler;
+        mpSampler = nullptr;
+    }
+}
+
+void
+TimelineView::setTimeline(FdTimeline::Series series) {
+    quint64 generation = ++mGeneration;
+    size_t  points = static_cast<size_t>(threshold());
+    auto    data = std::make_shared<FdTimeline::Series>(std::move(series));
+
+    // building the source is O(n) as well, keep it off the UI thread
+    mpSampler->enqueue([this, data, generation, points](){
+        auto source = std::make_shared<Source>();
+        source->openFds.reserve(data->size());
+        source->openRate.reserve(data->size());
+        source->closeRate.reserve(data->size());
+        for(const auto & point : *data) {
+            double x = point.usec / 1e6;
+            source->openFds.push_back({x, static_cast<double>(point.openFds)});
+            source->openRate.push_back({x, point.openRate});
+            source->closeRate.push_back({x, point.closeRate});
+            source->maxOpen = std::max(source->maxOpen, static_cast<double>(point.openFds));
+            source->maxRate = std::max(source->maxRate, std::max(point.openRate, point.closeRate));
+        }
+        if(!data->empty()) {
+            source->minX = source->openFds.front().x;
+            source->maxX = source->openFds.back().x;
+        }
+        mSource = source;
+
+        if(generation != mGeneration) {
+            return ;
+        }
+        TimelineSample result = sample(*source, source->minX, source->maxX, points);
+        result.generation = generation;
+        result.reset      = true;
+        result.minX       = source->minX;
+        result.maxX       = source->maxX;
+        result.maxOpen    = source->maxOpen;
+        result.maxRate    = source->maxRate;
+        emit sampled(result);
+    });
+}
+
+void
+TimelineView::clear() {
+    setTimeline(FdTimeline::Series());
+}
+
+TimelineSample
+TimelineView::sample(
+    const Source &  source,
+    double          lo,
+    double          hi,
+    size_t          threshold
+) {
+    TimelineSample result;
+    result.openFds   = toPoints(Lttb::sampleRange(source.openFds, lo, hi, threshold));
+    result.openRate  = toPoints(Lttb::sampleRange(source.openRate, lo, hi, threshold));
+    result.closeRate = toPoints(Lttb::sampleRange(source.closeRate, lo, hi, threshold));
+    return result;
+}
+
+int
+TimelineView::threshold() const {
+    // two points per pixel column keep min and max of every column visible
+    return std::max(200, static_cast<int>(chart()->plotArea().width()) * 2);
+}
+
+void
+TimelineView::rangeChanged(qreal min, qreal max) {
+    Q_UNUSED(min);
+    Q_UNUSED(max);
+    if(!mApplying) {
+        mResampleTimer->start();
+    }
+}
+
+void
+TimelineView::resample() {
+    quint64 generation = ++mGeneration;
+    double  lo = mAxisX->min();
+    double  hi = mAxisX->max();
+    size_t  points = static_cast<size_t>(threshold());
+
+    mpSampler->enqueue([this, generation, lo, hi, points](){
+        // a newer zoom or pan already superseded this one
+        if(generation != mGeneration || !mSource) {
+            return ;
+        }
+        TimelineSample result = sample(*mSource, lo, hi, points);
+        result.generation = generation;
+        if(generation == mGeneration) {
+            emit sampled(result);
+        }
+    });
+}
+
+void
+TimelineView::sampleChanged(TimelineSample sample) {
+    if(sample.generation != mGeneration) {
+        return ;
+    }
+
+    mApplying = true;
+    if(sample.reset) {
+        mMinX = sample.minX;
+        mMaxX = sample.maxX > sample.minX ? sample.maxX : sample.minX + 1;
+        mAxisX->setRange(mMinX, mMaxX);
+        mAxisCount->setRange(0, sample.maxOpen * 1.05 + 1);
+        mAxisRate->setRange(0, sample.maxRate * 1.05 + 1);
+    }
+    mOpenSeries->replace(sample.openFds);
+    mOpenRateSeries->replace(sample.openRate);
+    mCloseRateSeries->replace(sample.closeRate);
+    mApplying = false;
+}
+
+void
+TimelineView::resetRange() {
+    mAxisX->setRange(mMinX, mMaxX);
+}
+
+void
+TimelineView::wheelEvent(QWheelEvent *event) {
+    double factor = event->angleDelta().y() > 0 ? 0.8 : 1.25;
+    double min    = mAxisX->min();
+    double max    = mAxisX->max();
+    double center = chart()->mapToValue(event->pos(), mOpenSeries).x();
+    if(center < min || center > max) {
+        center = (min + max) / 2;
+    }
+
+    double lo = center - (center - min) * factor;
+    double hi = center + (max - center) * factor;
+    mAxisX->setRange(std::max(lo, mMinX), std::min(hi, mMaxX));
+    event->accept();
+}
+
+void
+TimelineView::mousePressEvent(QMouseEvent *event) {
+    if(event->button() == Qt::MiddleButton) {
+        mPanning   = true;
+        mPanOrigin = event->pos();
+        event->accept();
+        return ;
+    }
+    QChartView::mousePressEvent(event);
+}
+
+void
+TimelineView::mouseMoveEvent(QMouseEvent *event) {
+    if(mPanning) {
+        QPoint delta = event->pos() - mPanOrigin;
+        mPanOrigin = event->pos();
+        chart()->scroll(-delta.x(), 0);
+        event->accept();
+        return ;
+    }
+    QChartView::mouseMoveEvent(event);
+}
+
+void
+TimelineView::mouseReleaseEvent(QMouseEvent *event) {
+    if(event->button() == Qt::MiddleButton) {
+        mPanning = false;
+        event->accept();
+        return ;
+    }
+    if(event->button() == Qt::RightButton) {
+        resetRange();
+        event->accept();
+        return ;
+    }
+    QChartView::mouseReleaseEvent(event);
+}
+
+void
+TimelineView::keyPressEvent(QKeyEvent *event) {
+    double step = (mAxisX->max() - mAxisX->min()) / 10;
+    switch(event->key()) {
+    case Qt::Key_Home:
+        resetRange();
+        break;
+    case Qt::Key_Left:
+        mAxisX->setRange(mAxisX->min() - step, mAxisX->max() - step);
+        break;
+    case Qt::Key_Right:
+        mAxisX->setRange(mAxisX->min() + step, mAxisX->max() + step);
+        break;
+    case Qt::Key_Plus:
+        mAxisX->setRange(mAxisX->min() + step, mAxisX->max() - step);
+        break;
+    case Qt::Key_Minus:
+        mAxisX->setRange(std::max(mMinX, mAxisX->min() - step), std::min(mMaxX, mAxisX->max() + step));
+        break;
+    default:
+        QChartView::keyPressEvent(event);
+        return ;
+    }
+    event->accept();
+}
+
+void
+TimelineView::resizeEvent(QResizeEvent *event) {
+    QChartView::resizeEvent(event);
+    mResampleTimer->start();
+}
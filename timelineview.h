@@ -0,0 +1,111 @@
+#ifndef TIMELINEVIEW_H
+#define TIMELINEVIEW_H
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#include <QtCharts/QChartGlobal>
+#include <QtCharts/QChartView>
+#include <QtCore/QMetaType>
+#include <QtCore/QPointF>
+#include <QtCore/QVector>
+
+#include "FdTimeline.h"
+#include "HandlerThread.h"
+#include "Lttb.h"
+
+QT_BEGIN_NAMESPACE
+class QTimer;
+QT_END_NAMESPACE
+
+QT_CHARTS_BEGIN_NAMESPACE
+class QLineSeries;
+class QValueAxis;
+QT_CHARTS_END_NAMESPACE
+
+QT_CHARTS_USE_NAMESPACE
+
+// Points of every plotted series for one visible x range.
+struct TimelineSample {
+    quint64             generation = 0;
+    bool                reset = false;      // new data: axes take the bounds below
+    double              minX = 0;
+    double              maxX = 0;
+    double              maxOpen = 0;
+    double              maxRate = 0;
+    QVector<QPointF>    openFds;
+    QVector<QPointF>    openRate;
+    QVector<QPointF>    closeRate;
+};
+Q_DECLARE_METATYPE(TimelineSample);
+
+// Open-fd count and open/close rates over time.
+//
+// The full resolution series stay outside the chart; only an LTTB sample of
+// the visible range, about two points per horizontal pixel, is handed to the
+// QLineSeries. Sampling runs on a HandlerThread and is redone whenever the
+// x range changes (wheel zoom, rubber band, drag pan), newest request wins.
+class TimelineView : public QChartView
+{
+    Q_OBJECT
+public:
+    explicit TimelineView(QWidget *parent = 0);
+    ~TimelineView();
+
+    void        setTimeline(FdTimeline::Series series);
+    void        clear();
+
+Q_SIGNALS:
+    void        sampled(TimelineSample);
+
+private Q_SLOTS:
+    void        rangeChanged(qreal min, qreal max);
+    void        sampleChanged(TimelineSample sample);
+    void        resample();
+
+protected:
+    void        wheelEvent(QWheelEvent *event) override;
+    void        mousePressEvent(QMouseEvent *event) override;
+    void        mouseMoveEvent(QMouseEvent *event) override;
+    void        mouseReleaseEvent(QMouseEvent *event) override;
+    void        keyPressEvent(QKeyEvent *event) override;
+    void        resizeEvent(QResizeEvent *event) override;
+
+private:
+    struct Source {
+        std::vector<LttbPoint>  openFds;
+        std::vector<LttbPoint>  openRate;
+        std::vector<LttbPoint>  closeRate;
+        double  minX = 0;
+        double  maxX = 0;
+        double  maxOpen = 0;
+        double  maxRate = 0;
+    };
+
+    void        resetRange();
+    int         threshold() const;
+    static TimelineSample   sample(const Source & source, double lo, double hi, size_t threshold);
+
+private:
+    HandlerThread           *mpSampler = nullptr;
+    QTimer                  *mResampleTimer = nullptr;
+    QLineSeries             *mOpenSeries = nullptr;
+    QLineSeries             *mOpenRateSeries = nullptr;
+    QLineSeries             *mCloseRateSeries = nullptr;
+    QValueAxis              *mAxisX = nullptr;
+    QValueAxis              *mAxisCount = nullptr;
+    QValueAxis              *mAxisRate = nullptr;
+
+    // owned by the sampler thread only
+    std::shared_ptr<const Source>   mSource;
+
+    std::atomic<quint64>    mGeneration;
+    double                  mMinX = 0;
+    double                  mMaxX = 0;
+    bool                    mApplying = false;
+    bool                    mPanning = false;
+    QPoint                  mPanOrigin;
+};
+
+#endif // TIMELINEVIEW_H
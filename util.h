@@ -1,6 +1,7 @@
 #ifndef _UTIL_H_
 #define _UTIL_H_
 
+#include <cstdio>
 #include <string>
 #include <tuple>
 
@@ -18,10 +19,25 @@ enum class FDSTATUS {
     CLOSED      = -3,
     USELESS     = -4,
     OPENING     = -5,
-    DUMPING     = -6
+    DUMPING     = -6,
+    BADFD       = -7        // the EBADF itself
 };
 
 
+// microseconds of the day back to the strace -tt form "HH:MM:SS.uuuuuu"
+inline std::string
+formatMicros(long long usec) {
+    if(usec < 0) {
+        return "--:--:--.------";
+    }
+    long long sec = usec / 1000000;
+    char buffer[32];
+    snprintf(buffer, sizeof(buffer), "%02lld:%02lld:%02lld.%06lld",
+             (sec / 3600) % 24, (sec / 60) % 60, sec % 60, usec % 1000000);
+    return buffer;
+}
+
+
 class Stream {
 public:
     Stream(): pid(-1){}